@@ -0,0 +1,102 @@
+// Buffer vs RingBuffer on read/parse/retrieve cycles
+#include "bench_harness.hpp"
+#include "buffer.hpp"
+#include "ring_buffer.hpp"
+
+#include <algorithm>
+#include <string>
+#include <sys/socket.h>
+#include <unistd.h>
+
+static const std::string REQUEST =
+    "GET /images/profile-image.jpg HTTP/1.1\r\n"
+    "Host: 127.0.0.1:9999\r\n"
+    "User-Agent: Mozilla/5.0 (X11; Linux x86_64) AppleWebKit/537.36\r\n"
+    "Accept: image/avif,image/webp,image/apng,image/*,*/*;q=0.8\r\n"
+    "Accept-Encoding: gzip, deflate, br\r\n"
+    "Accept-Language: zh-CN,zh;q=0.9,en;q=0.8\r\n"
+    "Connection: keep-alive\r\n"
+    "\r\n";
+
+// 与 HTTPRequest::parse 相同的按行切分方式
+template <class Buf> static size_t ConsumeLines(Buf &buff) {
+  const char CRLF[] = "\r\n";
+  size_t lines = 0;
+  while (buff.ReadableBytes()) {
+    const char *lineEnd =
+        std::search(buff.Peek(), buff.BeginWriteConst(), CRLF, CRLF + 2);
+    if (lineEnd == buff.BeginWriteConst()) {
+      break;
+    }
+    buff.RetrieveUntil(lineEnd + 2);
+    lines++;
+  }
+  return lines;
+}
+
+// 一次 keep-alive 请求：读入、解析、整体清空
+template <class Buf> static void KeepAliveCycle(Buf &buff) {
+  buff.Append(REQUEST);
+  Bench::DoNotOptimize(ConsumeLines(buff));
+  buff.RetrieveAll();
+}
+
+// 流水线：每次读入时缓冲区里还残留半个请求，Buffer 需要把它搬回开头
+template <class Buf> static void PipelinedCycle(Buf &buff, size_t chunk) {
+  static const std::string stream = REQUEST + REQUEST + REQUEST + REQUEST;
+  for (size_t off = 0; off < stream.size(); off += chunk) {
+    buff.Append(stream.data() + off, std::min(chunk, stream.size() - off));
+    Bench::DoNotOptimize(ConsumeLines(buff));
+  }
+}
+
+// 通过 socketpair 的真实 ReadFd 路径
+template <class Buf> static void ReadFdCycle(Buf &buff, int rfd, int wfd) {
+  int err = 0;
+  if (write(wfd, REQUEST.data(), REQUEST.size()) < 0) {
+    return;
+  }
+  buff.ReadFd(rfd, &err);
+  Bench::DoNotOptimize(ConsumeLines(buff));
+  buff.RetrieveAll();
+}
+
+template <class Buf>
+static void RunAll(Bench::Runner &runner, const std::string &name,
+                   size_t initSize) {
+  runner.Run(name + "/keepalive", [&](uint64_t n) {
+    Buf buff(initSize);
+    for (uint64_t i = 0; i < n; i++) {
+      KeepAliveCycle(buff);
+    }
+  });
+  for (size_t chunk : {1000, 1460}) {
+    runner.Run(name + "/pipelined_" + std::to_string(chunk), [&](uint64_t n) {
+      Buf buff(initSize);
+      for (uint64_t i = 0; i < n; i++) {
+        PipelinedCycle(buff, chunk);
+      }
+    });
+  }
+  int sv[2];
+  if (socketpair(AF_UNIX, SOCK_STREAM, 0, sv) < 0) {
+    return;
+  }
+  runner.Run(name + "/readfd", [&](uint64_t n) {
+    Buf buff(initSize);
+    for (uint64_t i = 0; i < n; i++) {
+      ReadFdCycle(buff, sv[0], sv[1]);
+    }
+  });
+  close(sv[0]);
+  close(sv[1]);
+}
+
+int main(int argc, char *argv[]) {
+  Bench::Runner runner(argc, argv);
+  for (int size : {1024, 4096, 65536}) {
+    RunAll<Buffer>(runner, "Buffer_" + std::to_string(size), size);
+    RunAll<RingBuffer>(runner, "RingBuffer_" + std::to_string(size), size);
+  }
+  return 0;
+}
@@ -0,0 +1,103 @@
+#ifndef BENCH_HARNESS_HPP_
+#define BENCH_HARNESS_HPP_
+// 自带的微基准小框架：每个用例按批次翻倍运行直到达到时间预算，输出 ns/op。
+// 传入 --quick 时只做冒烟运行（供 ctest 使用）；--baseline 指定之前保存的
+// 输出文件，逐项附上相对变化，便于跨提交比较。
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <sstream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace Bench {
+
+// 防止编译器把结果优化掉
+template <class T> inline void DoNotOptimize(const T &value) {
+  asm volatile("" : : "r,m"(value) : "memory");
+}
+
+struct Result {
+  std::string name;
+  uint64_t iterations;
+  double nsPerOp;
+};
+
+class Runner {
+public:
+  Runner(int argc, char *argv[]) {
+    for (int i = 1; i < argc; i++) {
+      if (strcmp(argv[i], "--quick") == 0) {
+        budget_ = std::chrono::milliseconds(20);
+      } else if (strcmp(argv[i], "--filter") == 0 && i + 1 < argc) {
+        filter_ = argv[++i];
+      } else if (strcmp(argv[i], "--baseline") == 0 && i + 1 < argc) {
+        LoadBaseline_(argv[++i]);
+      }
+    }
+  }
+
+  // fn(n) 执行 n 次被测操作
+  void Run(const std::string &name, const std::function<void(uint64_t)> &fn) {
+    if (!filter_.empty() && name.find(filter_) == std::string::npos) {
+      return;
+    }
+    using Clock = std::chrono::steady_clock;
+    uint64_t n = 1;
+    for (;;) {
+      auto start = Clock::now();
+      fn(n);
+      auto elapsed = Clock::now() - start;
+      if (elapsed >= budget_ || n >= (uint64_t(1) << 40)) {
+        double ns =
+            std::chrono::duration<double, std::nano>(elapsed).count() / n;
+        results_.push_back({name, n, ns});
+        printf("%-48s %12llu %12.1f ns/op", name.c_str(),
+               static_cast<unsigned long long>(n), ns);
+        auto base = baseline_.find(name);
+        if (base != baseline_.end() && base->second > 0) {
+          printf(" %+8.1f%%", (ns / base->second - 1) * 100);
+        }
+        printf("\n");
+        fflush(stdout);
+        return;
+      }
+      n *= 2;
+    }
+  }
+
+  const std::vector<Result> &Results() const { return results_; }
+
+private:
+  // 每行：名称 次数 ns/op（即本程序的输出格式）
+  void LoadBaseline_(const char *path) {
+    std::ifstream in(path);
+    if (!in) {
+      fprintf(stderr, "cannot open baseline %s\n", path);
+      return;
+    }
+    std::string line;
+    while (std::getline(in, line)) {
+      std::istringstream fields(line);
+      std::string name;
+      uint64_t iterations;
+      double ns;
+      if (fields >> name >> iterations >> ns) {
+        baseline_[name] = ns;
+      }
+    }
+  }
+
+  std::chrono::nanoseconds budget_ = std::chrono::milliseconds(500);
+  std::string filter_;
+  std::vector<Result> results_;
+  std::unordered_map<std::string, double> baseline_;
+};
+
+} // namespace Bench
+
+#endif // BENCH_HARNESS_HPP_
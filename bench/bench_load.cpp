@@ -0,0 +1,859 @@
+// HTTP load generator: drives a running WebServer over loopback and reports
+// throughput and latency percentiles as JSON
+#include "metrics.hpp"
+
+#include <algorithm>
+#include <arpa/inet.h>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <format>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <random>
+#include <string>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/timerfd.h>
+#include <thread>
+#include <unistd.h>
+#include <unordered_map>
+#include <vector>
+
+namespace {
+
+// 请求种类，与 -m 中的名字一一对应
+enum Kind { Index, Image, Video, Login, KIND_COUNT };
+const char *KindNames[KIND_COUNT] = {"index", "image", "video", "login"};
+// video.html 引用的视频不随仓库提供，压测大文件前需自行放到 resource/video/
+const char *KindPaths[KIND_COUNT] = {"/index.html",
+                                     "/images/instagram-image1.jpg",
+                                     "/video/xxx.mp4", "/login.html"};
+
+struct Options {
+  std::string host = "127.0.0.1";
+  int port = 9999;
+  int connections = 64;
+  int threads = 4;
+  double duration = 10;
+  double warmup = 1;
+  bool keepAlive = true;
+  int pipeline = 1;
+  double rate = 0; // 全部连接合计的请求/秒，0 为闭环（尽快发送）
+  std::array<double, KIND_COUNT> mix = {1, 0, 0, 0};
+  std::string user = "bench";
+  std::string password = "bench";
+  std::string output;
+};
+
+int64_t NowNs() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+struct Extremes {
+  uint64_t min = UINT64_MAX;
+  uint64_t max = 0;
+
+  void add(uint64_t v) {
+    min = std::min(min, v);
+    max = std::max(max, v);
+  }
+  void add(const Extremes &o) {
+    min = std::min(min, o.min);
+    max = std::max(max, o.max);
+  }
+};
+
+// 每个线程一份，结束后汇总
+struct Stats {
+  uint64_t sent = 0;
+  uint64_t responses = 0; // 预热结束之后计划发出的请求收到的响应
+  uint64_t warmupResponses = 0;
+  uint64_t bytes = 0;
+  uint64_t connectErrors = 0;
+  uint64_t ioErrors = 0; // 连接断开时仍未收到响应的请求
+  uint64_t unfinished = 0;
+  uint64_t reconnects = 0;
+  std::array<uint64_t, 6> status{}; // 按百位分类，[0] 为无法解析
+  std::array<uint64_t, KIND_COUNT> kindResponses{};
+  // 从计划发送时刻算起（校正 coordinated omission）
+  Histogram latency;
+  Extremes latencyRange;
+  // 从实际写出时刻算起，闭环模式下与 latency 相同
+  Histogram service;
+  Extremes serviceRange;
+  std::array<Histogram, KIND_COUNT> kindLatency;
+};
+
+struct Pending {
+  int64_t intended;
+  int64_t sent;
+  Kind kind;
+};
+
+struct Conn {
+  int fd = -1;
+  bool connecting = false;
+  bool watchWrite = false;
+  bool everConnected = false;
+  int64_t retryAt = 0;
+  int64_t nextDue = 0;
+  std::string out;
+  size_t outOff = 0;
+  std::deque<Pending> inflight;
+  // 响应解析：先攒头部，再按 Content-length 丢弃响应体
+  std::string head;
+  uint64_t bodyLeft = 0;
+  bool inBody = false;
+  int status = 0;
+  bool closeAfter = false;
+};
+
+class Worker {
+public:
+  Worker(const Options &opt, const sockaddr_in &addr, int index, int conns,
+         int64_t start)
+      : opt_(opt), addr_(addr), conns_(conns), rng_(index + 1),
+        pick_(opt.mix.begin(), opt.mix.end()) {
+    warmupEnd_ = start + static_cast<int64_t>(opt.warmup * 1e9);
+    end_ = warmupEnd_ + static_cast<int64_t>(opt.duration * 1e9);
+    depth_ = opt.keepAlive ? std::max(opt.pipeline, 1) : 1;
+    if (opt.rate > 0) {
+      interval_ = static_cast<int64_t>(opt.connections * 1e9 / opt.rate);
+    }
+    for (int k = 0; k < KIND_COUNT; ++k) {
+      requests_[k] = RenderRequest_(static_cast<Kind>(k));
+    }
+    // 各连接的发送计划错开，避免所有连接同时发出
+    for (int i = 0; i < conns; ++i) {
+      const int global = index + i * opt.threads;
+      conns_[i].nextDue =
+          start + (interval_ * global) / std::max(opt.connections, 1);
+    }
+  }
+
+  void Run() {
+    epfd_ = epoll_create1(EPOLL_CLOEXEC);
+    timerFd_ = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    epoll_event ev{};
+    ev.events = EPOLLIN;
+    ev.data.u64 = TIMER_TAG;
+    epoll_ctl(epfd_, EPOLL_CTL_ADD, timerFd_, &ev);
+    for (auto &c : conns_) {
+      Connect_(c);
+    }
+    epoll_event events[256];
+    for (;;) {
+      const int64_t now = NowNs();
+      const bool sending = now < end_;
+      if (!sending && (Idle_() || now >= end_ + DRAIN_NS)) {
+        break;
+      }
+      int64_t wake = sending ? end_ : end_ + DRAIN_NS;
+      for (auto &c : conns_) {
+        if (c.fd < 0) {
+          if (!sending) {
+            continue;
+          }
+          if (now >= c.retryAt) {
+            Connect_(c);
+          } else {
+            wake = std::min(wake, c.retryAt);
+          }
+        } else if (sending) {
+          Pump_(c, now);
+          if (opt_.rate > 0 && !c.connecting && c.inflight.size() < depth_) {
+            wake = std::min(wake, c.nextDue);
+          }
+        }
+      }
+      ArmTimer_(wake);
+      const int n = epoll_wait(epfd_, events, 256, -1);
+      for (int i = 0; i < n; ++i) {
+        if (events[i].data.u64 == TIMER_TAG) {
+          uint64_t expirations;
+          while (read(timerFd_, &expirations, sizeof(expirations)) > 0) {
+          }
+          continue;
+        }
+        OnEvent_(conns_[events[i].data.u64], events[i].events);
+      }
+    }
+    for (auto &c : conns_) {
+      stats_.unfinished += c.inflight.size();
+      if (c.fd >= 0) {
+        close(c.fd);
+      }
+    }
+    close(timerFd_);
+    close(epfd_);
+  }
+
+  Stats &stats() { return stats_; }
+
+private:
+  static constexpr uint64_t TIMER_TAG = UINT64_MAX;
+  static constexpr int64_t DRAIN_NS = 2000000000;  // 停止发送后最多等 2s
+  static constexpr int64_t RETRY_NS = 10000000;    // 连接失败后 10ms 重试
+
+  std::string RenderRequest_(Kind kind) const {
+    const char *conn = opt_.keepAlive ? "keep-alive" : "close";
+    if (kind != Login) {
+      return std::format("GET {} HTTP/1.1\r\nHost: {}\r\nConnection: {}\r\n\r\n",
+                         KindPaths[kind], opt_.host, conn);
+    }
+    const std::string body =
+        std::format("username={}&password={}", opt_.user, opt_.password);
+    return std::format("POST {} HTTP/1.1\r\nHost: {}\r\nConnection: {}\r\n"
+                       "Content-Type: application/x-www-form-urlencoded\r\n"
+                       "Content-Length: {}\r\n\r\n{}",
+                       KindPaths[kind], opt_.host, conn, body.size(), body);
+  }
+
+  void Connect_(Conn &c) {
+    c.fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    int one = 1;
+    setsockopt(c.fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    const int ret = connect(c.fd, reinterpret_cast<const sockaddr *>(&addr_),
+                            sizeof(addr_));
+    if (ret < 0 && errno != EINPROGRESS) {
+      stats_.connectErrors++;
+      close(c.fd);
+      c.fd = -1;
+      c.retryAt = NowNs() + RETRY_NS;
+      return;
+    }
+    if (c.everConnected) {
+      stats_.reconnects++;
+    }
+    c.connecting = ret < 0;
+    c.everConnected = c.everConnected || !c.connecting;
+    c.watchWrite = c.connecting;
+    epoll_event ev{};
+    ev.events = EPOLLIN | EPOLLRDHUP | (c.watchWrite ? EPOLLOUT : 0u);
+    ev.data.u64 = &c - conns_.data();
+    epoll_ctl(epfd_, EPOLL_CTL_ADD, c.fd, &ev);
+  }
+
+  // 关闭连接；仍未收到响应的请求记为错误
+  void Drop_(Conn &c, bool connectFailed) {
+    epoll_ctl(epfd_, EPOLL_CTL_DEL, c.fd, nullptr);
+    close(c.fd);
+    c.fd = -1;
+    c.connecting = c.watchWrite = false;
+    stats_.ioErrors += c.inflight.size();
+    c.inflight.clear();
+    c.out.clear();
+    c.outOff = 0;
+    c.head.clear();
+    c.inBody = false;
+    c.bodyLeft = 0;
+    if (connectFailed) {
+      stats_.connectErrors++;
+      c.retryAt = NowNs() + RETRY_NS;
+    } else {
+      c.retryAt = 0;
+    }
+  }
+
+  void WatchWrite_(Conn &c, bool on) {
+    if (c.watchWrite == on) {
+      return;
+    }
+    c.watchWrite = on;
+    epoll_event ev{};
+    ev.events = EPOLLIN | EPOLLRDHUP | (on ? EPOLLOUT : 0u);
+    ev.data.u64 = &c - conns_.data();
+    epoll_ctl(epfd_, EPOLL_CTL_MOD, c.fd, &ev);
+  }
+
+  // 按计划（或闭环时尽快）把请求写入连接，流水线深度内不等响应
+  void Pump_(Conn &c, int64_t now) {
+    if (c.connecting) {
+      return;
+    }
+    while (c.inflight.size() < depth_ && (opt_.rate <= 0 || c.nextDue <= now)) {
+      const Kind kind = static_cast<Kind>(pick_(rng_));
+      c.out += requests_[kind];
+      c.inflight.push_back({opt_.rate > 0 ? c.nextDue : now, now, kind});
+      c.nextDue += interval_;
+      stats_.sent++;
+    }
+    Flush_(c);
+  }
+
+  void Flush_(Conn &c) {
+    while (c.outOff < c.out.size()) {
+      const ssize_t n = send(c.fd, c.out.data() + c.outOff,
+                             c.out.size() - c.outOff, MSG_NOSIGNAL);
+      if (n < 0) {
+        if (errno == EAGAIN) {
+          WatchWrite_(c, true);
+        } else {
+          Drop_(c, false);
+        }
+        return;
+      }
+      c.outOff += n;
+    }
+    c.out.clear();
+    c.outOff = 0;
+    WatchWrite_(c, false);
+  }
+
+  void OnEvent_(Conn &c, uint32_t events) {
+    if (c.fd < 0) {
+      return;
+    }
+    if (c.connecting) {
+      int err = 0;
+      socklen_t len = sizeof(err);
+      getsockopt(c.fd, SOL_SOCKET, SO_ERROR, &err, &len);
+      if (err != 0 || (events & (EPOLLERR | EPOLLHUP))) {
+        Drop_(c, true);
+        return;
+      }
+      c.connecting = false;
+      c.everConnected = true;
+      WatchWrite_(c, false);
+      if (NowNs() < end_) {
+        Pump_(c, NowNs());
+      }
+      return;
+    }
+    if (events & EPOLLIN) {
+      char buf[1 << 16];
+      for (;;) {
+        const ssize_t n = recv(c.fd, buf, sizeof(buf), 0);
+        if (n > 0) {
+          stats_.bytes += n;
+          if (!Feed_(c, buf, n)) {
+            return; // 连接已按响应要求关闭
+          }
+          continue;
+        }
+        if (n < 0 && errno == EAGAIN) {
+          break;
+        }
+        Drop_(c, false); // 对端关闭或出错
+        return;
+      }
+    }
+    if (events & (EPOLLERR | EPOLLHUP)) {
+      Drop_(c, false);
+      return;
+    }
+    if ((events & EPOLLOUT) && c.fd >= 0) {
+      Flush_(c);
+    }
+  }
+
+  // 解析响应流；连接因 Connection: close 被关闭时返回 false
+  bool Feed_(Conn &c, const char *p, size_t n) {
+    while (n > 0) {
+      if (c.inBody) {
+        const size_t take = std::min<uint64_t>(c.bodyLeft, n);
+        c.bodyLeft -= take;
+        p += take;
+        n -= take;
+        if (c.bodyLeft == 0 && !Complete_(c)) {
+          return false;
+        }
+        continue;
+      }
+      const size_t old = c.head.size();
+      c.head.append(p, n);
+      const size_t end =
+          c.head.find("\r\n\r\n", old >= 3 ? old - 3 : 0);
+      if (end == std::string::npos) {
+        return true;
+      }
+      const size_t rest = c.head.size() - (end + 4);
+      p += n - rest;
+      n = rest;
+      c.head.resize(end + 2);
+      ParseHead_(c);
+      c.inBody = true;
+      if (c.bodyLeft == 0 && !Complete_(c)) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  static void ParseHead_(Conn &c) {
+    for (auto &ch : c.head) {
+      ch = static_cast<char>(tolower(static_cast<unsigned char>(ch)));
+    }
+    c.status = 0;
+    if (c.head.compare(0, 5, "http/") == 0) {
+      const size_t sp = c.head.find(' ');
+      if (sp != std::string::npos) {
+        c.status = atoi(c.head.c_str() + sp + 1);
+      }
+    }
+    c.bodyLeft = 0;
+    const size_t cl = c.head.find("\r\ncontent-length:");
+    if (cl != std::string::npos) {
+      c.bodyLeft = strtoull(c.head.c_str() + cl + 17, nullptr, 10);
+    }
+    c.closeAfter = c.head.find("\r\nconnection: close") != std::string::npos;
+  }
+
+  bool Complete_(Conn &c) {
+    c.inBody = false;
+    c.head.clear();
+    if (c.inflight.empty()) {
+      stats_.ioErrors++; // 多出来的响应
+    } else {
+      const Pending req = c.inflight.front();
+      c.inflight.pop_front();
+      Record_(req, c.status);
+    }
+    if (c.closeAfter || !opt_.keepAlive) {
+      Drop_(c, false);
+      return false;
+    }
+    return true;
+  }
+
+  void Record_(const Pending &req, int status) {
+    if (req.intended < warmupEnd_) {
+      stats_.warmupResponses++;
+      return;
+    }
+    const int64_t now = NowNs();
+    const uint64_t latency = now - req.intended;
+    const uint64_t service = now - req.sent;
+    stats_.responses++;
+    stats_.status[status >= 100 && status < 600 ? status / 100 : 0]++;
+    stats_.kindResponses[req.kind]++;
+    stats_.latency.record(latency);
+    stats_.latencyRange.add(latency);
+    stats_.service.record(service);
+    stats_.serviceRange.add(service);
+    stats_.kindLatency[req.kind].record(latency);
+  }
+
+  bool Idle_() const {
+    for (const auto &c : conns_) {
+      if (c.fd >= 0 && !c.inflight.empty()) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  void ArmTimer_(int64_t at) {
+    itimerspec spec{};
+    at = std::max<int64_t>(at, 1);
+    spec.it_value.tv_sec = at / 1000000000;
+    spec.it_value.tv_nsec = at % 1000000000;
+    timerfd_settime(timerFd_, TFD_TIMER_ABSTIME, &spec, nullptr);
+  }
+
+  const Options &opt_;
+  sockaddr_in addr_;
+  std::vector<Conn> conns_;
+  std::mt19937_64 rng_; // 按线程编号播种，请求序列可复现
+  std::discrete_distribution<int> pick_;
+  std::array<std::string, KIND_COUNT> requests_;
+  int64_t warmupEnd_ = 0;
+  int64_t end_ = 0;
+  size_t depth_ = 1;
+  int64_t interval_ = 0;
+  int epfd_ = -1;
+  int timerFd_ = -1;
+  Stats stats_;
+};
+
+struct Report {
+  Stats total;
+  Histogram::Snapshot latency;
+  Histogram::Snapshot service;
+  std::array<Histogram::Snapshot, KIND_COUNT> kind;
+  double seconds = 0;
+};
+
+std::string LatencyJson(const Histogram::Snapshot &h, const Extremes &range) {
+  // 分位值取桶上界，可能略大于实际最大值
+  auto us = [&](uint64_t ns) { return std::min(ns, range.max) / 1000.0; };
+  return std::format(
+      "{{\"min\": {:.1f}, \"mean\": {:.1f}, \"p50\": {:.1f}, \"p90\": {:.1f}, "
+      "\"p99\": {:.1f}, \"p99.9\": {:.1f}, \"p99.99\": {:.1f}, \"max\": "
+      "{:.1f}}}",
+      h.count ? us(range.min) : 0.0,
+      h.count ? h.sum / 1000.0 / static_cast<double>(h.count) : 0.0,
+      us(h.quantile(0.5)), us(h.quantile(0.9)), us(h.quantile(0.99)),
+      us(h.quantile(0.999)), us(h.quantile(0.9999)), us(range.max));
+}
+
+std::string ReportJson(const Options &opt, const Report &r) {
+  const Stats &s = r.total;
+  std::string mix;
+  std::string kinds;
+  for (int k = 0; k < KIND_COUNT; ++k) {
+    if (opt.mix[k] <= 0) {
+      continue;
+    }
+    mix += std::format("{}\"{}\": {}", mix.empty() ? "" : ", ", KindNames[k],
+                       opt.mix[k]);
+    kinds += std::format(
+        "{}\n    \"{}\": {{\"responses\": {}, \"p50_us\": {:.1f}, \"p99_us\": "
+        "{:.1f}}}",
+        kinds.empty() ? "" : ",", KindNames[k], s.kindResponses[k],
+        r.kind[k].quantile(0.5) / 1000.0, r.kind[k].quantile(0.99) / 1000.0);
+  }
+  return std::format(
+      "{{\n"
+      "  \"config\": {{\"host\": \"{}\", \"port\": {}, \"connections\": {}, "
+      "\"threads\": {}, \"duration_s\": {}, \"warmup_s\": {}, "
+      "\"keep_alive\": {}, \"pipeline\": {}, \"rate\": {}, \"mix\": {{{}}}}},\n"
+      "  \"window_s\": {:.3f},\n"
+      "  \"requests_sent\": {},\n"
+      "  \"responses\": {},\n"
+      "  \"throughput_rps\": {:.1f},\n"
+      "  \"bytes_per_s\": {:.0f},\n"
+      "  \"status\": {{\"2xx\": {}, \"3xx\": {}, \"4xx\": {}, \"5xx\": {}, "
+      "\"other\": {}}},\n"
+      "  \"errors\": {{\"connect\": {}, \"io\": {}, \"unfinished\": {}}},\n"
+      "  \"reconnects\": {},\n"
+      "  \"latency_us\": {},\n"
+      "  \"service_time_us\": {},\n"
+      "  \"by_kind\": {{{}\n  }}\n"
+      "}}\n",
+      opt.host, opt.port, opt.connections, opt.threads, opt.duration,
+      opt.warmup, opt.keepAlive, opt.keepAlive ? opt.pipeline : 1, opt.rate,
+      mix, r.seconds, s.sent, s.responses,
+      r.seconds > 0 ? s.responses / r.seconds : 0.0,
+      r.seconds > 0 ? s.bytes / r.seconds : 0.0, s.status[2], s.status[3],
+      s.status[4], s.status[5], s.status[0] + s.status[1], s.connectErrors,
+      s.ioErrors, s.unfinished, s.reconnects,
+      LatencyJson(r.latency, s.latencyRange),
+      LatencyJson(r.service, s.serviceRange), kinds);
+}
+
+bool RunLoad(const Options &opt, Report &report) {
+  sockaddr_in addr{};
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons(opt.port);
+  if (inet_pton(AF_INET, opt.host.c_str(), &addr.sin_addr) != 1) {
+    std::cerr << "invalid IPv4 address: " << opt.host << std::endl;
+    return false;
+  }
+  const int threads = std::clamp(opt.threads, 1, opt.connections);
+  const int64_t start = NowNs();
+  std::vector<std::unique_ptr<Worker>> workers;
+  for (int i = 0; i < threads; ++i) {
+    const int conns = opt.connections / threads + (i < opt.connections % threads);
+    workers.push_back(std::make_unique<Worker>(opt, addr, i, conns, start));
+  }
+  std::vector<std::thread> running;
+  for (auto &w : workers) {
+    running.emplace_back([&w] { w->Run(); });
+  }
+  for (auto &t : running) {
+    t.join();
+  }
+  report.seconds = opt.duration;
+  Stats &total = report.total;
+  for (auto &w : workers) {
+    Stats &s = w->stats();
+    total.sent += s.sent;
+    total.responses += s.responses;
+    total.warmupResponses += s.warmupResponses;
+    total.bytes += s.bytes;
+    total.connectErrors += s.connectErrors;
+    total.ioErrors += s.ioErrors;
+    total.unfinished += s.unfinished;
+    total.reconnects += s.reconnects;
+    for (size_t i = 0; i < s.status.size(); ++i) {
+      total.status[i] += s.status[i];
+    }
+    for (int k = 0; k < KIND_COUNT; ++k) {
+      total.kindResponses[k] += s.kindResponses[k];
+      s.kindLatency[k].add_to(report.kind[k]);
+    }
+    total.latencyRange.add(s.latencyRange);
+    total.serviceRange.add(s.serviceRange);
+    s.latency.add_to(report.latency);
+    s.service.add_to(report.service);
+  }
+  return true;
+}
+
+// "index=80,image=15,login=5"
+bool ParseMix(const char *spec, std::array<double, KIND_COUNT> &mix) {
+  mix.fill(0);
+  std::string s(spec);
+  size_t pos = 0;
+  double total = 0;
+  while (pos < s.size()) {
+    size_t comma = s.find(',', pos);
+    if (comma == std::string::npos) {
+      comma = s.size();
+    }
+    const std::string item = s.substr(pos, comma - pos);
+    const size_t eq = item.find('=');
+    const std::string name = item.substr(0, eq);
+    int k = 0;
+    while (k < KIND_COUNT && name != KindNames[k]) {
+      ++k;
+    }
+    if (k == KIND_COUNT) {
+      return false;
+    }
+    mix[k] = eq == std::string::npos ? 1 : atof(item.c_str() + eq + 1);
+    total += mix[k];
+    pos = comma + 1;
+  }
+  return total > 0;
+}
+
+// --quick 使用的桩服务器：对每个完整请求回一个固定的小响应
+class StubServer {
+public:
+  StubServer() {
+    listenFd_ = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK, 0);
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    bind(listenFd_, reinterpret_cast<sockaddr *>(&addr), sizeof(addr));
+    listen(listenFd_, 128);
+    socklen_t len = sizeof(addr);
+    getsockname(listenFd_, reinterpret_cast<sockaddr *>(&addr), &len);
+    port_ = ntohs(addr.sin_port);
+    stopFd_ = eventfd(0, EFD_NONBLOCK);
+    thread_ = std::thread([this] { Loop_(); });
+  }
+
+  ~StubServer() {
+    uint64_t one = 1;
+    while (::write(stopFd_, &one, sizeof(one)) < 0 && errno == EINTR) {
+    }
+    thread_.join();
+    close(stopFd_);
+    close(listenFd_);
+  }
+
+  int port() const { return port_; }
+
+private:
+  void Loop_() {
+    const int ep = epoll_create1(0);
+    epoll_event ev{};
+    ev.events = EPOLLIN;
+    ev.data.fd = listenFd_;
+    epoll_ctl(ep, EPOLL_CTL_ADD, listenFd_, &ev);
+    ev.data.fd = stopFd_;
+    epoll_ctl(ep, EPOLL_CTL_ADD, stopFd_, &ev);
+    std::unordered_map<int, std::string> pending;
+    epoll_event events[64];
+    for (;;) {
+      const int n = epoll_wait(ep, events, 64, -1);
+      for (int i = 0; i < n; ++i) {
+        const int fd = events[i].data.fd;
+        if (fd == stopFd_) {
+          for (auto &[cfd, buf] : pending) {
+            close(cfd);
+          }
+          close(ep);
+          return;
+        }
+        if (fd == listenFd_) {
+          int cfd;
+          while ((cfd = accept4(listenFd_, nullptr, nullptr,
+                                SOCK_NONBLOCK)) >= 0) {
+            ev.data.fd = cfd;
+            epoll_ctl(ep, EPOLL_CTL_ADD, cfd, &ev);
+            pending[cfd];
+          }
+          continue;
+        }
+        if (!Serve_(fd, pending[fd])) {
+          epoll_ctl(ep, EPOLL_CTL_DEL, fd, nullptr);
+          close(fd);
+          pending.erase(fd);
+        }
+      }
+    }
+  }
+
+  static bool Serve_(int fd, std::string &in) {
+    char buf[4096];
+    ssize_t n;
+    while ((n = recv(fd, buf, sizeof(buf), 0)) > 0) {
+      in.append(buf, n);
+    }
+    if (n == 0 || (n < 0 && errno != EAGAIN)) {
+      return false;
+    }
+    std::string out;
+    bool keep = true;
+    for (;;) {
+      const size_t end = in.find("\r\n\r\n");
+      if (end == std::string::npos) {
+        break;
+      }
+      size_t body = 0;
+      const size_t cl = in.find("Content-Length: ");
+      if (cl != std::string::npos && cl < end) {
+        body = strtoull(in.c_str() + cl + 16, nullptr, 10);
+      }
+      if (in.size() < end + 4 + body) {
+        break;
+      }
+      keep = in.find("Connection: close") > end;
+      in.erase(0, end + 4 + body);
+      out += keep ? "HTTP/1.1 200 OK\r\nConnection: keep-alive\r\n"
+                    "Content-length: 5\r\n\r\nhello"
+                  : "HTTP/1.1 200 OK\r\nConnection: close\r\n"
+                    "Content-length: 5\r\n\r\nhello";
+    }
+    if (!out.empty()) {
+      send(fd, out.data(), out.size(), MSG_NOSIGNAL);
+    }
+    return keep;
+  }
+
+  int listenFd_ = -1;
+  int stopFd_ = -1;
+  int port_ = 0;
+  std::thread thread_;
+};
+
+// ctest 冒烟：闭环 + 流水线、定速、短连接三种模式各跑一小段，请求必须全部成功
+int QuickSelfTest() {
+  StubServer stub;
+  Options base;
+  base.port = stub.port();
+  base.connections = 4;
+  base.threads = 2;
+  base.duration = 0.2;
+  base.warmup = 0.05;
+  base.mix = {4, 1, 1, 1};
+
+  Options pipelined = base;
+  pipelined.pipeline = 4;
+  Options paced = base;
+  paced.rate = 2000;
+  Options shortConn = base;
+  shortConn.keepAlive = false;
+  for (const Options *opt : {&pipelined, &paced, &shortConn}) {
+    Report r;
+    RunLoad(*opt, r);
+    const Stats &s = r.total;
+    const std::string json = ReportJson(*opt, r);
+    std::cout << json;
+    if (s.responses == 0 || s.status[2] != s.responses || s.ioErrors != 0 ||
+        s.connectErrors != 0 || s.unfinished != 0 ||
+        r.latency.count != s.responses) {
+      std::cerr << "load run failed" << std::endl;
+      return 1;
+    }
+    // 定速模式：合计 2000 req/s，0.2s 的统计窗口内约 400 个
+    if (opt->rate > 0 && (s.responses < 250 || s.responses > 450)) {
+      std::cerr << "paced run answered " << s.responses << std::endl;
+      return 1;
+    }
+  }
+  return 0;
+}
+
+void Usage(const char *prog) {
+  std::cerr
+      << "usage: " << prog
+      << " [-h HOST] [-p PORT] [-c CONNECTIONS] [-t THREADS] [-d SECONDS]\n"
+         "       [-w WARMUP_SECONDS] [-k KEEP_ALIVE] [-P PIPELINE] [-R RATE]\n"
+         "       [-m index=N,image=N,video=N,login=N] [-u USER:PASSWORD]\n"
+         "       [-o JSON_FILE] | --quick\n";
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+  for (int i = 1; i < argc; ++i) {
+    if (strcmp(argv[i], "--quick") == 0) {
+      return QuickSelfTest();
+    }
+  }
+  Options opt;
+  int c;
+  while ((c = getopt(argc, argv, "h:p:c:t:d:w:k:P:R:m:u:o:")) != -1) {
+    switch (c) {
+    case 'h':
+      opt.host = optarg;
+      break;
+    case 'p':
+      opt.port = atoi(optarg);
+      break;
+    case 'c':
+      opt.connections = std::max(atoi(optarg), 1);
+      break;
+    case 't':
+      opt.threads = std::max(atoi(optarg), 1);
+      break;
+    case 'd':
+      opt.duration = std::max(atof(optarg), 0.001);
+      break;
+    case 'w':
+      opt.warmup = std::max(atof(optarg), 0.0);
+      break;
+    case 'k':
+      opt.keepAlive = atoi(optarg);
+      break;
+    case 'P':
+      opt.pipeline = std::max(atoi(optarg), 1);
+      break;
+    case 'R':
+      opt.rate = std::max(atof(optarg), 0.0);
+      break;
+    case 'm':
+      if (!ParseMix(optarg, opt.mix)) {
+        std::cerr << "bad mix: " << optarg << std::endl;
+        return 1;
+      }
+      break;
+    case 'u': {
+      const std::string cred = optarg;
+      const size_t colon = cred.find(':');
+      opt.user = cred.substr(0, colon);
+      opt.password = colon == std::string::npos ? "" : cred.substr(colon + 1);
+      break;
+    }
+    case 'o':
+      opt.output = optarg;
+      break;
+    default:
+      Usage(argv[0]);
+      return 1;
+    }
+  }
+  Report report;
+  if (!RunLoad(opt, report)) {
+    return 1;
+  }
+  const std::string json = ReportJson(opt, report);
+  if (opt.output.empty()) {
+    std::cout << json;
+  } else {
+    std::ofstream(opt.output) << json;
+  }
+  const Stats &s = report.total;
+  std::cerr << std::format(
+      "{:.0f} req/s, p50 {:.0f}us, p99 {:.0f}us, errors {}\n",
+      s.responses / report.seconds, report.latency.quantile(0.5) / 1000.0,
+      report.latency.quantile(0.99) / 1000.0,
+      s.connectErrors + s.ioErrors + s.unfinished);
+  return 0;
+}
@@ -0,0 +1,300 @@
+// Hot-path microbenchmarks: Buffer, HTTPRequest::parse,
+// HTTPResponse::MakeResponse, HeapTimer, ThreadPool::enqueue, MessageBuffer
+// and Logger::write_log
+#include "HTTPRequest.hpp"
+#include "HTTPResponse.hpp"
+#include "bench_harness.hpp"
+#include "buffer.hpp"
+#include "heaptimer.hpp"
+#include "logger.hpp"
+#include "message_buffer.hpp"
+#include "mpsc_ring.hpp"
+#include "thread_pool.hpp"
+
+#include <filesystem>
+#include <future>
+#include <string>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+using Web::HTTPRequest;
+using Web::HTTPResponse;
+
+static const std::string GET_REQUEST =
+    "GET /images/profile-image.jpg HTTP/1.1\r\n"
+    "Host: 127.0.0.1:9999\r\n"
+    "User-Agent: Mozilla/5.0 (X11; Linux x86_64) AppleWebKit/537.36\r\n"
+    "Accept: image/avif,image/webp,image/apng,image/*,*/*;q=0.8\r\n"
+    "Accept-Encoding: gzip, deflate, br\r\n"
+    "Accept-Language: zh-CN,zh;q=0.9,en;q=0.8\r\n"
+    "Connection: keep-alive\r\n"
+    "\r\n";
+
+static const std::string LOGIN_REQUEST =
+    "POST /login HTTP/1.1\r\n"
+    "Host: 127.0.0.1:9999\r\n"
+    "User-Agent: Mozilla/5.0 (X11; Linux x86_64) AppleWebKit/537.36\r\n"
+    "Content-Type: application/x-www-form-urlencoded\r\n"
+    "Content-Length: 34\r\n"
+    "Connection: keep-alive\r\n"
+    "\r\n"
+    "username=alice&password=p%40ssw0rd";
+
+// 与连接读缓冲的用法相同：追加、查看、按段取走
+static void RunBuffer(Bench::Runner &runner) {
+  runner.Run("Buffer/append_retrieve_64B", [&](uint64_t n) {
+    Buffer buff;
+    const std::string chunk(64, 'x');
+    for (uint64_t i = 0; i < n; i++) {
+      buff.Append(chunk);
+      Bench::DoNotOptimize(*buff.Peek());
+      buff.Retrieve(chunk.size());
+    }
+  });
+  runner.Run("Buffer/append_request_to_str", [&](uint64_t n) {
+    Buffer buff;
+    for (uint64_t i = 0; i < n; i++) {
+      buff.Append(GET_REQUEST);
+      Bench::DoNotOptimize(buff.RetrieveAllToStr());
+    }
+  });
+  // 读缓冲里总留着半个请求，每次写满前都要把剩余数据搬回开头
+  runner.Run("Buffer/append_partial_1460", [&](uint64_t n) {
+    Buffer buff(4096);
+    const std::string chunk(1460, 'x');
+    for (uint64_t i = 0; i < n; i++) {
+      buff.Append(chunk);
+      buff.Retrieve(buff.ReadableBytes() - 700);
+    }
+  });
+}
+
+// 每次都与 HTTPConn 一样先 init 再解析，复用请求对象里的字符串容量
+static void RunRequest(Bench::Runner &runner) {
+  for (auto [name, text] : {std::pair{"get", &GET_REQUEST},
+                            std::pair{"post_login", &LOGIN_REQUEST}}) {
+    runner.Run(std::string("HTTPRequest/parse_") + name, [&](uint64_t n) {
+      HTTPRequest request;
+      Buffer buff;
+      for (uint64_t i = 0; i < n; i++) {
+        request.init();
+        buff.Append(*text);
+        request.parse(buff);
+        Bench::DoNotOptimize(request.path());
+        buff.RetrieveAll();
+      }
+    });
+  }
+  runner.Run("HTTPRequest/needs_database", [&](uint64_t n) {
+    Buffer buff;
+    buff.Append(LOGIN_REQUEST);
+    for (uint64_t i = 0; i < n; i++) {
+      Bench::DoNotOptimize(HTTPRequest::NeedsDatabase(buff));
+    }
+  });
+}
+
+// 响应头写入写缓冲；文件经 stat/open/mmap，与真实请求一致
+static void RunResponse(Bench::Runner &runner) {
+  const std::string srcDir = RESOURCE_DIR;
+  for (auto [name, path] :
+       {std::pair{"index", "/index.html"}, std::pair{"404", "/missing.html"}}) {
+    runner.Run(std::string("HTTPResponse/make_") + name, [&](uint64_t n) {
+      HTTPResponse response;
+      Buffer buff;
+      for (uint64_t i = 0; i < n; i++) {
+        response.Init(srcDir, path, true);
+        response.MakeResponse(buff);
+        Bench::DoNotOptimize(response.File());
+        response.UnmapFile();
+        buff.RetrieveAll();
+      }
+    });
+  }
+  runner.Run("HTTPResponse/make_body_1KB", [&](uint64_t n) {
+    HTTPResponse response;
+    Buffer buff;
+    const std::string body(1024, 'm');
+    for (uint64_t i = 0; i < n; i++) {
+      response.Init(srcDir, "/metrics", true);
+      response.MakeBodyResponse(buff, "text/plain; version=0.0.4", body);
+      buff.RetrieveAll();
+    }
+  });
+}
+
+// 服务器里每个连接一个定时器：收到请求时延长，关闭时删除。
+// 堆在计时之外预先填满，各用例结束时堆大小不变
+static void RunTimer(Bench::Runner &runner) {
+  const int CONNS = 10000;
+  const int TIMEOUT_MS = 60000;
+  HeapTimer timer;
+  for (int fd = 0; fd < CONNS; fd++) {
+    timer.add(fd, TIMEOUT_MS + fd % 1000, [] {});
+  }
+  runner.Run("HeapTimer/add_existing_10k", [&](uint64_t n) {
+    for (uint64_t i = 0; i < n; i++) {
+      timer.add(static_cast<int>(i % CONNS), TIMEOUT_MS, [] {});
+    }
+  });
+  runner.Run("HeapTimer/adjust_10k", [&](uint64_t n) {
+    for (uint64_t i = 0; i < n; i++) {
+      timer.adjust(static_cast<int>(i % CONNS), TIMEOUT_MS);
+    }
+  });
+  // 旧连接关闭、新连接加入
+  runner.Run("HeapTimer/close_add_10k", [&](uint64_t n) {
+    for (uint64_t i = 0; i < n; i++) {
+      const int fd = static_cast<int>(i % CONNS);
+      timer.doWork(fd);
+      timer.add(fd, TIMEOUT_MS, [] {});
+    }
+  });
+  runner.Run("HeapTimer/next_tick_10k", [&](uint64_t n) {
+    for (uint64_t i = 0; i < n; i++) {
+      Bench::DoNotOptimize(timer.GetNextTick());
+    }
+  });
+}
+
+static void RunThreadPool(Bench::Runner &runner) {
+  // 单个任务的往返：入队、唤醒工作线程、等待结果
+  runner.Run("ThreadPool/enqueue_wait", [&](uint64_t n) {
+    ThreadPool pool(1);
+    for (uint64_t i = 0; i < n; i++) {
+      pool.enqueue([] {}).get();
+    }
+  });
+  // 成批入队后统一等待，均摊到每个任务
+  for (size_t threads : {1, 4}) {
+    runner.Run("ThreadPool/enqueue_batch64_" + std::to_string(threads) + "t",
+               [&](uint64_t n) {
+                 ThreadPool pool(threads);
+                 std::vector<std::future<void>> pending;
+                 pending.reserve(64);
+                 for (uint64_t i = 0; i < n; i += 64) {
+                   for (uint64_t j = i; j < n && j < i + 64; j++) {
+                     pending.push_back(pool.enqueue([] {}));
+                   }
+                   for (auto &f : pending) {
+                     f.get();
+                   }
+                   pending.clear();
+                 }
+               });
+  }
+}
+
+// MessageBuffer（加锁环形队列）与日志现在使用的 MpscRing 对比
+static void RunQueues(Bench::Runner &runner) {
+  runner.Run("MessageBuffer/push_pop", [&](uint64_t n) {
+    MessageBuffer<std::string> queue(1024);
+    std::string out;
+    for (uint64_t i = 0; i < n; i++) {
+      queue.push_back(std::string("log line"));
+      queue.pop_front(out);
+    }
+    Bench::DoNotOptimize(out);
+  });
+  runner.Run("MpscRing/push_pop", [&](uint64_t n) {
+    MpscRing<std::string> queue(1024);
+    std::string out;
+    for (uint64_t i = 0; i < n; i++) {
+      queue.push(std::string("log line"));
+      queue.pop(out);
+    }
+    Bench::DoNotOptimize(out);
+  });
+  // 生产者与消费者在不同线程，队列满时互相等待
+  for (int producers : {1, 4}) {
+    const std::string suffix = "_" + std::to_string(producers) + "p";
+    runner.Run("MessageBuffer/threads" + suffix, [&](uint64_t n) {
+      MessageBuffer<std::string> queue(1024);
+      std::vector<std::thread> threads;
+      for (int p = 0; p < producers; p++) {
+        threads.emplace_back([&, p] {
+          for (uint64_t i = p; i < n; i += producers) {
+            queue.push_back(std::string("log line"));
+          }
+        });
+      }
+      std::string out;
+      for (uint64_t i = 0; i < n; i++) {
+        queue.pop_front(out);
+      }
+      for (auto &t : threads) {
+        t.join();
+      }
+    });
+    runner.Run("MpscRing/threads" + suffix, [&](uint64_t n) {
+      MpscRing<std::string> queue(1024);
+      std::vector<std::thread> threads;
+      for (int p = 0; p < producers; p++) {
+        threads.emplace_back([&, p] {
+          for (uint64_t i = p; i < n; i += producers) {
+            queue.push(std::string("log line"));
+          }
+        });
+      }
+      // 与日志线程一样成批取出
+      std::vector<std::string> batch;
+      for (uint64_t got = 0; got < n;) {
+        batch.clear();
+        got += queue.pop_batch(batch, 256);
+      }
+      for (auto &t : threads) {
+        t.join();
+      }
+    });
+  }
+}
+
+// 调用线程上的开销：异步模式下只格式化并入队，写文件在日志线程
+static void RunLogger(Bench::Runner &runner) {
+  Logger *log = Logger::get_instance();
+  runner.Run("Logger/write_log_text", [&](uint64_t n) {
+    for (uint64_t i = 0; i < n; i++) {
+      log->write_log(LOG_LEVEL_INFO, "Client[{}] in, userCount:{}", 42,
+                     static_cast<int>(i));
+    }
+    log->flush();
+  });
+  runner.Run("Logger/LOG_INFO_path", [&](uint64_t n) {
+    std::string path = "/images/profile-image.jpg";
+    for (uint64_t i = 0; i < n; i++) {
+      LOG_INFO("[{}], [{}], [{}]", "GET", path, "1.1");
+    }
+    log->flush();
+  });
+  // 级别不够时只有一次原子读
+  runner.Run("Logger/LOG_DEBUG_disabled", [&](uint64_t n) {
+    for (uint64_t i = 0; i < n; i++) {
+      LOG_DEBUG("file path {}", i);
+    }
+  });
+}
+
+int main(int argc, char *argv[]) {
+  namespace fs = std::filesystem;
+  Bench::Runner runner(argc, argv);
+  RunBuffer(runner);
+  RunRequest(runner);
+  RunResponse(runner);
+  RunTimer(runner);
+  RunThreadPool(runner);
+  RunQueues(runner);
+
+  // 日志固定写到 log/ 下，放进临时目录，结束后删除
+  const fs::path dir =
+      fs::temp_directory_path() / ("bench_micro_" + std::to_string(getpid()));
+  const fs::path cwd = fs::current_path();
+  fs::create_directories(dir / "log");
+  fs::current_path(dir);
+  Logger::init("bench", false, 5000000, 1 << 14);
+  RunLogger(runner);
+  Logger::get_instance()->flush();
+  fs::current_path(cwd);
+  fs::remove_all(dir);
+  return 0;
+}
@@ -0,0 +1,103 @@
+// SQLite::QueryResult vs ResultSet vs for_each_row over the same SELECTs
+#include "bench_harness.hpp"
+#include "sqlite.hpp"
+
+#include <filesystem>
+#include <format>
+#include <future>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+using Database::ResultSet;
+using Database::Row;
+using Database::SQLite;
+
+static const char *SCAN = "SELECT id, username, password FROM user";
+static const char *POINT =
+    "SELECT id, username, password FROM user WHERE username=? LIMIT 1";
+
+// 与 UserCache::rebuild_filter 一样逐行取用户名，只累加长度防止被优化掉
+static void RunScans(Bench::Runner &runner, SQLite &sql) {
+  runner.Run("scan/QueryResult", [&](uint64_t n) {
+    for (uint64_t i = 0; i < n; i++) {
+      size_t total = 0;
+      auto res = sql.query(SCAN);
+      for (const auto &row : res->rows) {
+        total += row[1].size();
+      }
+      Bench::DoNotOptimize(total);
+    }
+  });
+  runner.Run("scan/ResultSet", [&](uint64_t n) {
+    ResultSet res;
+    for (uint64_t i = 0; i < n; i++) {
+      size_t total = 0;
+      sql.query(SCAN, res);
+      for (size_t r = 0; r < res.rows(); r++) {
+        total += res.get_text(r, 1).size();
+      }
+      Bench::DoNotOptimize(total);
+    }
+  });
+  runner.Run("scan/for_each_row", [&](uint64_t n) {
+    for (uint64_t i = 0; i < n; i++) {
+      size_t total = 0;
+      sql.for_each_row(SCAN, {}, [&](const Row &row) {
+        total += row.get_text(1).size();
+        return true;
+      });
+      Bench::DoNotOptimize(total);
+    }
+  });
+}
+
+// 登录路径上的单行查询：这里结果很小，差别主要在每次查询的固定分配
+static void RunPoint(Bench::Runner &runner, SQLite &sql) {
+  runner.Run("point/QueryResult", [&](uint64_t n) {
+    for (uint64_t i = 0; i < n; i++) {
+      auto res = sql.query(POINT, {"user500"});
+      Bench::DoNotOptimize(std::stoll(res->rows[0][0]));
+    }
+  });
+  runner.Run("point/ResultSet", [&](uint64_t n) {
+    ResultSet res;
+    for (uint64_t i = 0; i < n; i++) {
+      sql.query(POINT, {"user500"}, res);
+      Bench::DoNotOptimize(res.get_int(0, 0));
+    }
+  });
+}
+
+int main(int argc, char *argv[]) {
+  namespace fs = std::filesystem;
+  Bench::Runner runner(argc, argv);
+  const std::string path = std::format("bench_query_{}.db", getpid());
+  {
+    // 只读连接要求文件已存在
+    sqlite3 *db = nullptr;
+    sqlite3_open(path.c_str(), &db);
+    sqlite3_close(db);
+  }
+  SQLite::init(path, 1);
+  SQLite &sql = *SQLite::get_instance();
+  sql.execute("CREATE TABLE user(id INTEGER PRIMARY KEY, "
+              "username TEXT UNIQUE, password TEXT)");
+  std::vector<std::future<SQLite::WriteResult>> pending;
+  for (int i = 0; i < 10000; i++) {
+    const std::string name = std::format("user{}", i);
+    pending.push_back(sql.submit(
+        "INSERT INTO user(username, password) VALUES(?, ?)", {name, "pw"}));
+  }
+  for (auto &f : pending) {
+    f.get();
+  }
+
+  RunScans(runner, sql);
+  RunPoint(runner, sql);
+
+  fs::remove(path);
+  fs::remove(path + "-wal");
+  fs::remove(path + "-shm");
+  return 0;
+}
@@ -1,18 +1,57 @@
 #include "buffer.hpp"
+#include <algorithm>
 
-Buffer::Buffer(int initBuffSize)
-    : buffer_(initBuffSize), readPos_(0), writePos_(0) {}
+Buffer::Buffer(int initBuffSize, bool chained)
+    : initSize_(initBuffSize), readPos_(0), writePos_(0), chained_(chained),
+      chainBytes_(0) {
+  block_ = BufferPool::Instance().Acquire(initBuffSize);
+}
+
+Buffer::~Buffer() {
+  auto &pool = BufferPool::Instance();
+  for (auto &seg : chain_) {
+    pool.Release(seg.block);
+  }
+  pool.Release(block_);
+}
 
-size_t Buffer::ReadableBytes() const { return writePos_ - readPos_; }
-size_t Buffer::WritableBytes() const { return buffer_.size() - writePos_; }
+size_t Buffer::ReadableBytes() const {
+  return writePos_ - readPos_ + chainBytes_;
+}
+size_t Buffer::WritableBytes() const {
+  if (!chain_.empty()) {
+    return chain_.back().block.size - chain_.back().writePos;
+  }
+  return block_.size - writePos_;
+}
 
 size_t Buffer::PrependableBytes() const { return readPos_; }
 
+size_t Buffer::Capacity() const {
+  size_t n = block_.size;
+  for (auto &seg : chain_) {
+    n += seg.block.size;
+  }
+  return n;
+}
+
 const char *Buffer::Peek() const { return BeginPtr_() + readPos_; }
 
 void Buffer::Retrieve(size_t len) {
   assert(len <= ReadableBytes());
-  readPos_ += len;
+  size_t head = std::min(len, writePos_ - readPos_);
+  readPos_ += head;
+  len -= head;
+  while (len > 0) {
+    /* 第一段已读完，换下一段顶上 */
+    PromoteSegment_();
+    head = std::min(len, writePos_ - readPos_);
+    readPos_ += head;
+    len -= head;
+  }
+  if (readPos_ == writePos_ && !chain_.empty()) {
+    PromoteSegment_();
+  }
 }
 
 void Buffer::RetrieveUntil(const char *end) {
@@ -21,22 +60,64 @@ void Buffer::RetrieveUntil(const char *end) {
 }
 
 void Buffer::RetrieveAll() {
-  bzero(&buffer_[0], buffer_.size());
+  auto &pool = BufferPool::Instance();
+  for (auto &seg : chain_) {
+    pool.Release(seg.block);
+  }
+  chain_.clear();
+  chainBytes_ = 0;
+  if (block_.data) {
+    bzero(block_.data, block_.size);
+  }
+  readPos_ = 0;
+  writePos_ = 0;
+}
+
+void Buffer::Release() {
+  auto &pool = BufferPool::Instance();
+  for (auto &seg : chain_) {
+    pool.Release(seg.block);
+  }
+  std::vector<Segment>().swap(chain_);
+  chainBytes_ = 0;
+  pool.Release(block_);
   readPos_ = 0;
   writePos_ = 0;
 }
 
 std::string Buffer::RetrieveAllToStr() {
-  std::string str(Peek(), ReadableBytes());
+  std::string str;
+  str.reserve(ReadableBytes());
+  str.append(Peek(), writePos_ - readPos_);
+  for (auto &seg : chain_) {
+    str.append(seg.block.data + seg.readPos, seg.writePos - seg.readPos);
+  }
   RetrieveAll();
   return str;
 }
 
-const char *Buffer::BeginWriteConst() const { return BeginPtr_() + writePos_; }
+const char *Buffer::BeginWriteConst() const {
+  if (!chain_.empty()) {
+    return chain_.back().block.data + chain_.back().writePos;
+  }
+  return BeginPtr_() + writePos_;
+}
 
-char *Buffer::BeginWrite() { return BeginPtr_() + writePos_; }
+char *Buffer::BeginWrite() {
+  if (!chain_.empty()) {
+    return chain_.back().block.data + chain_.back().writePos;
+  }
+  return BeginPtr_() + writePos_;
+}
 
-void Buffer::HasWritten(size_t len) { writePos_ += len; }
+void Buffer::HasWritten(size_t len) {
+  if (!chain_.empty()) {
+    chain_.back().writePos += len;
+    chainBytes_ += len;
+    return;
+  }
+  writePos_ += len;
+}
 
 void Buffer::Append(const std::string &str) {
   Append(str.data(), str.length());
@@ -49,67 +130,156 @@ void Buffer::Append(const void *data, size_t len) {
 
 void Buffer::Append(const char *str, size_t len) {
   assert(str);
-  EnsureWriteable(len);
-  std::copy(str, str + len, BeginWrite());
-  HasWritten(len);
+  if (!chained_ || (chain_.empty() && writePos_ - readPos_ + len <=
+                                          BufferPool::MAX_CLASS_SIZE)) {
+    EnsureWriteable(len);
+    std::copy(str, str + len, BeginWrite());
+    HasWritten(len);
+    return;
+  }
+  /* 分段写入：填满当前段后再挂新段，已写入的数据不再搬动 */
+  while (len > 0) {
+    if (WritableBytes() == 0) {
+      AddSegment_(std::min(len, BufferPool::MAX_CLASS_SIZE));
+    }
+    size_t n = std::min(len, WritableBytes());
+    std::copy(str, str + n, BeginWrite());
+    HasWritten(n);
+    str += n;
+    len -= n;
+  }
 }
 
 void Buffer::Append(const Buffer &buff) {
-  Append(buff.Peek(), buff.ReadableBytes());
+  assert(&buff != this);
+  /* 逐段拷贝，段数不受 iovec 数组大小限制 */
+  if (buff.writePos_ > buff.readPos_) {
+    Append(buff.Peek(), buff.writePos_ - buff.readPos_);
+  }
+  for (const auto &seg : buff.chain_) {
+    Append(seg.block.data + seg.readPos, seg.writePos - seg.readPos);
+  }
 }
 
 void Buffer::EnsureWriteable(size_t len) {
   if (WritableBytes() < len) {
-    MakeSpace_(len);
+    if (chained_ && (!chain_.empty() ||
+                     writePos_ - readPos_ + len > BufferPool::MAX_CLASS_SIZE)) {
+      AddSegment_(len);
+    } else {
+      MakeSpace_(len);
+    }
   }
   assert(WritableBytes() >= len);
 }
 
 ssize_t Buffer::ReadFd(int fd, int *saveErrno) {
-  char buff[65535];
+  /* 溢出部分读进池里的 64K 块，而不是每次在栈上开 64K 数组 */
+  EnsureBlock_();
+  auto &pool = BufferPool::Instance();
+  BufferPool::Block spill = pool.Acquire(BufferPool::MAX_CLASS_SIZE);
   struct iovec iov[2];
   const size_t writable = WritableBytes();
   /* 分散读， 保证数据全部读完 */
-  iov[0].iov_base = BeginPtr_() + writePos_;
+  iov[0].iov_base = BeginWrite();
   iov[0].iov_len = writable;
-  iov[1].iov_base = buff;
-  iov[1].iov_len = sizeof(buff);
+  iov[1].iov_base = spill.data;
+  iov[1].iov_len = spill.size;
 
   const ssize_t len = readv(fd, iov, 2);
   if (len < 0) {
     *saveErrno = errno;
   } else if (static_cast<size_t>(len) <= writable) {
-    writePos_ += len;
+    HasWritten(len);
   } else {
-    writePos_ = buffer_.size();
-    Append(buff, len - writable);
+    HasWritten(writable);
+    if (chained_) {
+      /* 直接把溢出块挂到链上，免去一次拷贝 */
+      AdoptSegment_(spill, len - writable);
+    } else {
+      Append(spill.data, len - writable);
+    }
   }
+  pool.Release(spill);
   return len;
 }
 
 ssize_t Buffer::WriteFd(int fd, int *saveErrno) {
-  size_t readSize = ReadableBytes();
-  ssize_t len = write(fd, Peek(), readSize);
+  struct iovec iov[16];
+  int cnt = ReadableIov(iov, 16);
+  ssize_t len = writev(fd, iov, cnt);
   if (len < 0) {
     *saveErrno = errno;
     return len;
   }
-  readPos_ += len;
+  Retrieve(len);
   return len;
 }
 
-char *Buffer::BeginPtr_() { return &*buffer_.begin(); }
+int Buffer::ReadableIov(struct iovec *iov, int maxCnt) const {
+  int cnt = 0;
+  if (maxCnt > 0 && writePos_ > readPos_) {
+    iov[cnt].iov_base = const_cast<char *>(Peek());
+    iov[cnt].iov_len = writePos_ - readPos_;
+    cnt++;
+  }
+  for (auto it = chain_.begin(); it != chain_.end() && cnt < maxCnt; ++it) {
+    if (it->writePos > it->readPos) {
+      iov[cnt].iov_base = it->block.data + it->readPos;
+      iov[cnt].iov_len = it->writePos - it->readPos;
+      cnt++;
+    }
+  }
+  return cnt;
+}
+
+char *Buffer::BeginPtr_() { return block_.data; }
 
-const char *Buffer::BeginPtr_() const { return &*buffer_.begin(); }
+const char *Buffer::BeginPtr_() const { return block_.data; }
+
+void Buffer::EnsureBlock_() {
+  if (!block_.data) {
+    block_ = BufferPool::Instance().Acquire(initSize_);
+  }
+}
 
 void Buffer::MakeSpace_(size_t len) {
+  size_t readable = writePos_ - readPos_;
   if (WritableBytes() + PrependableBytes() < len) {
-    buffer_.resize(writePos_ + len + 1);
+    /* 换一个更大规格的块，只拷贝未读数据 */
+    auto &pool = BufferPool::Instance();
+    BufferPool::Block bigger =
+        pool.Acquire(std::max(readable + len, initSize_));
+    if (readable) {
+      std::copy(BeginPtr_() + readPos_, BeginPtr_() + writePos_, bigger.data);
+    }
+    pool.Release(block_);
+    block_ = bigger;
   } else {
-    size_t readable = ReadableBytes();
     std::copy(BeginPtr_() + readPos_, BeginPtr_() + writePos_, BeginPtr_());
-    readPos_ = 0;
-    writePos_ = readPos_ + readable;
-    assert(readable == ReadableBytes());
   }
-}
\ No newline at end of file
+  readPos_ = 0;
+  writePos_ = readable;
+  assert(readable == ReadableBytes() - chainBytes_);
+}
+
+void Buffer::AddSegment_(size_t len) {
+  chain_.push_back({BufferPool::Instance().Acquire(len), 0, 0});
+}
+
+void Buffer::AdoptSegment_(BufferPool::Block &block, size_t len) {
+  chain_.push_back({block, 0, len});
+  chainBytes_ += len;
+  block = {};
+}
+
+void Buffer::PromoteSegment_() {
+  assert(!chain_.empty() && readPos_ == writePos_);
+  Segment seg = chain_.front();
+  chain_.erase(chain_.begin());
+  chainBytes_ -= seg.writePos - seg.readPos;
+  BufferPool::Instance().Release(block_);
+  block_ = seg.block;
+  readPos_ = seg.readPos;
+  writePos_ = seg.writePos;
+}
@@ -1,5 +1,6 @@
 #ifndef BUFFER_HPP_
 #define BUFFER_HPP_
+#include "buffer_pool.hpp"
 #include <assert.h>
 #include <atomic>
 #include <cstring> //perror
@@ -8,10 +9,16 @@
 #include <unistd.h>  // write
 #include <vector>    //readv
 
+// 存储来自 BufferPool。普通 Buffer 始终是一段连续内存；
+// chained 模式下超过最大规格的数据会挂到后续块上而不是整体重新分配，
+// 此时 Peek() 只覆盖第一段，需要用 ReadableIov()/WriteFd() 访问全部数据。
 class Buffer {
 public:
-  Buffer(int initBuffSize = 1024);
-  ~Buffer() = default;
+  Buffer(int initBuffSize = 1024, bool chained = false);
+  ~Buffer();
+
+  Buffer(const Buffer &) = delete;
+  Buffer &operator=(const Buffer &) = delete;
 
   size_t WritableBytes() const;
   size_t ReadableBytes() const;
@@ -38,14 +45,37 @@ public:
   ssize_t ReadFd(int fd, int *Errno);
   ssize_t WriteFd(int fd, int *Errno);
 
+  // 依次填入各段可读数据，返回使用的 iovec 数
+  int ReadableIov(struct iovec *iov, int maxCnt) const;
+
+  size_t Capacity() const;
+
+  // 归还全部内存块，下次写入时再按初始规格重新申请
+  void Release();
+
 private:
+  struct Segment {
+    BufferPool::Block block;
+    size_t readPos;
+    size_t writePos;
+  };
+
   char *BeginPtr_();
   const char *BeginPtr_() const;
   void MakeSpace_(size_t len);
+  void AddSegment_(size_t len);
+  void AdoptSegment_(BufferPool::Block &block, size_t len);
+  void PromoteSegment_();
+  void EnsureBlock_();
 
-  std::vector<char> buffer_;
+  size_t initSize_;
+  BufferPool::Block block_;
   std::atomic<std::size_t> readPos_;
   std::atomic<std::size_t> writePos_;
+
+  bool chained_;
+  std::vector<Segment> chain_; // block_ 之后的后续段，通常为空
+  size_t chainBytes_;         // chain_ 中的可读字节数
 };
 
-#endif // BUFFER_H
\ No newline at end of file
+#endif // BUFFER_H
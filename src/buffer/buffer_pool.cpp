@@ -0,0 +1,143 @@
+#include "buffer_pool.hpp"
+#include <algorithm>
+#include <new>
+
+// 每个线程每档最多缓存的块数，约合每档 1MB
+static constexpr std::array<size_t, BufferPool::CLASS_NUM> LOCAL_MAX = {256, 64,
+                                                                        16};
+
+struct BufferPoolLocalCache {
+  std::array<std::vector<char *>, BufferPool::CLASS_NUM> free;
+  ~BufferPoolLocalCache() {
+    // 线程退出时把缓存还给全局仓库
+    auto &pool = BufferPool::Instance();
+    for (int c = 0; c < BufferPool::CLASS_NUM; ++c) {
+      pool.Spill_(c, free[c], 0);
+    }
+  }
+};
+
+static thread_local BufferPoolLocalCache local_cache;
+
+size_t BufferPool::Stats::bytes_in_use() const {
+  size_t n = oversize_bytes;
+  for (int c = 0; c < CLASS_NUM; ++c) {
+    n += in_use[c] * CLASS_SIZE[c];
+  }
+  return n;
+}
+
+size_t BufferPool::Stats::bytes_allocated() const {
+  size_t n = oversize_bytes;
+  for (int c = 0; c < CLASS_NUM; ++c) {
+    n += allocated[c] * CLASS_SIZE[c];
+  }
+  return n;
+}
+
+BufferPool &BufferPool::Instance() {
+  static BufferPool pool;
+  return pool;
+}
+
+BufferPool::~BufferPool() {
+  for (int c = 0; c < CLASS_NUM; ++c) {
+    for (char *p : depot_[c]) {
+      ::operator delete(p, std::align_val_t(64));
+    }
+  }
+}
+
+int BufferPool::ClassOf_(size_t len) {
+  for (int c = 0; c < CLASS_NUM; ++c) {
+    if (len <= CLASS_SIZE[c]) {
+      return c;
+    }
+  }
+  return -1;
+}
+
+BufferPool::Block BufferPool::Acquire(size_t len) {
+  int cls = ClassOf_(len);
+  if (cls < 0) {
+    oversize_in_use_++;
+    oversize_bytes_ += len;
+    return {new char[len], len, -1};
+  }
+  auto &local = local_cache.free[cls];
+  if (local.empty()) {
+    Refill_(cls, local);
+  }
+  char *data;
+  if (!local.empty()) {
+    data = local.back();
+    local.pop_back();
+  } else {
+    data = static_cast<char *>(
+        ::operator new(CLASS_SIZE[cls], std::align_val_t(64)));
+    allocated_[cls]++;
+  }
+  in_use_[cls]++;
+  return {data, CLASS_SIZE[cls], cls};
+}
+
+void BufferPool::Release(Block &block) {
+  if (!block.data) {
+    return;
+  }
+  if (block.cls < 0) {
+    oversize_in_use_--;
+    oversize_bytes_ -= block.size;
+    delete[] block.data;
+  } else {
+    in_use_[block.cls]--;
+    auto &local = local_cache.free[block.cls];
+    local.push_back(block.data);
+    if (local.size() > LOCAL_MAX[block.cls]) {
+      Spill_(block.cls, local, LOCAL_MAX[block.cls] / 2);
+    }
+  }
+  block = {};
+}
+
+void BufferPool::Refill_(int cls, std::vector<char *> &local) {
+  std::lock_guard<std::mutex> lk(depot_mtx_);
+  auto &depot = depot_[cls];
+  size_t n = std::min(depot.size(), LOCAL_MAX[cls] / 2);
+  local.insert(local.end(), depot.end() - n, depot.end());
+  depot.resize(depot.size() - n);
+}
+
+void BufferPool::Spill_(int cls, std::vector<char *> &local, size_t keep) {
+  if (local.size() <= keep) {
+    return;
+  }
+  std::vector<char *> excess;
+  {
+    std::lock_guard<std::mutex> lk(depot_mtx_);
+    auto &depot = depot_[cls];
+    depot.insert(depot.end(), local.begin() + keep, local.end());
+    local.resize(keep);
+    if (depot.size() > DEPOT_MAX[cls]) {
+      // Refill_ 从尾部取最近归还的块，超出上限时释放头部最久未用的块
+      auto end = depot.begin() + (depot.size() - DEPOT_MAX[cls]);
+      excess.assign(depot.begin(), end);
+      depot.erase(depot.begin(), end);
+    }
+  }
+  for (char *p : excess) {
+    ::operator delete(p, std::align_val_t(64));
+  }
+  allocated_[cls] -= excess.size();
+}
+
+BufferPool::Stats BufferPool::GetStats() const {
+  Stats s{};
+  for (int c = 0; c < CLASS_NUM; ++c) {
+    s.allocated[c] = allocated_[c].load(std::memory_order_relaxed);
+    s.in_use[c] = in_use_[c].load(std::memory_order_relaxed);
+  }
+  s.oversize_in_use = oversize_in_use_.load(std::memory_order_relaxed);
+  s.oversize_bytes = oversize_bytes_.load(std::memory_order_relaxed);
+  return s;
+}
@@ -0,0 +1,66 @@
+#ifndef BUFFER_POOL_HPP_
+#define BUFFER_POOL_HPP_
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <mutex>
+#include <vector>
+
+// 固定规格内存块池：4K/16K/64K 三档，线程本地空闲链表 + 全局仓库。
+// 超过最大规格的请求直接走堆分配，不进入池。
+// 仓库每档最多保留 DEPOT_MAX 块，流量高峰过后多出的块归还给系统。
+class BufferPool {
+public:
+  static constexpr int CLASS_NUM = 3;
+  static constexpr std::array<size_t, CLASS_NUM> CLASS_SIZE = {4096, 16384,
+                                                               65536};
+  static constexpr size_t MAX_CLASS_SIZE = CLASS_SIZE[CLASS_NUM - 1];
+  // 全局仓库每档保留的块数上限，约合每档 2MB
+  static constexpr std::array<size_t, CLASS_NUM> DEPOT_MAX = {512, 128, 32};
+
+  struct Block {
+    char *data = nullptr;
+    size_t size = 0;
+    int cls = -1; // -1: 不属于任何规格（空块或超大块）
+  };
+
+  struct Stats {
+    std::array<size_t, CLASS_NUM> allocated; // 向系统申请过且未归还的块
+    std::array<size_t, CLASS_NUM> in_use;    // 正被 Buffer 持有的块
+    size_t oversize_in_use;
+    size_t oversize_bytes;
+    size_t bytes_in_use() const;
+    size_t bytes_allocated() const;
+  };
+
+  static BufferPool &Instance();
+
+  // 返回容量不小于 len 的最小规格块
+  Block Acquire(size_t len);
+  void Release(Block &block);
+
+  Stats GetStats() const;
+
+  BufferPool(const BufferPool &) = delete;
+  BufferPool &operator=(const BufferPool &) = delete;
+
+private:
+  friend struct BufferPoolLocalCache;
+  BufferPool() = default;
+  ~BufferPool();
+
+  static int ClassOf_(size_t len);
+  // 线程本地缓存与全局仓库之间批量搬运
+  void Refill_(int cls, std::vector<char *> &local);
+  void Spill_(int cls, std::vector<char *> &local, size_t keep);
+
+  std::mutex depot_mtx_;
+  std::array<std::vector<char *>, CLASS_NUM> depot_;
+
+  std::array<std::atomic<size_t>, CLASS_NUM> allocated_{};
+  std::array<std::atomic<size_t>, CLASS_NUM> in_use_{};
+  std::atomic<size_t> oversize_in_use_{0};
+  std::atomic<size_t> oversize_bytes_{0};
+};
+
+#endif // BUFFER_POOL_HPP_
@@ -0,0 +1,188 @@
+#include "ring_buffer.hpp"
+#include "buffer_pool.hpp"
+#include <algorithm>
+#include <cassert>
+#include <cerrno>
+#include <sys/mman.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+static size_t PageRound(size_t len) {
+  static const size_t page = sysconf(_SC_PAGESIZE);
+  return (len + page - 1) / page * page;
+}
+
+RingBuffer::RingBuffer(int initBuffSize)
+    : initSize_(PageRound(std::max(initBuffSize, 1))), base_(nullptr),
+      capacity_(0), readOff_(0), readable_(0) {
+  base_ = Map_(initSize_);
+  capacity_ = base_ ? initSize_ : 0;
+}
+
+RingBuffer::~RingBuffer() { Unmap_(base_, capacity_); }
+
+char *RingBuffer::Map_(size_t capacity) {
+  int fd = memfd_create("ring_buffer", MFD_CLOEXEC);
+  if (fd < 0) {
+    return nullptr;
+  }
+  if (ftruncate(fd, capacity) < 0) {
+    close(fd);
+    return nullptr;
+  }
+  /* 先占住 2 倍大小的地址空间，再把同一个文件映射到前后两半 */
+  void *area = mmap(nullptr, capacity * 2, PROT_NONE,
+                    MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (area == MAP_FAILED) {
+    close(fd);
+    return nullptr;
+  }
+  char *base = static_cast<char *>(area);
+  void *lo = mmap(base, capacity, PROT_READ | PROT_WRITE,
+                  MAP_SHARED | MAP_FIXED, fd, 0);
+  void *hi = mmap(base + capacity, capacity, PROT_READ | PROT_WRITE,
+                  MAP_SHARED | MAP_FIXED, fd, 0);
+  close(fd);
+  if (lo == MAP_FAILED || hi == MAP_FAILED) {
+    munmap(area, capacity * 2);
+    return nullptr;
+  }
+  return base;
+}
+
+void RingBuffer::Unmap_(char *base, size_t capacity) {
+  if (base) {
+    munmap(base, capacity * 2);
+  }
+}
+
+void RingBuffer::Release() {
+  Unmap_(base_, capacity_);
+  base_ = nullptr;
+  capacity_ = 0;
+  readOff_ = readable_ = 0;
+}
+
+size_t RingBuffer::ReadableBytes() const { return readable_; }
+
+size_t RingBuffer::WritableBytes() const { return capacity_ - readable_; }
+
+const char *RingBuffer::Peek() const { return base_ + readOff_; }
+
+void RingBuffer::Retrieve(size_t len) {
+  assert(len <= readable_);
+  readable_ -= len;
+  readOff_ = readable_ ? (readOff_ + len) % capacity_ : 0;
+}
+
+void RingBuffer::RetrieveUntil(const char *end) {
+  assert(Peek() <= end);
+  Retrieve(end - Peek());
+}
+
+void RingBuffer::RetrieveAll() { readOff_ = readable_ = 0; }
+
+std::string RingBuffer::RetrieveAllToStr() {
+  std::string str(Peek(), readable_);
+  RetrieveAll();
+  return str;
+}
+
+const char *RingBuffer::BeginWriteConst() const {
+  return base_ + readOff_ + readable_;
+}
+
+char *RingBuffer::BeginWrite() { return base_ + readOff_ + readable_; }
+
+void RingBuffer::HasWritten(size_t len) {
+  assert(len <= WritableBytes());
+  readable_ += len;
+}
+
+bool RingBuffer::Append(const std::string &str) {
+  return Append(str.data(), str.length());
+}
+
+bool RingBuffer::Append(const void *data, size_t len) {
+  assert(data);
+  return Append(reinterpret_cast<const char *>(data), len);
+}
+
+bool RingBuffer::Append(const char *str, size_t len) {
+  assert(str);
+  if (!EnsureWriteable(len)) {
+    return false;
+  }
+  std::copy(str, str + len, BeginWrite());
+  HasWritten(len);
+  return true;
+}
+
+bool RingBuffer::EnsureWriteable(size_t len) {
+  if ((WritableBytes() < len || !base_) && !Grow_(len)) {
+    return false;
+  }
+  assert(WritableBytes() >= len);
+  return true;
+}
+
+bool RingBuffer::Grow_(size_t len) {
+  size_t capacity = std::max(capacity_, initSize_);
+  while (capacity - readable_ < len) {
+    capacity *= 2;
+  }
+  char *base = Map_(capacity);
+  if (!base) {
+    return false;
+  }
+  if (readable_) {
+    std::copy(Peek(), Peek() + readable_, base);
+  }
+  Unmap_(base_, capacity_);
+  base_ = base;
+  capacity_ = capacity;
+  readOff_ = 0;
+  return true;
+}
+
+ssize_t RingBuffer::ReadFd(int fd, int *saveErrno) {
+  if (!base_ && !Grow_(0)) {
+    *saveErrno = ENOMEM;
+    return -1;
+  }
+  auto &pool = BufferPool::Instance();
+  BufferPool::Block spill = pool.Acquire(BufferPool::MAX_CLASS_SIZE);
+  struct iovec iov[2];
+  const size_t writable = WritableBytes();
+  iov[0].iov_base = BeginWrite();
+  iov[0].iov_len = writable;
+  iov[1].iov_base = spill.data;
+  iov[1].iov_len = spill.size;
+
+  const ssize_t len = readv(fd, iov, 2);
+  if (len < 0) {
+    *saveErrno = errno;
+  } else if (static_cast<size_t>(len) <= writable) {
+    HasWritten(len);
+  } else {
+    HasWritten(writable);
+    if (!Append(spill.data, len - writable)) {
+      /* 已从 socket 读出的数据放不下，连接无法继续 */
+      pool.Release(spill);
+      *saveErrno = ENOMEM;
+      return -1;
+    }
+  }
+  pool.Release(spill);
+  return len;
+}
+
+ssize_t RingBuffer::WriteFd(int fd, int *saveErrno) {
+  ssize_t len = write(fd, Peek(), readable_);
+  if (len < 0) {
+    *saveErrno = errno;
+    return len;
+  }
+  Retrieve(len);
+  return len;
+}
@@ -0,0 +1,66 @@
+#ifndef RING_BUFFER_HPP_
+#define RING_BUFFER_HPP_
+#include <cstddef>
+#include <string>
+#include <sys/types.h>
+
+// 虚拟内存镜像环形缓冲区：同一组 memfd 页面被连续映射两次，
+// 任意位置开始的可读/可写区间在地址上都是连续的，
+// 因此无需像 Buffer 那样把未读数据搬回开头，RetrieveAll 也只是重置下标。
+// 接口与 Buffer 保持一致（PrependableBytes 恒为 0）。
+// 每个缓冲区占两个 VMA，连接数很多时可能超过 vm.max_map_count 而映射失败：
+// 构造时失败则保持未映射状态（Mapped() 为 false），写入时再重试；
+// 扩容失败时 EnsureWriteable/Append 返回 false 且内容不变，
+// ReadFd 返回 -1 并置 ENOMEM，由调用方关闭连接。
+class RingBuffer {
+public:
+  RingBuffer(int initBuffSize = 4096);
+  ~RingBuffer();
+
+  RingBuffer(const RingBuffer &) = delete;
+  RingBuffer &operator=(const RingBuffer &) = delete;
+
+  size_t WritableBytes() const;
+  size_t ReadableBytes() const;
+  size_t PrependableBytes() const { return 0; }
+
+  const char *Peek() const;
+  bool EnsureWriteable(size_t len);
+  void HasWritten(size_t len);
+
+  void Retrieve(size_t len);
+  void RetrieveUntil(const char *end);
+
+  void RetrieveAll();
+  std::string RetrieveAllToStr();
+
+  const char *BeginWriteConst() const;
+  char *BeginWrite();
+
+  bool Append(const std::string &str);
+  bool Append(const char *str, size_t len);
+  bool Append(const void *data, size_t len);
+
+  ssize_t ReadFd(int fd, int *Errno);
+  ssize_t WriteFd(int fd, int *Errno);
+
+  size_t Capacity() const { return capacity_; }
+  bool Mapped() const { return base_ != nullptr; }
+
+  // 解除映射，下次写入时重新映射
+  void Release();
+
+private:
+  // 映射 capacity 字节（按页对齐）的镜像区域，失败返回 nullptr
+  static char *Map_(size_t capacity);
+  static void Unmap_(char *base, size_t capacity);
+  bool Grow_(size_t len);
+
+  size_t initSize_;
+  char *base_;
+  size_t capacity_;
+  size_t readOff_;  // [0, capacity_)
+  size_t readable_; // <= capacity_
+};
+
+#endif // RING_BUFFER_HPP_
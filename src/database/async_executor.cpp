@@ -0,0 +1,60 @@
+#include "async_executor.hpp"
+
+#include <cerrno>
+#include <cstdint>
+#include <system_error>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+namespace Database {
+
+AsyncExecutor::AsyncExecutor(size_t threads)
+    : efd_(eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)) {
+  // Without the eventfd no completion would ever reach the loop.
+  if (efd_ < 0)
+    throw std::system_error(errno, std::generic_category(),
+                            "Failed to create eventfd for AsyncExecutor");
+  pool_ = std::make_unique<ThreadPool>(threads);
+}
+
+AsyncExecutor::~AsyncExecutor() {
+  // Joining the pool lets in-flight work finish; completions it queues
+  // are never drained and are dropped with completions_.
+  pool_.reset();
+  ::close(efd_);
+}
+
+void AsyncExecutor::complete_(std::function<void()> done) {
+  bool wake;
+  {
+    std::lock_guard<std::mutex> lk(mtx_);
+    // Only the first completion of a batch needs to wake the loop.
+    wake = completions_.empty();
+    completions_.push_back(std::move(done));
+  }
+  if (wake) {
+    uint64_t one = 1;
+    ssize_t n;
+    do {
+      n = ::write(efd_, &one, sizeof(one));
+    } while (n < 0 && errno == EINTR);
+  }
+}
+
+size_t AsyncExecutor::drain() {
+  uint64_t count;
+  while (::read(efd_, &count, sizeof(count)) < 0 && errno == EINTR) {
+  }
+  std::vector<std::function<void()>> ready;
+  {
+    std::lock_guard<std::mutex> lk(mtx_);
+    ready.swap(completions_);
+  }
+  for (auto &done : ready) {
+    done();
+  }
+  pending_.fetch_sub(ready.size(), std::memory_order_relaxed);
+  return ready.size();
+}
+
+} // namespace Database
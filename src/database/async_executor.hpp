@@ -0,0 +1,63 @@
+#ifndef ASYNC_EXECUTOR_HPP_
+#define ASYNC_EXECUTOR_HPP_
+
+#include "thread_pool.hpp"
+
+#include <atomic>
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+namespace Database {
+
+// Runs blocking database work on its own threads and hands each result back
+// to an event loop. The loop watches event_fd() for readability and calls
+// drain(), which runs the completion callbacks on the loop's thread. The
+// threads that submit work never wait on SQLite.
+class AsyncExecutor {
+public:
+  // Throws std::system_error if the eventfd cannot be created.
+  explicit AsyncExecutor(size_t threads);
+  ~AsyncExecutor();
+
+  AsyncExecutor(const AsyncExecutor &) = delete;
+  AsyncExecutor &operator=(const AsyncExecutor &) = delete;
+
+  // Non-blocking eventfd, readable while completions are waiting.
+  int event_fd() const { return efd_; }
+
+  // Run work() on a database thread, then done(result) from drain().
+  template <class Work, class Done> void submit(Work work, Done done) {
+    pending_.fetch_add(1, std::memory_order_relaxed);
+    pool_->enqueue([this, work = std::move(work),
+                   done = std::move(done)]() mutable {
+      auto result = work();
+      complete_([done = std::move(done), result = std::move(result)]() mutable {
+        done(std::move(result));
+      });
+    });
+  }
+
+  // Run all queued completions; returns how many ran.
+  size_t drain();
+
+  // Submitted and not yet drained.
+  size_t pending() const { return pending_.load(std::memory_order_relaxed); }
+  const ThreadPool &pool() const { return *pool_; }
+
+private:
+  void complete_(std::function<void()> done);
+
+  int efd_;
+  std::unique_ptr<ThreadPool> pool_;
+  std::mutex mtx_;
+  std::vector<std::function<void()>> completions_;
+  std::atomic<size_t> pending_{0};
+};
+
+} // namespace Database
+
+#endif
@@ -0,0 +1,66 @@
+#include "bloom_filter.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <functional>
+
+namespace Database {
+
+BloomFilter::BloomFilter(size_t expected_items, double fp_rate)
+    : capacity_(std::max<size_t>(1, expected_items)) {
+  fp_rate = std::clamp(fp_rate, 1e-9, 0.5);
+  const double ln2 = std::log(2.0);
+  // m = -n ln p / (ln 2)^2, k = (m / n) ln 2
+  const double m =
+      -static_cast<double>(capacity_) * std::log(fp_rate) / (ln2 * ln2);
+  bits_ = std::max<size_t>(64, (static_cast<size_t>(m) + 63) / 64 * 64);
+  hashes_ = std::clamp(
+      static_cast<int>(std::lround(bits_ / static_cast<double>(capacity_) *
+                                   ln2)),
+      1, 16);
+  words_ = std::vector<std::atomic<uint64_t>>(bits_ / 64);
+}
+
+void BloomFilter::hash_pair(std::string_view key, uint64_t &h1,
+                            uint64_t &h2) {
+  h1 = std::hash<std::string_view>{}(key);
+  // splitmix64 finalizer for an independent-looking second hash; odd so
+  // the probe sequence never degenerates to a single bit.
+  uint64_t z = h1 + 0x9E3779B97F4A7C15ULL;
+  z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+  z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+  h2 = (z ^ (z >> 31)) | 1;
+}
+
+void BloomFilter::add(std::string_view key) {
+  uint64_t h1, h2;
+  hash_pair(key, h1, h2);
+  for (int i = 0; i < hashes_; ++i) {
+    const uint64_t bit = (h1 + i * h2) % bits_;
+    words_[bit / 64].fetch_or(uint64_t{1} << (bit % 64),
+                              std::memory_order_relaxed);
+  }
+  items_.fetch_add(1, std::memory_order_relaxed);
+}
+
+bool BloomFilter::may_contain(std::string_view key) const {
+  uint64_t h1, h2;
+  hash_pair(key, h1, h2);
+  for (int i = 0; i < hashes_; ++i) {
+    const uint64_t bit = (h1 + i * h2) % bits_;
+    if (!(words_[bit / 64].load(std::memory_order_relaxed) &
+          (uint64_t{1} << (bit % 64)))) {
+      return false;
+    }
+  }
+  return true;
+}
+
+double BloomFilter::estimated_fp_rate() const {
+  const double k = hashes_;
+  const double fill =
+      1.0 - std::exp(-k * static_cast<double>(items()) / bits_);
+  return std::pow(fill, k);
+}
+
+} // namespace Database
@@ -0,0 +1,48 @@
+#ifndef BLOOM_FILTER_HPP_
+#define BLOOM_FILTER_HPP_
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+namespace Database {
+
+// Fixed-size Bloom filter over strings. add() and may_contain() are
+// lock-free and may run concurrently; keys cannot be removed, so callers
+// rebuild a fresh filter when deletions or growth make it stale.
+class BloomFilter {
+public:
+  // Sized for expected_items at the given false positive rate.
+  BloomFilter(size_t expected_items, double fp_rate);
+
+  BloomFilter(const BloomFilter &) = delete;
+  BloomFilter &operator=(const BloomFilter &) = delete;
+
+  void add(std::string_view key);
+  // false means the key was definitely never added.
+  bool may_contain(std::string_view key) const;
+
+  size_t bit_count() const { return bits_; }
+  int hash_count() const { return hashes_; }
+  size_t capacity() const { return capacity_; }
+  // Keys added so far (duplicates counted again).
+  size_t items() const { return items_.load(std::memory_order_relaxed); }
+  // Expected false positive rate at the current item count.
+  double estimated_fp_rate() const;
+
+private:
+  // Double hashing: probe i is h1 + i * h2 (Kirsch-Mitzenmacher).
+  static void hash_pair(std::string_view key, uint64_t &h1, uint64_t &h2);
+
+  size_t bits_;
+  int hashes_;
+  size_t capacity_;
+  std::vector<std::atomic<uint64_t>> words_;
+  std::atomic<size_t> items_{0};
+};
+
+} // namespace Database
+
+#endif
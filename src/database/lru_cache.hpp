@@ -0,0 +1,146 @@
+#ifndef LRU_CACHE_HPP_
+#define LRU_CACHE_HPP_
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace Database {
+
+// Concurrent LRU cache split into independently locked shards, so lookups
+// from different threads rarely contend. Each shard evicts its own least
+// recently used entry once it holds capacity / shards entries.
+//
+// Fills that race with invalidation are guarded by a per-shard epoch: take
+// fill_epoch(key) before reading the backing store and pass it to put();
+// the put is dropped if the key's shard was invalidated in between.
+template <typename K, typename V, typename Hash = std::hash<K>>
+class ShardedLruCache {
+public:
+  struct Stats {
+    uint64_t hits = 0;
+    uint64_t misses = 0;
+    uint64_t evictions = 0;
+    size_t size = 0;
+  };
+
+  explicit ShardedLruCache(size_t capacity, size_t shards = 16)
+      : shards_(std::max<size_t>(1, shards)) {
+    const size_t per_shard = (capacity + shards_.size() - 1) / shards_.size();
+    for (auto &s : shards_) {
+      s.capacity = std::max<size_t>(1, per_shard);
+    }
+  }
+
+  ShardedLruCache(const ShardedLruCache &) = delete;
+  ShardedLruCache &operator=(const ShardedLruCache &) = delete;
+
+  std::optional<V> get(const K &key) {
+    Shard &s = shard_of(key);
+    std::lock_guard<std::mutex> lk(s.mutex);
+    auto it = s.index.find(key);
+    if (it == s.index.end()) {
+      ++s.misses;
+      return std::nullopt;
+    }
+    ++s.hits;
+    s.lru.splice(s.lru.begin(), s.lru, it->second);
+    return it->second->second;
+  }
+
+  uint64_t fill_epoch(const K &key) {
+    Shard &s = shard_of(key);
+    std::lock_guard<std::mutex> lk(s.mutex);
+    return s.epoch;
+  }
+
+  // Insert or replace. Returns false if the fill raced with invalidation.
+  bool put(const K &key, V value, std::optional<uint64_t> epoch = {}) {
+    Shard &s = shard_of(key);
+    std::lock_guard<std::mutex> lk(s.mutex);
+    if (epoch && *epoch != s.epoch) {
+      return false;
+    }
+    auto it = s.index.find(key);
+    if (it != s.index.end()) {
+      it->second->second = std::move(value);
+      s.lru.splice(s.lru.begin(), s.lru, it->second);
+      return true;
+    }
+    if (s.index.size() >= s.capacity) {
+      s.index.erase(s.lru.back().first);
+      s.lru.pop_back();
+      ++s.evictions;
+    }
+    s.lru.emplace_front(key, std::move(value));
+    s.index.emplace(key, s.lru.begin());
+    return true;
+  }
+
+  void erase(const K &key) {
+    Shard &s = shard_of(key);
+    std::lock_guard<std::mutex> lk(s.mutex);
+    ++s.epoch;
+    auto it = s.index.find(key);
+    if (it != s.index.end()) {
+      s.lru.erase(it->second);
+      s.index.erase(it);
+    }
+  }
+
+  void clear() {
+    for (auto &s : shards_) {
+      std::lock_guard<std::mutex> lk(s.mutex);
+      ++s.epoch;
+      s.index.clear();
+      s.lru.clear();
+    }
+  }
+
+  Stats stats() const {
+    Stats total;
+    for (auto &s : shards_) {
+      std::lock_guard<std::mutex> lk(s.mutex);
+      total.hits += s.hits;
+      total.misses += s.misses;
+      total.evictions += s.evictions;
+      total.size += s.index.size();
+    }
+    return total;
+  }
+
+private:
+  using Entry = std::pair<K, V>;
+  // Padded to a cache line so neighbouring shard locks do not false-share.
+  struct alignas(64) Shard {
+    mutable std::mutex mutex;
+    std::list<Entry> lru; // front = most recently used
+    std::unordered_map<K, typename std::list<Entry>::iterator, Hash> index;
+    size_t capacity = 1;
+    uint64_t epoch = 0;
+    uint64_t hits = 0;
+    uint64_t misses = 0;
+    uint64_t evictions = 0;
+  };
+
+  Shard &shard_of(const K &key) {
+    // Mix the hash so shard choice does not reuse the low bits the shard's
+    // own unordered_map buckets on.
+    uint64_t h = Hash{}(key) * 0x9E3779B97F4A7C15ULL;
+    return shards_[(h >> 32) % shards_.size()];
+  }
+
+  std::vector<Shard> shards_;
+};
+
+} // namespace Database
+
+#endif
@@ -0,0 +1,99 @@
+#include "result_set.hpp"
+
+namespace Database {
+
+std::string_view Row::column_name(int col) const {
+  const char *name = sqlite3_column_name(stmt_, col);
+  return name ? name : "";
+}
+
+ValueType Row::type(int col) const {
+  switch (sqlite3_column_type(stmt_, col)) {
+  case SQLITE_INTEGER:
+    return ValueType::Integer;
+  case SQLITE_FLOAT:
+    return ValueType::Float;
+  case SQLITE_TEXT:
+    return ValueType::Text;
+  case SQLITE_BLOB:
+    return ValueType::Blob;
+  default:
+    return ValueType::Null;
+  }
+}
+
+std::string_view Row::get_text(int col) const {
+  // column_blob returns the bytes of text values too, without the
+  // conversion column_text may do; bytes must be read after it.
+  const void *p = sqlite3_column_blob(stmt_, col);
+  const int n = sqlite3_column_bytes(stmt_, col);
+  if (!p || n <= 0)
+    return {};
+  return {static_cast<const char *>(p), static_cast<size_t>(n)};
+}
+
+int64_t ResultSet::get_int(size_t row, size_t col) const {
+  const Cell &c = cell(row, col);
+  return c.type == ValueType::Integer ? c.i : 0;
+}
+
+double ResultSet::get_double(size_t row, size_t col) const {
+  const Cell &c = cell(row, col);
+  return c.type == ValueType::Float ? c.f : 0.0;
+}
+
+std::string_view ResultSet::get_text(size_t row, size_t col) const {
+  const Cell &c = cell(row, col);
+  if (c.type != ValueType::Text && c.type != ValueType::Blob)
+    return {};
+  return std::string_view(arena_).substr(c.bytes.offset, c.bytes.length);
+}
+
+void ResultSet::clear() {
+  names_.clear();
+  for (auto &column : columns_) {
+    column.clear();
+  }
+  arena_.clear();
+  rows_ = 0;
+}
+
+void ResultSet::append(const Row &row) {
+  const int ncol = row.column_count();
+  if (rows_ == 0 && names_.empty()) {
+    names_.reserve(static_cast<size_t>(ncol));
+    for (int i = 0; i < ncol; ++i) {
+      names_.emplace_back(row.column_name(i));
+    }
+    // Keep the vectors (and their capacity) of a previous, wider result.
+    if (columns_.size() < names_.size())
+      columns_.resize(names_.size());
+  }
+  for (int i = 0; i < ncol; ++i) {
+    Cell c;
+    c.type = row.type(i);
+    switch (c.type) {
+    case ValueType::Integer:
+      c.i = row.get_int(i);
+      break;
+    case ValueType::Float:
+      c.f = row.get_double(i);
+      break;
+    case ValueType::Text:
+    case ValueType::Blob: {
+      const std::string_view bytes = row.get_text(i);
+      c.bytes.offset = static_cast<uint32_t>(arena_.size());
+      c.bytes.length = static_cast<uint32_t>(bytes.size());
+      arena_.append(bytes);
+      break;
+    }
+    case ValueType::Null:
+      c.i = 0;
+      break;
+    }
+    columns_[static_cast<size_t>(i)].push_back(c);
+  }
+  ++rows_;
+}
+
+} // namespace Database
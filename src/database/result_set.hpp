@@ -0,0 +1,89 @@
+#ifndef RESULT_SET_HPP_
+#define RESULT_SET_HPP_
+
+#include <sqlite3.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace Database {
+
+enum class ValueType : uint8_t { Null, Integer, Float, Text, Blob };
+
+// One row as sqlite3_step produced it, handed to SQLite::for_each_row.
+// A thin view over the statement: nothing is copied, and text/blob views
+// are only valid until the visitor returns.
+class Row {
+public:
+  explicit Row(sqlite3_stmt *stmt) : stmt_(stmt) {}
+
+  int column_count() const { return sqlite3_column_count(stmt_); }
+  std::string_view column_name(int col) const;
+  ValueType type(int col) const;
+  bool is_null(int col) const { return type(col) == ValueType::Null; }
+  int64_t get_int(int col) const { return sqlite3_column_int64(stmt_, col); }
+  double get_double(int col) const { return sqlite3_column_double(stmt_, col); }
+  // Text, or the raw bytes of a blob.
+  std::string_view get_text(int col) const;
+
+private:
+  sqlite3_stmt *stmt_;
+};
+
+// Typed, column-major query result. Numbers stay native; text and blob
+// bytes are appended to one arena, so a result costs a handful of
+// allocations regardless of its row count, and clear() keeps them for
+// the next query.
+class ResultSet {
+public:
+  size_t rows() const { return rows_; }
+  size_t cols() const { return names_.size(); }
+  bool empty() const { return rows_ == 0; }
+  const std::string &column_name(size_t col) const { return names_[col]; }
+
+  ValueType type(size_t row, size_t col) const {
+    return cell(row, col).type;
+  }
+  bool is_null(size_t row, size_t col) const {
+    return type(row, col) == ValueType::Null;
+  }
+  // No conversion between storage classes: a cell read with the wrong
+  // getter yields 0 or an empty view.
+  int64_t get_int(size_t row, size_t col) const;
+  double get_double(size_t row, size_t col) const;
+  std::string_view get_text(size_t row, size_t col) const;
+
+  // Forget rows and columns but keep the allocated capacity.
+  void clear();
+
+  // Append the statement's current row; the first row sets the columns.
+  void append(const Row &row);
+
+  size_t arena_bytes() const { return arena_.size(); }
+
+private:
+  struct Cell {
+    ValueType type;
+    union {
+      int64_t i;
+      double f;
+      struct {
+        uint32_t offset;
+        uint32_t length;
+      } bytes;
+    };
+  };
+  const Cell &cell(size_t row, size_t col) const { return columns_[col][row]; }
+
+  std::vector<std::string> names_;
+  std::vector<std::vector<Cell>> columns_;
+  std::string arena_;
+  size_t rows_ = 0;
+};
+
+} // namespace Database
+
+#endif
@@ -1,17 +1,23 @@
 #include "sqlite.hpp"
 
 #include <algorithm>
+#include <array>
 #include <cassert>
 #include <cctype>
 #include <cstring>
 #include <format>
+#include <stdexcept>
 #include <string>
 #include <string_view>
 #include <utility>
 
 namespace Database {
 
-std::unique_ptr<SQLite> SQLite::instance_ = nullptr;
+std::vector<std::unique_ptr<SQLite>> SQLite::instances_;
+
+static thread_local uint64_t thread_pool_wait_ns_ = 0;
+
+uint64_t SQLite::thread_pool_wait_ns() { return thread_pool_wait_ns_; }
 
 static int open_db(sqlite3 **out, const std::string &path, bool readonly) {
   int flags = readonly ? SQLITE_OPEN_READONLY | SQLITE_OPEN_NOMUTEX
@@ -21,19 +27,79 @@ static int open_db(sqlite3 **out, const std::string &path, bool readonly) {
   return sqlite3_open_v2(path.c_str(), out, flags, nullptr);
 }
 
-SQLite *SQLite::get_instance() { return instance_.get(); }
+SQLite *SQLite::get_instance() {
+  return instances_.empty() ? nullptr : instances_[0].get();
+}
+
+size_t SQLite::shard_count() { return instances_.size(); }
+
+SQLite *SQLite::shard(size_t index) {
+  return index < instances_.size() ? instances_[index].get() : nullptr;
+}
+
+SQLite *SQLite::for_key(std::string_view key) {
+  if (instances_.empty())
+    return nullptr;
+  return instances_[shard_of(key, instances_.size())].get();
+}
+
+size_t SQLite::shard_of(std::string_view key, size_t shards) {
+  if (shards <= 1)
+    return 0;
+  uint64_t h = 0xcbf29ce484222325ULL;
+  for (unsigned char c : key) {
+    h = (h ^ c) * 0x100000001b3ULL;
+  }
+  return static_cast<size_t>(h % shards);
+}
 
-bool SQLite::init(const std::string &db_path, int read_pool_size,
-                  bool enable_wal, int busy_timeout_ms) {
-  if (instance_)
+std::string SQLite::shard_path(const std::string &db_path, size_t index,
+                               size_t shards) {
+  if (shards <= 1)
+    return db_path;
+  // Insert before the extension of the file name, not of a directory.
+  const size_t slash = db_path.find_last_of('/');
+  const size_t dot = db_path.find_last_of('.');
+  const size_t cut = dot != std::string::npos &&
+                             (slash == std::string::npos || dot > slash + 1)
+                         ? dot
+                         : db_path.size();
+  return std::format("{}.shard{}{}", db_path.substr(0, cut), index,
+                     db_path.substr(cut));
+}
+
+bool SQLite::init(const std::string &db_path, const Options &options) {
+  if (!instances_.empty())
     return false;
-  instance_ = std::unique_ptr<SQLite>(new SQLite(
-      db_path, std::max(1, read_pool_size), enable_wal, busy_timeout_ms));
+  // The shard count decides which file holds each user; running with a
+  // different one than asked for would put rows where reshard cannot find
+  // them.
+  const size_t shards = options.shards;
+  if (shards < 1 || shards > MAX_SHARDS)
+    throw std::invalid_argument(
+        std::format("SQLite shard count {} is outside 1..{}", shards,
+                    MAX_SHARDS));
+  for (size_t i = 0; i < shards; ++i) {
+    instances_.push_back(std::unique_ptr<SQLite>(
+        new SQLite(shard_path(db_path, i, shards), options, i)));
+  }
   return true;
 }
 
-SQLite::SQLite(const std::string &db_path, int read_pool_size, bool enable_wal,
-               int busy_timeout_ms) {
+void SQLite::shutdown() {
+  // Shards are independent; destroy them in reverse order of creation.
+  while (!instances_.empty())
+    instances_.pop_back();
+}
+
+SQLite::SQLite(const std::string &db_path, const Options &options,
+               size_t shard_index)
+    : shard_index_(shard_index), max_batch_(std::max<size_t>(1, options.max_batch)),
+      max_batch_delay_(options.max_batch_delay), db_path_(db_path),
+      options_(options), thread_conns_(std::make_shared<ThreadConns>()) {
+  const int read_pool_size = std::max(1, options.read_pool_size);
+  const bool enable_wal = options.enable_wal;
+  const int busy_timeout_ms = options.busy_timeout_ms;
   // Open writer connection
   if (open_db(&write_db_, db_path, /*readonly=*/false) != SQLITE_OK) {
     // Leave instance in a safe destructible state
@@ -60,7 +126,8 @@ SQLite::SQLite(const std::string &db_path, int read_pool_size, bool enable_wal,
       throw std::runtime_error("Failed to open SQLite DB for reading");
     }
     std::string rerr;
-    if (!set_pragmas(rdb, enable_wal, busy_timeout_ms, &rerr)) {
+    if (!set_pragmas(rdb, enable_wal, busy_timeout_ms, &rerr) ||
+        !set_read_pragmas(rdb, options, &rerr)) {
       sqlite3_close(rdb);
       for (sqlite3 *p : read_dbs_)
         sqlite3_close(p);
@@ -69,11 +136,68 @@ SQLite::SQLite(const std::string &db_path, int read_pool_size, bool enable_wal,
       throw std::runtime_error("Failed to configure SQLite reader: " + rerr);
     }
     read_dbs_.push_back(rdb);
+    read_stmts_.push_back(std::make_unique<StatementCache>());
     free_read_indices_.push(i);
   }
+
+  if (enable_wal && options.checkpoint_interval.count() > 0) {
+    if (open_db(&checkpoint_db_, db_path, /*readonly=*/false) != SQLITE_OK ||
+        !set_pragmas(checkpoint_db_, false, busy_timeout_ms, &err)) {
+      sqlite3_close(checkpoint_db_);
+      checkpoint_db_ = nullptr;
+      for (sqlite3 *p : read_dbs_)
+        sqlite3_close(p);
+      sqlite3_close(write_db_);
+      write_db_ = nullptr;
+      throw std::runtime_error("Failed to open SQLite checkpointer: " + err);
+    }
+    // Replaces (and so disables) the writer's inline auto-checkpoint.
+    sqlite3_wal_hook(write_db_, &SQLite::on_wal_commit, this);
+    sqlite3_stmt *stmt = nullptr;
+    if (sqlite3_prepare_v2(write_db_, "PRAGMA page_size", -1, &stmt,
+                           nullptr) == SQLITE_OK &&
+        sqlite3_step(stmt) == SQLITE_ROW)
+      page_size_ = sqlite3_column_int(stmt, 0);
+    sqlite3_finalize(stmt);
+    checkpointer_ = std::thread([this] { checkpoint_loop(); });
+  }
+  sqlite3_update_hook(write_db_, &SQLite::on_update, this);
+  writer_ = std::thread([this] { writer_loop(); });
 }
 
 SQLite::~SQLite() {
+  // Queued writes are still committed before the writer thread exits.
+  {
+    std::lock_guard<std::mutex> lk(write_mutex_);
+    write_stop_ = true;
+  }
+  write_cv_.notify_all();
+  if (writer_.joinable())
+    writer_.join();
+  {
+    std::lock_guard<std::mutex> lk(checkpoint_mutex_);
+    checkpoint_stop_ = true;
+  }
+  checkpoint_cv_.notify_all();
+  if (checkpointer_.joinable())
+    checkpointer_.join();
+  if (checkpoint_db_) {
+    sqlite3_close(checkpoint_db_);
+    checkpoint_db_ = nullptr;
+  }
+  // Statements must be finalized before their connection can close.
+  write_stmts_.clear();
+  read_stmts_.clear();
+  {
+    std::lock_guard<std::mutex> lk(thread_conns_->mutex);
+    thread_conns_->closed = true;
+    for (auto &conn : thread_conns_->all) {
+      conn->stmts.clear();
+      sqlite3_close(conn->db);
+    }
+    thread_conns_->all.clear();
+    thread_conns_->idle.clear();
+  }
   if (write_db_) {
     sqlite3_close(write_db_);
     write_db_ = nullptr;
@@ -132,6 +256,26 @@ bool SQLite::set_pragmas(sqlite3 *db, bool enable_wal, int busy_timeout_ms,
   return true;
 }
 
+bool SQLite::set_read_pragmas(sqlite3 *db, const Options &options,
+                              std::string *err) {
+  std::string sql;
+  if (options.mmap_size > 0)
+    sql += std::format("PRAGMA mmap_size={};", options.mmap_size);
+  if (options.cache_size != 0)
+    sql += std::format("PRAGMA cache_size={};", options.cache_size);
+  if (options.temp_store == 1 || options.temp_store == 2)
+    sql += std::format("PRAGMA temp_store={};", options.temp_store);
+  if (sql.empty())
+    return true;
+  int rc = sqlite3_exec(db, sql.c_str(), nullptr, nullptr, nullptr);
+  if (rc != SQLITE_OK) {
+    if (err)
+      *err = last_sqlite_error(db, rc);
+    return false;
+  }
+  return true;
+}
+
 bool SQLite::is_readonly_statement(std::string_view sql) {
   // Trim leading whitespace and check the first keyword.
   auto it = sql.begin();
@@ -147,9 +291,32 @@ bool SQLite::is_readonly_statement(std::string_view sql) {
   return (kw == "SELECT" || kw == "PRAGMA" || kw == "WITH");
 }
 
+// Lock, counting the times another thread already held the mutex.
+static void lock_counted(std::unique_lock<std::mutex> &lk,
+                         std::atomic<uint64_t> &contended) {
+  if (!lk.try_lock()) {
+    contended.fetch_add(1, std::memory_order_relaxed);
+    lk.lock();
+  }
+}
+
 int SQLite::acquire_read_conn() {
-  std::unique_lock<std::mutex> lk(read_mutex_);
-  read_cv_.wait(lk, [&] { return !free_read_indices_.empty(); });
+  std::unique_lock<std::mutex> lk(read_mutex_, std::defer_lock);
+  lock_counted(lk, pool_lock_contended_);
+  if (free_read_indices_.empty()) {
+    const auto start = std::chrono::steady_clock::now();
+    read_cv_.wait(lk, [&] { return !free_read_indices_.empty(); });
+    const auto ns = static_cast<uint64_t>(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now() - start)
+            .count());
+    pool_waits_.fetch_add(1, std::memory_order_relaxed);
+    pool_wait_ns_.fetch_add(ns, std::memory_order_relaxed);
+    thread_pool_wait_ns_ += ns;
+    // Only updated under read_mutex_, so load-then-store is enough.
+    if (ns > pool_max_wait_ns_.load(std::memory_order_relaxed))
+      pool_max_wait_ns_.store(ns, std::memory_order_relaxed);
+  }
   int idx = free_read_indices_.front();
   free_read_indices_.pop();
   return idx;
@@ -157,130 +324,551 @@ int SQLite::acquire_read_conn() {
 
 void SQLite::release_read_conn(int idx) {
   {
-    std::lock_guard<std::mutex> lk(read_mutex_);
+    std::unique_lock<std::mutex> lk(read_mutex_, std::defer_lock);
+    lock_counted(lk, pool_lock_contended_);
     free_read_indices_.push(idx);
   }
   read_cv_.notify_one();
 }
 
+SQLite::ThreadConn *SQLite::thread_conn() {
+  // Hands the connection back when the thread exits, so threads that come
+  // and go reuse connections instead of using up the limit.
+  struct Lease {
+    std::shared_ptr<ThreadConns> owner;
+    ThreadConn *conn = nullptr;
+    ~Lease() { release(); }
+    void release() {
+      if (!owner)
+        return;
+      std::lock_guard<std::mutex> lk(owner->mutex);
+      if (conn && !owner->closed)
+        owner->idle.push_back(conn);
+      owner.reset();
+      conn = nullptr;
+    }
+  };
+  // One lease per shard, so alternating between shards keeps both.
+  thread_local std::array<Lease, MAX_SHARDS> leases;
+  Lease &lease = leases[shard_index_];
+  // A thread refused a connection stays on the pool rather than retrying
+  // (and locking) on every query.
+  if (lease.owner == thread_conns_)
+    return lease.conn;
+
+  lease.release(); // left over from an earlier instance
+  lease.owner = thread_conns_;
+  std::lock_guard<std::mutex> lk(thread_conns_->mutex);
+  auto &idle = thread_conns_->idle;
+  if (!idle.empty()) {
+    lease.conn = idle.back();
+    idle.pop_back();
+    return lease.conn;
+  }
+  if (thread_conns_->all.size() >= options_.max_thread_connections)
+    return nullptr;
+  sqlite3 *db = nullptr;
+  if (open_db(&db, db_path_, /*readonly=*/true) != SQLITE_OK ||
+      !set_pragmas(db, options_.enable_wal, options_.busy_timeout_ms,
+                   nullptr) ||
+      !set_read_pragmas(db, options_, nullptr)) {
+    sqlite3_close(db);
+    return nullptr;
+  }
+  auto conn = std::make_unique<ThreadConn>();
+  conn->db = db;
+  lease.conn = conn.get();
+  thread_conns_->all.push_back(std::move(conn));
+  return lease.conn;
+}
+
+SQLite::ReadStats SQLite::read_stats() const {
+  ReadStats s;
+  s.pool_reads = pool_reads_.load(std::memory_order_relaxed);
+  s.pool_waits = pool_waits_.load(std::memory_order_relaxed);
+  s.pool_wait_ns = pool_wait_ns_.load(std::memory_order_relaxed);
+  s.pool_max_wait_ns = pool_max_wait_ns_.load(std::memory_order_relaxed);
+  s.pool_lock_contended = pool_lock_contended_.load(std::memory_order_relaxed);
+  std::lock_guard<std::mutex> lk(thread_conns_->mutex);
+  s.thread_connections = thread_conns_->all.size();
+  for (const auto &conn : thread_conns_->all) {
+    s.thread_reads += conn->reads.load(std::memory_order_relaxed);
+  }
+  return s;
+}
+
 SQLite::ReadConnGuard::~ReadConnGuard() { owner.release_read_conn(idx); }
 
-bool SQLite::execute(std::string_view sql, std::string *error_msg) {
-  // Guard to ensure only one writer at a time
-  std::lock_guard<std::mutex> lk(write_mutex_);
-  if (!write_db_) {
-    if (error_msg)
-      *error_msg = "Writer DB not initialized";
-    return false;
+sqlite3_stmt *SQLite::StatementCache::acquire(sqlite3 *db,
+                                              std::string_view sql, int *rc,
+                                              bool *hit) {
+  auto it = stmts_.find(sql);
+  if (it != stmts_.end()) {
+    *hit = true;
+    *rc = SQLITE_OK;
+    return it->second;
   }
-  // Safety: prevent mistakenly issuing a SELECT on the writer if caller expects
-  // read. Not required, but helps avoid misuse.
-  int rc = SQLITE_OK;
+  *hit = false;
   sqlite3_stmt *stmt = nullptr;
-  rc = sqlite3_prepare_v2(write_db_, sql.data(), -1, &stmt, nullptr);
-  if (rc != SQLITE_OK) {
-    if (error_msg)
-      *error_msg = last_sqlite_error(write_db_, rc);
-    return false;
+  // Cached statements live for the connection's lifetime; tell SQLite so.
+  *rc = sqlite3_prepare_v3(db, sql.data(), static_cast<int>(sql.size()),
+                           SQLITE_PREPARE_PERSISTENT, &stmt, nullptr);
+  if (*rc != SQLITE_OK || !stmt) {
+    // An empty or comment-only statement prepares to nullptr.
+    if (*rc == SQLITE_OK)
+      *rc = SQLITE_MISUSE;
+    return nullptr;
   }
-  // Step until done (for multi-row DML)
-  while ((rc = sqlite3_step(stmt)) == SQLITE_ROW) {
-    // ignore any result rows (shouldn't be rows for DML)
-  }
-  sqlite3_finalize(stmt);
-  if (rc != SQLITE_DONE) {
-    if (error_msg)
-      *error_msg = last_sqlite_error(write_db_, rc);
-    return false;
+  if (stmts_.size() >= MAX_STATEMENTS)
+    clear();
+  stmts_.emplace(std::string(sql), stmt);
+  return stmt;
+}
+
+void SQLite::StatementCache::clear() {
+  for (auto &[sql, stmt] : stmts_) {
+    sqlite3_finalize(stmt);
   }
-  return true;
+  stmts_.clear();
 }
 
-bool SQLite::query(std::string_view sql, QueryResult &out,
-                   std::string *error_msg) {
-  // Select a read-only connection from pool
-  const int idx = acquire_read_conn();
-  ReadConnGuard guard(*this, idx);
-  sqlite3 *db = read_dbs_[static_cast<size_t>(idx)];
+int SQLite::bind_params(sqlite3_stmt *stmt, std::span<const Param> params) {
+  if (static_cast<int>(params.size()) != sqlite3_bind_parameter_count(stmt))
+    return SQLITE_RANGE;
+  int i = 0;
+  for (const Param &p : params) {
+    ++i;
+    int rc = SQLITE_OK;
+    if (const auto *v = std::get_if<int64_t>(&p)) {
+      rc = sqlite3_bind_int64(stmt, i, *v);
+    } else if (const auto *d = std::get_if<double>(&p)) {
+      rc = sqlite3_bind_double(stmt, i, *d);
+    } else if (const auto *s = std::get_if<std::string_view>(&p)) {
+      // SQLITE_STATIC: the text outlives the step, no copy is made.
+      rc = sqlite3_bind_text(stmt, i, s->data(), static_cast<int>(s->size()),
+                             SQLITE_STATIC);
+    } else {
+      rc = sqlite3_bind_null(stmt, i);
+    }
+    if (rc != SQLITE_OK)
+      return rc;
+  }
+  return SQLITE_OK;
+}
 
-  sqlite3_stmt *stmt = nullptr;
-  int rc = sqlite3_prepare_v2(db, sql.data(), -1, &stmt, nullptr);
-  if (rc != SQLITE_OK) {
+bool SQLite::run_statement(sqlite3 *db, StatementCache &cache,
+                           std::string_view sql,
+                           std::span<const Param> params,
+                           const StepCallback &on_row,
+                           std::string *error_msg) {
+  int rc = SQLITE_OK;
+  bool hit = false;
+  sqlite3_stmt *stmt = cache.acquire(db, sql, &rc, &hit);
+  if (!stmt) {
     if (error_msg)
       *error_msg = last_sqlite_error(db, rc);
     return false;
   }
+  (hit ? stmt_hits_ : stmt_misses_).fetch_add(1, std::memory_order_relaxed);
 
-  // Column names
-  out.columns.clear();
-  out.rows.clear();
-
-  bool cols_initialized = false;
-  while ((rc = sqlite3_step(stmt)) == SQLITE_ROW) {
-    int ncol = sqlite3_column_count(stmt);
-    if (!cols_initialized) {
-      out.columns.reserve(ncol);
-      for (int i = 0; i < ncol; ++i) {
-        const char *name = sqlite3_column_name(stmt, i);
-        out.columns.emplace_back(name ? name : "");
+  rc = bind_params(stmt, params);
+  if (rc == SQLITE_RANGE) {
+    if (error_msg)
+      *error_msg = std::format("expected {} parameters, got {}",
+                               sqlite3_bind_parameter_count(stmt),
+                               params.size());
+  } else if (rc != SQLITE_OK) {
+    if (error_msg)
+      *error_msg = last_sqlite_error(db, rc);
+  } else {
+    while ((rc = sqlite3_step(stmt)) == SQLITE_ROW) {
+      if (on_row && !on_row(stmt)) {
+        rc = SQLITE_DONE;
+        break;
       }
-      cols_initialized = true;
     }
+    if (rc != SQLITE_DONE && error_msg)
+      *error_msg = last_sqlite_error(db, rc);
+  }
+  // Leave the cached statement reusable and drop references to the caller's
+  // text buffers.
+  sqlite3_reset(stmt);
+  sqlite3_clear_bindings(stmt);
+  return rc == SQLITE_DONE;
+}
 
-    std::vector<std::string> row;
-    row.reserve(ncol);
-    for (int i = 0; i < ncol; ++i) {
-      int t = sqlite3_column_type(stmt, i);
-      switch (t) {
-      case SQLITE_INTEGER: {
-        sqlite3_int64 v = sqlite3_column_int64(stmt, i);
-        row.emplace_back(std::to_string(v));
-        break;
-      }
-      case SQLITE_FLOAT: {
-        double v = sqlite3_column_double(stmt, i);
-        row.emplace_back(std::to_string(v));
-        break;
-      }
-      case SQLITE_TEXT: {
-        const unsigned char *txt = sqlite3_column_text(stmt, i);
-        row.emplace_back(txt ? reinterpret_cast<const char *>(txt) : "");
-        break;
+std::future<SQLite::WriteResult> SQLite::submit(std::string_view sql,
+                                                Params params) {
+  PendingWrite w;
+  w.sql.assign(sql);
+  w.params.reserve(params.size());
+  for (const Param &p : params) {
+    if (const auto *s = std::get_if<std::string_view>(&p)) {
+      w.params.emplace_back(std::string(*s));
+    } else if (const auto *v = std::get_if<int64_t>(&p)) {
+      w.params.emplace_back(*v);
+    } else if (const auto *d = std::get_if<double>(&p)) {
+      w.params.emplace_back(*d);
+    } else {
+      w.params.emplace_back(nullptr);
+    }
+  }
+  w.enqueued = std::chrono::steady_clock::now();
+  std::future<WriteResult> fut = w.done.get_future();
+  {
+    std::lock_guard<std::mutex> lk(write_mutex_);
+    write_queue_.push_back(std::move(w));
+  }
+  write_cv_.notify_one();
+  return fut;
+}
+
+bool SQLite::execute(std::string_view sql, Params params,
+                     std::string *error_msg) {
+  WriteResult r = submit(sql, params).get();
+  if (!r.ok && error_msg)
+    *error_msg = std::move(r.error);
+  return r.ok;
+}
+
+void SQLite::set_commit_listener(CommitListener listener,
+                                 CommitCapture capture) {
+  std::lock_guard<std::mutex> lk(listener_mutex_);
+  listener_ = std::move(listener);
+  capture_ = std::move(capture);
+}
+
+void SQLite::on_update(void *self, int op, const char *, const char *table,
+                       sqlite3_int64 rowid) {
+  static_cast<SQLite *>(self)->changes_.push_back({op, table, rowid});
+}
+
+int SQLite::on_wal_commit(void *self, sqlite3 *, const char *, int pages) {
+  auto *sql = static_cast<SQLite *>(self);
+  sql->wal_pages_.store(pages, std::memory_order_relaxed);
+  // Only the writer thread commits, so load-then-store is enough.
+  if (pages > sql->max_wal_pages_.load(std::memory_order_relaxed))
+    sql->max_wal_pages_.store(pages, std::memory_order_relaxed);
+  sql->commits_since_checkpoint_.fetch_add(1, std::memory_order_relaxed);
+  if (pages >= sql->options_.checkpoint_wal_pages) {
+    {
+      std::lock_guard<std::mutex> lk(sql->checkpoint_mutex_);
+      sql->checkpoint_due_ = true;
+    }
+    sql->checkpoint_cv_.notify_one();
+  }
+  return SQLITE_OK;
+}
+
+void SQLite::checkpoint_loop() {
+  std::unique_lock<std::mutex> lk(checkpoint_mutex_);
+  for (;;) {
+    checkpoint_cv_.wait_for(lk, options_.checkpoint_interval, [this] {
+      return checkpoint_stop_ || checkpoint_due_;
+    });
+    if (checkpoint_stop_)
+      return;
+    checkpoint_due_ = false;
+    if (commits_since_checkpoint_.exchange(0, std::memory_order_relaxed) == 0)
+      continue;
+    lk.unlock();
+    run_checkpoint();
+    lk.lock();
+  }
+}
+
+void SQLite::run_checkpoint() {
+  const bool restart = wal_pages_.load(std::memory_order_relaxed) >=
+                       options_.checkpoint_restart_pages;
+  int log = 0;
+  int copied = 0;
+  const auto start = std::chrono::steady_clock::now();
+  const int rc = sqlite3_wal_checkpoint_v2(
+      checkpoint_db_, nullptr,
+      restart ? SQLITE_CHECKPOINT_RESTART : SQLITE_CHECKPOINT_PASSIVE, &log,
+      &copied);
+  const auto ns = static_cast<uint64_t>(
+      std::chrono::duration_cast<std::chrono::nanoseconds>(
+          std::chrono::steady_clock::now() - start)
+          .count());
+  checkpoints_.fetch_add(1, std::memory_order_relaxed);
+  if (restart)
+    checkpoint_restarts_.fetch_add(1, std::memory_order_relaxed);
+  // PASSIVE never reports busy; frames it could not copy show up as
+  // copied < log instead.
+  if (rc == SQLITE_BUSY || (rc == SQLITE_OK && copied < log)) {
+    checkpoint_busy_.fetch_add(1, std::memory_order_relaxed);
+    // Try again next interval even if nothing else is committed.
+    commits_since_checkpoint_.fetch_add(1, std::memory_order_relaxed);
+  }
+  checkpoint_ns_.fetch_add(ns, std::memory_order_relaxed);
+  // Only this thread checkpoints.
+  if (ns > checkpoint_max_ns_.load(std::memory_order_relaxed))
+    checkpoint_max_ns_.store(ns, std::memory_order_relaxed);
+}
+
+SQLite::CheckpointStats SQLite::checkpoint_stats() const {
+  CheckpointStats s;
+  s.checkpoints = checkpoints_.load(std::memory_order_relaxed);
+  s.restarts = checkpoint_restarts_.load(std::memory_order_relaxed);
+  s.busy = checkpoint_busy_.load(std::memory_order_relaxed);
+  s.total_ns = checkpoint_ns_.load(std::memory_order_relaxed);
+  s.max_ns = checkpoint_max_ns_.load(std::memory_order_relaxed);
+  s.wal_pages = wal_pages_.load(std::memory_order_relaxed);
+  s.max_wal_pages = max_wal_pages_.load(std::memory_order_relaxed);
+  s.page_size = page_size_;
+  return s;
+}
+
+void SQLite::writer_loop() {
+  std::vector<PendingWrite> batch;
+  batch.reserve(max_batch_);
+  for (;;) {
+    {
+      std::unique_lock<std::mutex> lk(write_mutex_);
+      write_cv_.wait(lk,
+                     [this] { return write_stop_ || !write_queue_.empty(); });
+      if (write_queue_.empty())
+        return;
+      if (max_batch_delay_.count() > 0 && write_queue_.size() < max_batch_) {
+        write_cv_.wait_until(
+            lk, write_queue_.front().enqueued + max_batch_delay_, [this] {
+              return write_stop_ || write_queue_.size() >= max_batch_;
+            });
       }
-      case SQLITE_NULL: {
-        row.emplace_back("");
-        break;
+      const size_t n = std::min(write_queue_.size(), max_batch_);
+      for (size_t i = 0; i < n; ++i) {
+        batch.push_back(std::move(write_queue_.front()));
+        write_queue_.pop_front();
       }
-      case SQLITE_BLOB: {
-        const void *blob = sqlite3_column_blob(stmt, i);
-        int bytes = sqlite3_column_bytes(stmt, i);
-        // Store blobs as hex string for a simple representation
-        const unsigned char *p = static_cast<const unsigned char *>(blob);
-        static const char hex[] = "0123456789ABCDEF";
-        std::string s;
-        s.resize(static_cast<size_t>(bytes) * 2);
-        for (int b = 0; b < bytes; ++b) {
-          s[static_cast<size_t>(b) * 2] = hex[(p[b] >> 4) & 0xF];
-          s[static_cast<size_t>(b) * 2 + 1] = hex[p[b] & 0xF];
-        }
-        row.emplace_back(std::move(s));
+    }
+    changes_.clear();
+    captured_.clear();
+    commit_batch(batch);
+    if (!changes_.empty()) {
+      std::lock_guard<std::mutex> lk(listener_mutex_);
+      if (listener_)
+        listener_(changes_, captured_);
+    }
+    for (auto &w : batch) {
+      w.done.set_value(std::move(w.result));
+    }
+    batch.clear();
+  }
+}
+
+bool SQLite::write_one(PendingWrite &w) {
+  WriteResult &result = w.result;
+  std::vector<Param> params;
+  params.reserve(w.params.size());
+  for (const Value &v : w.params) {
+    if (const auto *s = std::get_if<std::string>(&v)) {
+      params.emplace_back(std::string_view(*s));
+    } else if (const auto *i = std::get_if<int64_t>(&v)) {
+      params.emplace_back(*i);
+    } else if (const auto *d = std::get_if<double>(&v)) {
+      params.emplace_back(*d);
+    } else {
+      params.emplace_back(nullptr);
+    }
+  }
+  const size_t changes_before = changes_.size();
+  result.ok = run_statement(write_db_, write_stmts_, w.sql, params, {},
+                            &result.error);
+  if (result.ok) {
+    result.last_insert_rowid = sqlite3_last_insert_rowid(write_db_);
+    result.changes = sqlite3_changes(write_db_);
+    if (changes_.size() > changes_before)
+      capture_rows(changes_before);
+  } else {
+    changes_.resize(changes_before);
+  }
+  return result.ok;
+}
+
+void SQLite::capture_rows(size_t from) {
+  // In a grouped batch the statement ran inside BEGIN/SAVEPOINT, so this
+  // reads the uncommitted row before COMMIT. A batch of one runs in
+  // autocommit, so the row is already committed here. Either way only this
+  // thread writes through write_db_, so the row is read exactly as written.
+  std::lock_guard<std::mutex> lk(listener_mutex_);
+  if (!listener_ || capture_.sql.empty())
+    return;
+  for (size_t i = from; i < changes_.size(); ++i) {
+    RowChange &c = changes_[i];
+    if (c.op != SQLITE_INSERT || c.table != capture_.table)
+      continue;
+    const Param rowid[] = {c.rowid};
+    const size_t before = captured_.rows();
+    run_statement(
+        write_db_, write_stmts_, capture_.sql, rowid,
+        [this, before](sqlite3_stmt *stmt) {
+          // A capture replaced mid-batch may have another shape.
+          const auto ncol = static_cast<size_t>(sqlite3_column_count(stmt));
+          if (!captured_.empty() && captured_.cols() != ncol)
+            return false;
+          captured_.append(Row(stmt));
+          return captured_.rows() == before;
+        },
+        nullptr);
+    if (captured_.rows() > before)
+      c.captured = static_cast<long>(before);
+  }
+}
+
+void SQLite::commit_batch(std::vector<PendingWrite> &batch) {
+  if (batch.size() == 1) {
+    // Nothing to group; the statement's implicit transaction is enough.
+    write_one(batch[0]);
+  } else {
+    auto control = [this](std::string_view sql, std::string *err) {
+      return run_statement(write_db_, write_stmts_, sql, {}, {}, err);
+    };
+    std::string err;
+    bool ok = control("BEGIN IMMEDIATE", &err);
+    for (size_t i = 0; ok && i < batch.size(); ++i) {
+      ok = control("SAVEPOINT w", &err);
+      if (!ok)
         break;
+      if (write_one(batch[i])) {
+        ok = control("RELEASE w", &err);
+      } else if (sqlite3_get_autocommit(write_db_)) {
+        // Some errors (I/O, disk full) roll back the whole transaction.
+        err = batch[i].result.error;
+        ok = false;
+      } else {
+        ok = control("ROLLBACK TO w", &err) && control("RELEASE w", &err);
       }
-      default:
-        row.emplace_back("");
-        break;
+    }
+    if (ok)
+      ok = control("COMMIT", &err);
+    if (!ok) {
+      if (!sqlite3_get_autocommit(write_db_))
+        control("ROLLBACK", nullptr);
+      for (auto &w : batch) {
+        w.result = {false, std::format("batch rolled back: {}", err), 0, 0};
       }
+      changes_.clear();
     }
-    out.rows.emplace_back(std::move(row));
   }
+  write_batches_.fetch_add(1, std::memory_order_relaxed);
+  writes_.fetch_add(batch.size(), std::memory_order_relaxed);
+}
 
-  sqlite3_finalize(stmt);
-  if (rc != SQLITE_DONE) {
-    if (error_msg)
-      *error_msg = last_sqlite_error(db, rc);
-    return false;
+bool SQLite::run_read(std::string_view sql, std::span<const Param> params,
+                      const StepCallback &on_row, std::string *error_msg) {
+  if (options_.thread_local_reads) {
+    ThreadConn *conn = thread_conn();
+    // busy: called from a visitor of a query still running on it.
+    if (conn && !conn->busy) {
+      conn->busy = true;
+      const bool ok = run_statement(conn->db, conn->stmts, sql, params, on_row,
+                                    error_msg);
+      conn->busy = false;
+      // Written by the owning thread only; no need for a locked add.
+      conn->reads.store(conn->reads.load(std::memory_order_relaxed) + 1,
+                        std::memory_order_relaxed);
+      return ok;
+    }
   }
-  return true;
+  pool_reads_.fetch_add(1, std::memory_order_relaxed);
+  // Select a read-only connection from pool
+  const int idx = acquire_read_conn();
+  ReadConnGuard guard(*this, idx);
+  const auto i = static_cast<size_t>(idx);
+  return run_statement(read_dbs_[i], *read_stmts_[i], sql, params, on_row,
+                       error_msg);
+}
+
+bool SQLite::query(std::string_view sql, Params params, QueryResult &out,
+                   std::string *error_msg) {
+  out.columns.clear();
+  out.rows.clear();
+  return run_read(
+      sql, params,
+      [&out](sqlite3_stmt *stmt) {
+        collect_row(stmt, out);
+        return true;
+      },
+      error_msg);
+}
+
+bool SQLite::query(std::string_view sql, Params params, ResultSet &out,
+                   std::string *error_msg) {
+  out.clear();
+  return run_read(
+      sql, params,
+      [&out](sqlite3_stmt *stmt) {
+        out.append(Row(stmt));
+        return true;
+      },
+      error_msg);
+}
+
+bool SQLite::for_each_row(std::string_view sql, Params params,
+                          const RowVisitor &visit, std::string *error_msg) {
+  return run_read(
+      sql, params,
+      [&visit](sqlite3_stmt *stmt) { return visit(Row(stmt)); }, error_msg);
+}
+
+void SQLite::collect_row(sqlite3_stmt *stmt, QueryResult &out) {
+  int ncol = sqlite3_column_count(stmt);
+  if (out.columns.empty()) {
+    out.columns.reserve(ncol);
+    for (int i = 0; i < ncol; ++i) {
+      const char *name = sqlite3_column_name(stmt, i);
+      out.columns.emplace_back(name ? name : "");
+    }
+  }
+
+  std::vector<std::string> row;
+  row.reserve(ncol);
+  for (int i = 0; i < ncol; ++i) {
+    int t = sqlite3_column_type(stmt, i);
+    switch (t) {
+    case SQLITE_INTEGER: {
+      sqlite3_int64 v = sqlite3_column_int64(stmt, i);
+      row.emplace_back(std::to_string(v));
+      break;
+    }
+    case SQLITE_FLOAT: {
+      double v = sqlite3_column_double(stmt, i);
+      row.emplace_back(std::to_string(v));
+      break;
+    }
+    case SQLITE_TEXT: {
+      const unsigned char *txt = sqlite3_column_text(stmt, i);
+      int bytes = sqlite3_column_bytes(stmt, i);
+      row.emplace_back(txt ? reinterpret_cast<const char *>(txt) : "",
+                       static_cast<size_t>(bytes));
+      break;
+    }
+    case SQLITE_NULL: {
+      row.emplace_back("");
+      break;
+    }
+    case SQLITE_BLOB: {
+      const void *blob = sqlite3_column_blob(stmt, i);
+      int bytes = sqlite3_column_bytes(stmt, i);
+      // Store blobs as hex string for a simple representation
+      const unsigned char *p = static_cast<const unsigned char *>(blob);
+      static const char hex[] = "0123456789ABCDEF";
+      std::string s;
+      s.resize(static_cast<size_t>(bytes) * 2);
+      for (int b = 0; b < bytes; ++b) {
+        s[static_cast<size_t>(b) * 2] = hex[(p[b] >> 4) & 0xF];
+        s[static_cast<size_t>(b) * 2 + 1] = hex[p[b] & 0xF];
+      }
+      row.emplace_back(std::move(s));
+      break;
+    }
+    default:
+      row.emplace_back("");
+      break;
+    }
+  }
+  out.rows.emplace_back(std::move(row));
 }
 
 } // namespace Database
@@ -1,34 +1,187 @@
 #ifndef SQLITE_HPP_
 #define SQLITE_HPP_
 
+#include "result_set.hpp"
 #include <sqlite3.h>
 
+#include <atomic>
+#include <chrono>
 #include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <future>
+#include <initializer_list>
 #include <memory>
 #include <mutex>
 #include <optional>
 #include <queue>
+#include <span>
 #include <string>
 #include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <variant>
 #include <vector>
 
 namespace Database {
 
 class SQLite {
 public:
+  // Every value converted to a string; simple but allocates per cell.
+  // Prefer ResultSet or for_each_row on hot paths.
   struct QueryResult {
     std::vector<std::string> columns;
     std::vector<std::vector<std::string>> rows;
   };
 
-  // Get the singleton instance; returns nullptr if not initialized.
+  // A value bound to a `?` placeholder. Text is bound without copying, so it
+  // only has to stay valid for the duration of the call.
+  using Param = std::variant<std::nullptr_t, int64_t, double, std::string_view>;
+  using Params = std::initializer_list<Param>;
+
+  // Called for each result row; return false to stop early.
+  using RowVisitor = std::function<bool(const Row &)>;
+
+  // Completion of a queued write.
+  struct WriteResult {
+    bool ok = false;
+    std::string error;
+    int64_t last_insert_rowid = 0;
+    int changes = 0;
+  };
+
+  // A row changed by a write, as reported by sqlite3_update_hook.
+  struct RowChange {
+    int op; // SQLITE_INSERT, SQLITE_UPDATE or SQLITE_DELETE
+    std::string table;
+    int64_t rowid;
+    // Row of the listener's capture query for this change, or -1.
+    long captured = -1;
+  };
+  // Called on the writer thread with the row changes of each committed
+  // transaction, before the futures of its writes are fulfilled. Changes of
+  // statements that failed or were rolled back are not reported. captured
+  // holds the rows read by the listener's CommitCapture.
+  using CommitListener = std::function<void(std::span<const RowChange>,
+                                            const ResultSet &captured)>;
+  // Query run on the writer connection right after each statement that
+  // inserts into table, with the new rowid bound to its single `?`, so the
+  // listener gets the inserted values without a read of its own. In a
+  // grouped batch it runs before COMMIT; a lone write has already committed
+  // in autocommit mode. Its first row is kept for the change.
+  struct CommitCapture {
+    std::string table;
+    std::string sql;
+  };
+
+  struct Options {
+    int read_pool_size = 4;
+    bool enable_wal = true;
+    int busy_timeout_ms = 5000;
+    // Group commit: the writer thread runs up to max_batch queued writes in
+    // one transaction. Writes queued while a transaction commits go into the
+    // next one, so batches grow with load. A non-zero max_batch_delay also
+    // lets a partial batch wait that long for more writes.
+    size_t max_batch = 128;
+    std::chrono::microseconds max_batch_delay{0};
+    // Give each querying thread its own read-only connection, opened on its
+    // first query, so reads skip the pool's lock and never wait for a free
+    // connection. At most max_thread_connections are opened (threads that
+    // exit hand theirs on); other threads, and queries nested inside a
+    // for_each_row visitor, fall back to the pool.
+    bool thread_local_reads = false;
+    size_t max_thread_connections = 32;
+
+    // Spread users over this many database files, each with its own
+    // writer thread, read pool and checkpointer, so writes to different
+    // shards commit in parallel. 1 keeps the single file at db_path.
+    // init() throws std::invalid_argument outside 1..MAX_SHARDS.
+    size_t shards = 1;
+
+    // Background checkpointing (WAL only). The writer's inline
+    // auto-checkpoint, which stalls whichever commit crosses the threshold,
+    // is replaced by a checkpointer thread on its own connection. It runs a
+    // PASSIVE checkpoint every checkpoint_interval if anything was
+    // committed, or as soon as the WAL reaches checkpoint_wal_pages. Once the
+    // WAL reaches checkpoint_restart_pages (readers kept PASSIVE from
+    // finishing), it runs RESTART instead: that waits up to busy_timeout_ms
+    // for readers, then makes the next writer start at the top of the WAL
+    // again so the file stops growing. A zero interval keeps SQLite's inline
+    // auto-checkpoint.
+    std::chrono::milliseconds checkpoint_interval{1000};
+    int checkpoint_wal_pages = 1000;
+    int checkpoint_restart_pages = 10000;
+
+    // Memory tuning for read connections; 0 keeps SQLite's default.
+    // mmap_size in bytes lets reads come straight from the page cache of
+    // the OS; cache_size follows PRAGMA cache_size (negative = KiB);
+    // temp_store: 1 = file, 2 = memory.
+    int64_t mmap_size = 0;
+    int cache_size = 0;
+    int temp_store = 0;
+  };
+
+  // Background checkpoint metrics. WAL sizes are in pages as reported after
+  // each commit; multiply by page_size for bytes.
+  struct CheckpointStats {
+    uint64_t checkpoints = 0;
+    uint64_t restarts = 0; // of those, RESTART
+    uint64_t busy = 0;     // stopped short by readers or the writer
+    uint64_t total_ns = 0;
+    uint64_t max_ns = 0;
+    int wal_pages = 0;
+    int max_wal_pages = 0;
+    int page_size = 0;
+  };
+
+  // How reads were served. Pool waits are acquisitions that found every
+  // pooled connection busy; lock contention counts read_mutex_ already
+  // being held by another thread.
+  struct ReadStats {
+    uint64_t thread_reads = 0;
+    uint64_t pool_reads = 0;
+    uint64_t pool_waits = 0;
+    uint64_t pool_wait_ns = 0;
+    uint64_t pool_max_wait_ns = 0;
+    uint64_t pool_lock_contended = 0;
+    size_t thread_connections = 0;
+  };
+
+  static constexpr size_t MAX_SHARDS = 64;
+
+  // Get the singleton instance; returns nullptr if not initialized. When
+  // sharded this is shard 0; per-user data must go through for_key().
   static SQLite *get_instance();
 
+  // Sharding. shard_of() is a fixed hash (FNV-1a) so that every build and
+  // tools/reshard agree on where a key lives.
+  static size_t shard_count();
+  static SQLite *shard(size_t index);
+  static SQLite *for_key(std::string_view key);
+  static size_t shard_of(std::string_view key, size_t shards);
+  // db_path itself when shards is 1, otherwise "dir/db.shard<i>.sqlite3"
+  // for db_path "dir/db.sqlite3".
+  static std::string shard_path(const std::string &db_path, size_t index,
+                                size_t shards);
+
   // Initialize the singleton. Returns true on first successful init, false if
   // already initialized. Creates a writer connection and N read-only
-  // connections to enable concurrent reads and serialized writes.
+  // connections (per shard) to enable concurrent reads and serialized writes.
   static bool init(const std::string &db_path, int read_pool_size = 4,
-                   bool enable_wal = true, int busy_timeout_ms = 5000);
+                   bool enable_wal = true, int busy_timeout_ms = 5000) {
+    Options options;
+    options.read_pool_size = read_pool_size;
+    options.enable_wal = enable_wal;
+    options.busy_timeout_ms = busy_timeout_ms;
+    return init(db_path, options);
+  }
+  static bool init(const std::string &db_path, const Options &options);
+  // Close every shard, letting queued writes commit first. Owners call this
+  // explicitly (after UserCache::shutdown()) rather than relying on static
+  // destruction order across translation units.
+  static void shutdown();
 
   // Disallow copy/move
   SQLite(const SQLite &) = delete;
@@ -36,36 +189,159 @@ public:
   SQLite(SQLite &&) = delete;
   SQLite &operator=(SQLite &&) = delete;
 
-  // Execute write/DDL statements (INSERT/UPDATE/DELETE/CREATE/etc.).
-  // Serialized via an internal mutex. Optional error message filled on failure.
-  bool execute(std::string_view sql, std::string *error_msg = nullptr);
+  // Queue a write/DDL statement (INSERT/UPDATE/DELETE/CREATE/etc.) for the
+  // writer thread. SQL and params are copied. The future is fulfilled once
+  // the transaction holding the statement has committed; each statement runs
+  // under its own savepoint, so a failing one does not undo its batch.
+  std::future<WriteResult> submit(std::string_view sql, Params params = {});
+
+  // Replace the commit listener (empty function to remove it).
+  void set_commit_listener(CommitListener listener,
+                           CommitCapture capture = {});
+
+  // Synchronous write: submit() and wait for the commit.
+  // Optional error message filled on failure.
+  bool execute(std::string_view sql, std::string *error_msg = nullptr) {
+    return execute(sql, {}, error_msg);
+  }
+
+  // Same, with params bound to the statement's placeholders in order.
+  // Statements are prepared once per connection and reused from its cache.
+  bool execute(std::string_view sql, Params params,
+               std::string *error_msg = nullptr);
 
   // Execute a read-only query and collect all rows into QueryResult.
   // Uses a read-only connection from the pool (supports concurrency).
   bool query(std::string_view sql, QueryResult &out,
+             std::string *error_msg = nullptr) {
+    return query(sql, {}, out, error_msg);
+  }
+
+  bool query(std::string_view sql, Params params, QueryResult &out,
              std::string *error_msg = nullptr);
 
-  // Convenience overload returning the whole result by value.
+  // Typed results: numbers stay native and text shares one arena. Reusing
+  // one ResultSet across queries also reuses its buffers.
+  bool query(std::string_view sql, ResultSet &out,
+             std::string *error_msg = nullptr) {
+    return query(sql, {}, out, error_msg);
+  }
+
+  bool query(std::string_view sql, Params params, ResultSet &out,
+             std::string *error_msg = nullptr);
+
+  // Stream rows to visit without materializing them. The read connection
+  // is held until the last row, so keep the visitor short. Stopping early
+  // is not an error.
+  bool for_each_row(std::string_view sql, Params params,
+                    const RowVisitor &visit, std::string *error_msg = nullptr);
+
+  // Convenience overloads returning the whole result by value.
   std::optional<QueryResult> query(std::string_view sql,
                                    std::string *error_msg = nullptr) {
+    return query(sql, {}, error_msg);
+  }
+
+  std::optional<QueryResult> query(std::string_view sql, Params params,
+                                   std::string *error_msg = nullptr) {
     QueryResult r;
-    if (!query(sql, r, error_msg))
+    if (!query(sql, params, r, error_msg))
       return std::nullopt;
     return r;
   }
 
+  // Prepared statement cache counters, summed over all connections.
+  uint64_t statement_cache_hits() const { return stmt_hits_.load(); }
+  uint64_t statement_cache_misses() const { return stmt_misses_.load(); }
+
+  // Group commit counters: committed transactions and the writes in them.
+  uint64_t write_batches() const { return write_batches_.load(); }
+  uint64_t writes() const { return writes_.load(); }
+
+  ReadStats read_stats() const;
+  CheckpointStats checkpoint_stats() const;
+
+  // Time the calling thread has spent waiting for a pooled read connection,
+  // over all shards. Diff it around a call to charge the wait to one request.
+  static uint64_t thread_pool_wait_ns();
+
   ~SQLite();
 
 private:
-  explicit SQLite(const std::string &db_path, int read_pool_size,
-                  bool enable_wal, int busy_timeout_ms);
+  SQLite(const std::string &db_path, const Options &options,
+         size_t shard_index);
 
   // Internal helpers
   static std::string last_sqlite_error(sqlite3 *db, int rc);
   static bool set_pragmas(sqlite3 *db, bool enable_wal, int busy_timeout_ms,
                           std::string *err);
+  static bool set_read_pragmas(sqlite3 *db, const Options &options,
+                               std::string *err);
   static bool is_readonly_statement(std::string_view sql);
 
+  // Prepared statements of one connection, keyed by SQL text. Only touched
+  // while the owning connection is held, so it needs no locking of its own.
+  class StatementCache {
+  public:
+    // Beyond this many distinct statements the cache is flushed, so ad-hoc
+    // SQL cannot grow it without bound.
+    static constexpr size_t MAX_STATEMENTS = 64;
+
+    StatementCache() = default;
+    StatementCache(const StatementCache &) = delete;
+    StatementCache &operator=(const StatementCache &) = delete;
+    ~StatementCache() { clear(); }
+
+    // Returns a reset statement ready for binding, or nullptr with rc set.
+    // *hit tells whether it came from the cache.
+    sqlite3_stmt *acquire(sqlite3 *db, std::string_view sql, int *rc,
+                          bool *hit);
+    void clear();
+
+  private:
+    struct Hash {
+      using is_transparent = void;
+      size_t operator()(std::string_view s) const {
+        return std::hash<std::string_view>{}(s);
+      }
+    };
+    std::unordered_map<std::string, sqlite3_stmt *, Hash, std::equal_to<>>
+        stmts_;
+  };
+
+  // Prepare (or reuse), bind and step one statement on db, passing each
+  // row to on_row (if set) until it returns false.
+  using StepCallback = std::function<bool(sqlite3_stmt *)>;
+  bool run_statement(sqlite3 *db, StatementCache &cache, std::string_view sql,
+                     std::span<const Param> params, const StepCallback &on_row,
+                     std::string *error_msg);
+  // Run sql on a pooled read-only connection.
+  bool run_read(std::string_view sql, std::span<const Param> params,
+                const StepCallback &on_row, std::string *error_msg);
+  static int bind_params(sqlite3_stmt *stmt, std::span<const Param> params);
+
+  // Write queue
+  using Value = std::variant<std::nullptr_t, int64_t, double, std::string>;
+  struct PendingWrite {
+    std::string sql;
+    std::vector<Value> params;
+    std::promise<WriteResult> done;
+    WriteResult result;
+    std::chrono::steady_clock::time_point enqueued;
+  };
+  static void on_update(void *self, int op, const char *db, const char *table,
+                        sqlite3_int64 rowid);
+  static int on_wal_commit(void *self, sqlite3 *db, const char *name,
+                           int pages);
+  void checkpoint_loop();
+  void run_checkpoint();
+  void writer_loop();
+  void commit_batch(std::vector<PendingWrite> &batch);
+  bool write_one(PendingWrite &w);
+  // Run the capture query for the inserts in changes_ from index from on.
+  void capture_rows(size_t from);
+  static void collect_row(sqlite3_stmt *stmt, QueryResult &out);
+
   // Read connection pool management
   struct ReadConnGuard {
     SQLite &owner;
@@ -76,18 +352,85 @@ private:
   int acquire_read_conn();
   void release_read_conn(int idx);
 
+  // A thread_local_reads connection. Its owning thread is the only user, so
+  // the statement cache and busy flag need no locking.
+  struct ThreadConn {
+    sqlite3 *db = nullptr;
+    StatementCache stmts;
+    bool busy = false; // a query is running on it (nested query guard)
+    std::atomic<uint64_t> reads{0};
+  };
+  // Shared with each thread's lease, so a thread exiting after this object
+  // is gone can still tell not to hand its connection back.
+  struct ThreadConns {
+    std::mutex mutex;
+    bool closed = false;
+    std::vector<std::unique_ptr<ThreadConn>> all;
+    std::vector<ThreadConn *> idle; // left behind by exited threads
+  };
+  // The calling thread's connection, or nullptr when over the limit.
+  ThreadConn *thread_conn();
+
 private:
-  static std::unique_ptr<SQLite> instance_;
+  static std::vector<std::unique_ptr<SQLite>> instances_;
+  size_t shard_index_;
 
-  // Writer connection guarded by write_mutex_ to serialize writes.
+  // Writer connection, used only by the writer thread.
   sqlite3 *write_db_ = nullptr;
+  StatementCache write_stmts_;
+  size_t max_batch_;
+  std::chrono::microseconds max_batch_delay_;
+  std::deque<PendingWrite> write_queue_;
+  bool write_stop_ = false;
   std::mutex write_mutex_;
+  std::condition_variable write_cv_;
+  std::thread writer_;
+  // Held while the listener runs, so once set_commit_listener() returns
+  // the previous listener is no longer executing.
+  std::mutex listener_mutex_;
+  CommitListener listener_;
+  CommitCapture capture_;
+  std::vector<RowChange> changes_; // writer thread only
+  ResultSet captured_;             // writer thread only
+  std::atomic<uint64_t> write_batches_{0};
+  std::atomic<uint64_t> writes_{0};
+
+  // Settings for connections opened after construction.
+  std::string db_path_;
+  Options options_;
+  std::shared_ptr<ThreadConns> thread_conns_;
+
+  // Checkpointer connection and thread, when enabled.
+  sqlite3 *checkpoint_db_ = nullptr;
+  std::thread checkpointer_;
+  std::mutex checkpoint_mutex_;
+  std::condition_variable checkpoint_cv_;
+  bool checkpoint_stop_ = false;
+  bool checkpoint_due_ = false;
+  std::atomic<uint64_t> commits_since_checkpoint_{0};
+  std::atomic<int> wal_pages_{0};
+  std::atomic<int> max_wal_pages_{0};
+  int page_size_ = 0;
+  std::atomic<uint64_t> checkpoints_{0};
+  std::atomic<uint64_t> checkpoint_restarts_{0};
+  std::atomic<uint64_t> checkpoint_busy_{0};
+  std::atomic<uint64_t> checkpoint_ns_{0};
+  std::atomic<uint64_t> checkpoint_max_ns_{0};
 
   // Read-only connection pool and its coordination primitives.
   std::vector<sqlite3 *> read_dbs_;
+  std::vector<std::unique_ptr<StatementCache>> read_stmts_;
   std::queue<int> free_read_indices_;
   std::mutex read_mutex_;
   std::condition_variable read_cv_;
+  std::atomic<uint64_t> pool_reads_{0};
+  std::atomic<uint64_t> pool_waits_{0};
+  std::atomic<uint64_t> pool_wait_ns_{0};
+  std::atomic<uint64_t> pool_max_wait_ns_{0};
+  std::atomic<uint64_t> pool_lock_contended_{0};
+
+  std::atomic<uint64_t> stmt_hits_{0};
+  std::atomic<uint64_t> stmt_misses_{0};
 };
 
 } // namespace Database
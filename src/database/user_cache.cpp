@@ -0,0 +1,227 @@
+#include "user_cache.hpp"
+
+#include <algorithm>
+
+namespace Database {
+
+std::unique_ptr<UserCache> UserCache::instance_ = nullptr;
+
+namespace {
+
+// Reads a row of "SELECT id, username, password ...".
+std::optional<UserCache::User> to_user(const ResultSet &res, size_t row = 0) {
+  if (row >= res.rows())
+    return std::nullopt;
+  return UserCache::User{res.get_int(row, 0),
+                         std::string(res.get_text(row, 1)),
+                         std::string(res.get_text(row, 2))};
+}
+
+} // namespace
+
+UserCache *UserCache::get_instance() { return instance_.get(); }
+
+bool UserCache::init(size_t capacity, size_t shards, bool filter,
+                     std::chrono::seconds filter_rebuild) {
+  if (instance_ || !SQLite::get_instance())
+    return false;
+  instance_ = std::unique_ptr<UserCache>(
+      new UserCache(capacity, shards, filter, filter_rebuild));
+  return true;
+}
+
+void UserCache::shutdown() { instance_.reset(); }
+
+UserCache::UserCache(size_t capacity, size_t shards, bool filter,
+                     std::chrono::seconds filter_rebuild)
+    : filter_rebuild_(filter_rebuild) {
+  if (capacity > 0) {
+    cache_ = std::make_unique<ShardedLruCache<std::string, User>>(capacity,
+                                                                  shards);
+  }
+  if (!cache_ && !filter)
+    return;
+  for (size_t i = 0; i < SQLite::shard_count(); ++i) {
+    SQLite *sql = SQLite::shard(i);
+    sql->set_commit_listener(
+        [this](std::span<const SQLite::RowChange> changes,
+               const ResultSet &captured) { on_commit(changes, captured); },
+        {"user", "SELECT id, username, password FROM user WHERE rowid=?"});
+  }
+  if (filter) {
+    // Built synchronously so the first registrations already benefit.
+    rebuild_filter();
+    rebuilder_ = std::thread([this] { rebuild_loop(); });
+  }
+}
+
+UserCache::~UserCache() {
+  {
+    std::lock_guard<std::mutex> lk(filter_mutex_);
+    stop_ = true;
+  }
+  rebuild_cv_.notify_all();
+  if (rebuilder_.joinable())
+    rebuilder_.join();
+  for (size_t i = 0; i < SQLite::shard_count(); ++i) {
+    SQLite::shard(i)->set_commit_listener({});
+  }
+}
+
+std::optional<UserCache::User> UserCache::find(std::string_view username,
+                                               std::string *error) {
+  SQLite *sql = SQLite::for_key(username);
+  std::string key(username);
+  uint64_t epoch = 0;
+  if (cache_) {
+    if (auto hit = cache_->get(key))
+      return hit;
+    epoch = cache_->fill_epoch(key);
+  }
+  auto filter = filter_.load(std::memory_order_acquire);
+  if (filter && !filter->may_contain(username)) {
+    filter_negatives_.fetch_add(1, std::memory_order_relaxed);
+    return std::nullopt;
+  }
+  thread_local ResultSet res;
+  if (!sql->query(
+          "SELECT id, username, password FROM user WHERE username=? LIMIT 1",
+          {username}, res, error))
+    return std::nullopt;
+  auto user = to_user(res);
+  if (!user && filter)
+    filter_false_positives_.fetch_add(1, std::memory_order_relaxed);
+  // Only existing users are cached; unknown names always reach the table.
+  if (user && cache_)
+    cache_->put(key, *user, epoch);
+  return user;
+}
+
+bool UserCache::rebuild_filter() {
+  const size_t shards = SQLite::shard_count();
+  size_t rows = 0;
+  ResultSet count;
+  for (size_t i = 0; i < shards; ++i) {
+    if (!SQLite::shard(i)->query("SELECT COUNT(*) FROM user", count) ||
+        count.empty())
+      return false;
+    rows += static_cast<size_t>(count.get_int(0, 0));
+  }
+  auto fresh = std::make_shared<BloomFilter>(
+      std::max(rows * 2, FILTER_MIN_ITEMS), FILTER_FP_RATE);
+  {
+    std::lock_guard<std::mutex> lk(filter_mutex_);
+    building_ = fresh;
+  }
+  // Inserts committed from here on reach fresh through on_commit; those
+  // committed earlier are visible to this scan. Names are streamed into the
+  // filter instead of copying the whole column first.
+  bool scanned = true;
+  for (size_t i = 0; scanned && i < shards; ++i) {
+    scanned = SQLite::shard(i)->for_each_row(
+        "SELECT username FROM user", {}, [&](const Row &row) {
+          fresh->add(row.get_text(0));
+          return true;
+        });
+  }
+  std::lock_guard<std::mutex> lk(filter_mutex_);
+  // An update or delete during the scan reset building_; try again later.
+  const bool current = building_ == fresh;
+  building_.reset();
+  if (!scanned || !current)
+    return false;
+  filter_.store(std::move(fresh), std::memory_order_release);
+  filter_rebuilds_.fetch_add(1, std::memory_order_relaxed);
+  return true;
+}
+
+void UserCache::rebuild_loop() {
+  std::unique_lock<std::mutex> lk(filter_mutex_);
+  for (;;) {
+    auto due = [this] { return stop_ || rebuild_due_; };
+    if (filter_rebuild_.count() > 0) {
+      rebuild_cv_.wait_for(lk, filter_rebuild_, due);
+    } else {
+      rebuild_cv_.wait(lk, due);
+    }
+    if (stop_)
+      return;
+    rebuild_due_ = false;
+    lk.unlock();
+    rebuild_filter();
+    lk.lock();
+  }
+}
+
+void UserCache::on_commit(std::span<const SQLite::RowChange> changes,
+                          const ResultSet &captured) {
+  for (const auto &c : changes) {
+    if (c.table != "user")
+      continue;
+    if (c.op != SQLITE_INSERT) {
+      // The hook only carries the rowid, not the old username. The server
+      // never updates or deletes users, so dropping everything is cheaper
+      // than keeping a rowid index for it. A renamed user would be a false
+      // negative, so the filter is off until rebuilt.
+      if (cache_)
+        cache_->clear();
+      std::lock_guard<std::mutex> lk(filter_mutex_);
+      if (filter_.exchange(nullptr) || building_) {
+        building_.reset();
+        rebuild_due_ = true;
+        rebuild_cv_.notify_one();
+      }
+      continue;
+    }
+    // Cache the new row right away: a fresh registration is usually
+    // followed by a login. Replaces any entry left by INSERT OR REPLACE.
+    // The writer read it before the commit, so no query runs here.
+    if (c.captured < 0)
+      continue;
+    auto user = to_user(captured, static_cast<size_t>(c.captured));
+    if (!user)
+      continue;
+    {
+      // Under filter_mutex_ so a rebuild swapping filters cannot miss it.
+      std::lock_guard<std::mutex> lk(filter_mutex_);
+      if (building_)
+        building_->add(user->username);
+      if (auto filter = filter_.load(std::memory_order_acquire)) {
+        filter->add(user->username);
+        if (filter->items() > filter->capacity()) {
+          rebuild_due_ = true;
+          rebuild_cv_.notify_one();
+        }
+      }
+    }
+    if (cache_) {
+      std::string key = user->username;
+      // erase() bumps the shard epoch, so a find() that read the old row
+      // before this commit cannot put it back afterwards.
+      cache_->erase(key);
+      cache_->put(key, std::move(*user));
+    }
+  }
+}
+
+UserCache::Stats UserCache::stats() const {
+  Stats s;
+  if (cache_) {
+    auto c = cache_->stats();
+    s.hits = c.hits;
+    s.misses = c.misses;
+    s.evictions = c.evictions;
+    s.size = c.size;
+  }
+  s.filter_negatives = filter_negatives_.load();
+  s.filter_false_positives = filter_false_positives_.load();
+  s.filter_rebuilds = filter_rebuilds_.load();
+  if (auto filter = filter_.load()) {
+    s.filter_items = filter->items();
+    s.filter_bits = filter->bit_count();
+    s.filter_estimated_fp_rate = filter->estimated_fp_rate();
+  }
+  return s;
+}
+
+} // namespace Database
@@ -0,0 +1,121 @@
+#ifndef USER_CACHE_HPP_
+#define USER_CACHE_HPP_
+
+#include "bloom_filter.hpp"
+#include "lru_cache.hpp"
+#include "sqlite.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <thread>
+
+namespace Database {
+
+// Read-through cache of `user` rows keyed by username, in front of the
+// SQLite read pool of the user's shard. Writes are not made here; it follows the writer
+// connection through SQLite's commit listener instead, so rows inserted by
+// any SQLite::execute/submit are cached as soon as they commit.
+//
+// A Bloom filter of all usernames answers "definitely no such user"
+// without a query, which is the common case for registrations. It is
+// built from the table at startup, extended on every committed insert and
+// rebuilt in the background periodically or once it outgrows its sizing.
+class UserCache {
+public:
+  struct User {
+    int64_t id = 0; // rowid, unique within the user's shard
+    std::string username;
+    std::string password;
+  };
+
+  struct Stats {
+    uint64_t hits = 0;
+    uint64_t misses = 0;
+    uint64_t evictions = 0;
+    size_t size = 0;
+    // Lookups the filter answered without a query, and lookups it let
+    // through that then found no user.
+    uint64_t filter_negatives = 0;
+    uint64_t filter_false_positives = 0;
+    uint64_t filter_rebuilds = 0;
+    size_t filter_items = 0;
+    size_t filter_bits = 0;
+    double filter_estimated_fp_rate = 0;
+    // Measured share of absent names the filter failed to rule out.
+    double filter_fp_rate() const {
+      const uint64_t absent = filter_negatives + filter_false_positives;
+      return absent ? static_cast<double>(filter_false_positives) / absent : 0;
+    }
+  };
+
+  static constexpr double FILTER_FP_RATE = 0.01;
+  // Filters are sized for twice the rows present, and at least this many.
+  static constexpr size_t FILTER_MIN_ITEMS = 1 << 16;
+
+  // Get the singleton instance; returns nullptr if not initialized.
+  static UserCache *get_instance();
+
+  // Requires SQLite to be initialized. With capacity 0 find() always reads
+  // the database. filter_rebuild of zero keeps the filter but only
+  // rebuilds it when it fills up.
+  static bool init(size_t capacity, size_t shards = 16, bool filter = true,
+                   std::chrono::seconds filter_rebuild = std::chrono::hours(1));
+  // Stop the rebuild thread and detach from the SQLite shards. Must run
+  // before SQLite::shutdown().
+  static void shutdown();
+
+  UserCache(const UserCache &) = delete;
+  UserCache &operator=(const UserCache &) = delete;
+  ~UserCache();
+
+  // The user's row, or nullopt if there is none. *error is set when the
+  // lookup failed rather than found nothing.
+  std::optional<User> find(std::string_view username,
+                           std::string *error = nullptr);
+
+  // Build a new filter from the table and swap it in. Runs on the
+  // background thread; public for tests and tools.
+  bool rebuild_filter();
+
+  Stats stats() const;
+
+private:
+  UserCache(size_t capacity, size_t shards, bool filter,
+            std::chrono::seconds filter_rebuild);
+  // Changes committed on one of the shards; inserted users are in captured.
+  void on_commit(std::span<const SQLite::RowChange> changes,
+                 const ResultSet &captured);
+  void rebuild_loop();
+
+  static std::unique_ptr<UserCache> instance_;
+  std::unique_ptr<ShardedLruCache<std::string, User>> cache_;
+
+  // Null while disabled or invalidated; find() then always queries.
+  std::atomic<std::shared_ptr<BloomFilter>> filter_;
+  std::atomic<uint64_t> filter_negatives_{0};
+  std::atomic<uint64_t> filter_false_positives_{0};
+  std::atomic<uint64_t> filter_rebuilds_{0};
+
+  // Rebuild coordination. While a rebuild scans the table, committed
+  // inserts are added to both the live filter and building_.
+  std::mutex filter_mutex_;
+  std::shared_ptr<BloomFilter> building_;
+  std::condition_variable rebuild_cv_;
+  bool rebuild_due_ = false;
+  bool stop_ = false;
+  std::chrono::seconds filter_rebuild_;
+  std::thread rebuilder_;
+};
+
+} // namespace Database
+
+#endif
@@ -0,0 +1,184 @@
+#include "access_log.hpp"
+#include <algorithm>
+#include <arpa/inet.h>
+#include <chrono>
+#include <format>
+#include <iterator>
+
+std::unique_ptr<AccessLog> AccessLog::ptr_ = nullptr;
+
+namespace {
+const char *Months[] = {"Jan", "Feb", "Mar", "Apr", "May", "Jun",
+                        "Jul", "Aug", "Sep", "Oct", "Nov", "Dec"};
+
+// "[10/Oct/2000:13:55:36 +0000]"，同一秒内复用
+void append_clf_time(std::string &out, int64_t ts_ns) {
+  thread_local int64_t cachedSec = INT64_MIN;
+  thread_local char cached[32];
+  thread_local size_t cachedLen = 0;
+  int64_t sec = ts_ns / 1000000000;
+  if (sec != cachedSec) {
+    using namespace std::chrono;
+    sys_seconds tp{seconds(sec)};
+    auto day = floor<days>(tp);
+    year_month_day ymd{day};
+    hh_mm_ss hms{tp - day};
+    auto end = std::format_to(
+        cached, "[{:02}/{}/{}:{:02}:{:02}:{:02} +0000]",
+        static_cast<unsigned>(ymd.day()),
+        Months[static_cast<unsigned>(ymd.month()) - 1],
+        static_cast<int>(ymd.year()), hms.hours().count(),
+        hms.minutes().count(), hms.seconds().count());
+    cachedLen = end - cached;
+    cachedSec = sec;
+  }
+  out.append(cached, cachedLen);
+}
+
+// 请求行来自客户端，转义引号与不可打印字符，保证一行一条
+void append_escaped(std::string &out, const char *s, size_t n) {
+  for (size_t i = 0; i < n; ++i) {
+    unsigned char c = s[i];
+    if (c == '"' || c == '\\' || c < 0x20 || c >= 0x7f) {
+      std::format_to(std::back_inserter(out), "\\x{:02x}", c);
+    } else {
+      out += static_cast<char>(c);
+    }
+  }
+}
+
+size_t bounded_len(const char *s, size_t max) {
+  size_t n = 0;
+  while (n < max && s[n]) {
+    ++n;
+  }
+  return n;
+}
+} // namespace
+
+bool AccessLog::init(AccessLogFormat format, int sample_every,
+                     int max_queue_size, int split_lines,
+                     bool compress_rotated) {
+  if (ptr_ || format == AccessLogFormat::Off) {
+    return false;
+  }
+  ptr_ = std::unique_ptr<AccessLog>(new AccessLog(
+      format, sample_every, max_queue_size, split_lines, compress_rotated));
+  return true;
+}
+
+AccessLog::AccessLog(AccessLogFormat format, int sample_every,
+                     int max_queue_size, int split_lines,
+                     bool compress_rotated)
+    : format_(format),
+      sample_every_(static_cast<uint64_t>(std::max(sample_every, 1))),
+      split_lines_(std::max(split_lines, 1)),
+      compress_rotated_(compress_rotated),
+      queue_(std::max(max_queue_size, 2), FullPolicy::Drop) {
+  OpenFile_();
+  writer_ = std::thread([this] { WriterLoop_(); });
+}
+
+AccessLog::~AccessLog() {
+  flush();
+  queue_.stop();
+  if (writer_.joinable()) {
+    writer_.join();
+  }
+}
+
+void AccessLog::submit(const AccessRecord &rec) {
+  pending_.fetch_add(1, std::memory_order_relaxed);
+  AccessRecord copy = rec;
+  if (!queue_.push(std::move(copy))) {
+    if (pending_.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+      pending_.notify_all();
+    }
+  }
+}
+
+void AccessLog::flush() {
+  uint64_t n = pending_.load(std::memory_order_acquire);
+  while (n != 0) {
+    pending_.wait(n, std::memory_order_acquire);
+    n = pending_.load(std::memory_order_acquire);
+  }
+}
+
+void AccessLog::OpenFile_() {
+  const std::chrono::year_month_day ymd{
+      std::chrono::floor<std::chrono::days>(std::chrono::system_clock::now())};
+  std::string suffix = files_ ? std::format("_{}", files_) : std::string();
+  const bool binary = format_ == AccessLogFormat::Binary;
+  sink_.Open(std::format("log/{}_{:02d}_{:02d}_access{}.{}",
+                         static_cast<int>(ymd.year()),
+                         static_cast<unsigned>(ymd.month()),
+                         static_cast<unsigned>(ymd.day()), suffix,
+                         binary ? "binlog" : "log"));
+  if (binary) {
+    sink_.Append(BINARY_MAGIC);
+  }
+}
+
+void AccessLog::WriterLoop_() {
+  constexpr size_t BATCH = 256;
+  std::vector<AccessRecord> batch;
+  std::string out;
+  batch.reserve(BATCH);
+  for (;;) {
+    batch.clear();
+    size_t n = queue_.pop_batch(batch, BATCH);
+    if (n == 0) {
+      return;
+    }
+    out.clear();
+    for (const auto &rec : batch) {
+      if (lines_ > 0 && lines_ % split_lines_ == 0) {
+        sink_.Append(out);
+        out.clear();
+        sink_.Close();
+        if (compress_rotated_) {
+          compressor_.Enqueue(sink_.Path());
+        }
+        ++files_;
+        OpenFile_();
+      }
+      ++lines_;
+      if (format_ == AccessLogFormat::Binary) {
+        out.append(reinterpret_cast<const char *>(&rec), sizeof(rec));
+      } else {
+        FormatClf(rec, out);
+      }
+    }
+    sink_.Append(out);
+    if (queue_.empty()) {
+      sink_.Flush();
+    }
+    written_.fetch_add(n, std::memory_order_relaxed);
+    if (pending_.fetch_sub(n, std::memory_order_acq_rel) == n) {
+      pending_.notify_all();
+    }
+  }
+}
+
+void AccessLog::FormatClf(const AccessRecord &rec, std::string &out) {
+  char ip[INET_ADDRSTRLEN] = "-";
+  in_addr addr{rec.addr};
+  inet_ntop(AF_INET, &addr, ip, sizeof(ip));
+  out += ip;
+  out += " - - ";
+  append_clf_time(out, rec.ts_ns);
+  out += " \"";
+  append_escaped(out, rec.method, bounded_len(rec.method, sizeof(rec.method)));
+  out += ' ';
+  append_escaped(out, rec.path,
+                 std::min<size_t>(rec.path_len, sizeof(rec.path)));
+  out += " HTTP/";
+  append_escaped(out, rec.version,
+                 bounded_len(rec.version, sizeof(rec.version)));
+  std::format_to(std::back_inserter(out),
+                 "\" {} {} rt={} q={} r={} w={} p={} s={} ka={}{}\n",
+                 rec.status, rec.bytes, rec.total_us, rec.queue_us,
+                 rec.read_us, rec.wait_us, rec.process_us, rec.write_us,
+                 rec.requests, rec.aborted ? " aborted" : "");
+}
@@ -0,0 +1,98 @@
+#ifndef ACCESS_LOG_HPP_
+#define ACCESS_LOG_HPP_
+
+#include "log_sink.hpp"
+#include "mpsc_ring.hpp"
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+// 访问日志：每个请求一条定长记录，走独立的无锁队列、写线程与文件，
+// 与 Logger::write_log 互不争用。
+
+enum class AccessLogFormat {
+  Off = 0,
+  Clf = 1,    // Common Log Format，行尾附加各阶段耗时等字段
+  Binary = 2, // 定长二进制记录，由 log_decode 还原为 CLF
+};
+
+// 定长记录，二进制格式直接按此布局写出（主机字节序）
+struct AccessRecord {
+  static constexpr size_t PATH_MAX_LEN = 126;
+
+  int64_t ts_ns;       // 请求开始时间（Unix 纳秒）
+  uint32_t addr;       // 客户端 IPv4 地址（网络字节序）
+  uint16_t port;       // 客户端端口（网络字节序，与 HTTPConn::get_port 一致）
+  uint16_t status;     // 响应状态码
+  uint64_t bytes;      // 实际发出的响应字节数
+  uint32_t queue_us;   // 可读事件到线程池开始读取
+  uint32_t read_us;    // 读 socket
+  uint32_t wait_us;    // 读完到开始处理（含数据库通道排队）
+  uint32_t process_us; // 解析请求与生成响应
+  uint32_t write_us;   // 生成响应到发送完毕
+  uint32_t total_us;   // 可读事件到发送完毕
+  uint32_t requests;   // 本连接上的第几个请求（长连接复用次数 + 1）
+  uint8_t aborted;     // 发送未完成连接即关闭
+  char method[8];
+  char version[4];
+  uint8_t path_len;
+  char path[PATH_MAX_LEN];
+};
+static_assert(sizeof(AccessRecord) == 192);
+
+class AccessLog {
+public:
+  static AccessLog *get_instance() { return ptr_.get(); }
+  // 采样：每 sample_every 条记录一条，状态码 >= 400 的请求总是记录
+  static bool init(AccessLogFormat format, int sample_every = 1,
+                   int max_queue_size = 4096, int split_lines = 1000000,
+                   bool compress_rotated = true);
+
+  // 请求完成时调用，不被采样的请求不必再组装记录
+  bool sample(int status) {
+    return status >= 400 || sample_every_ <= 1 ||
+           seq_.fetch_add(1, std::memory_order_relaxed) % sample_every_ == 0;
+  }
+  // 队列满时丢弃并计数，不阻塞请求线程
+  void submit(const AccessRecord &rec);
+  void flush();
+
+  uint64_t written() const { return written_.load(); }
+  uint64_t dropped() const { return queue_.dropped(); }
+
+  static constexpr std::string_view BINARY_MAGIC = "WSACC1\n";
+  // 一行 CLF（含换行）
+  static void FormatClf(const AccessRecord &rec, std::string &out);
+
+  AccessLog(const AccessLog &) = delete;
+  AccessLog &operator=(const AccessLog &) = delete;
+  ~AccessLog();
+
+private:
+  AccessLog(AccessLogFormat format, int sample_every, int max_queue_size,
+            int split_lines, bool compress_rotated);
+  void OpenFile_();
+  void WriterLoop_();
+
+  static std::unique_ptr<AccessLog> ptr_;
+  AccessLogFormat format_;
+  uint64_t sample_every_;
+  int split_lines_;
+  bool compress_rotated_;
+  std::atomic<uint64_t> seq_{0};
+  std::atomic<uint64_t> written_{0};
+  std::atomic<uint64_t> pending_{0};
+  MpscRing<AccessRecord> queue_;
+  // 以下只由写线程访问
+  uint64_t lines_ = 0;
+  int files_ = 0;
+  LogSink sink_;
+  LogCompressor compressor_;
+  std::thread writer_;
+};
+
+#endif
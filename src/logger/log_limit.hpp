@@ -0,0 +1,95 @@
+#ifndef LOG_LIMIT_HPP_
+#define LOG_LIMIT_HPP_
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+// 单个日志调用点的限流/采样状态。由 LOG_RATE_LIMITED / LOG_SAMPLED 宏
+// 作为函数内 constinit 静态变量创建，热路径上只有几次原子操作；
+// 被抑制的条数由 Logger::report_suppressed() 定期汇总输出。
+class LogSite {
+public:
+  enum Mode { RATE, SAMPLE };
+
+  // RATE：每秒 per_sec 条、最多连续 burst 条（令牌桶）
+  // SAMPLE：每 per_sec 条输出 1 条，burst 不使用
+  constexpr LogSite(const char *file, int line, int level, int module,
+                    Mode mode, int64_t per_sec, int64_t burst)
+      : file_(file), line_(line), level_(level), module_(module),
+        mode_(mode),
+        interval_ns_(mode == RATE && per_sec > 0 ? 1000000000 / per_sec : 0),
+        every_(mode == SAMPLE && per_sec > 1 ? per_sec : 1),
+        tolerance_ns_(interval_ns_ * (burst > 1 ? burst - 1 : 0)) {}
+
+  LogSite(const LogSite &) = delete;
+  LogSite &operator=(const LogSite &) = delete;
+
+  bool Allow() {
+    bool ok = mode_ == RATE ? AllowRate_() : AllowSample_();
+    if (!ok && suppressed_.fetch_add(1, std::memory_order_relaxed) == 0) {
+      MarkPending_();
+    }
+    return ok;
+  }
+
+  // 取走并清零上次汇总以来被抑制的条数
+  uint64_t TakeSuppressed() {
+    return suppressed_.exchange(0, std::memory_order_relaxed);
+  }
+
+  const char *file() const { return file_; }
+  int line() const { return line_; }
+  int level() const { return level_; }
+  int module() const { return module_; }
+  LogSite *next() const { return next_; }
+
+  // 所有抑制过日志的调用点组成的链表，只增不删
+  static LogSite *Head() { return head_.load(std::memory_order_acquire); }
+  // 最早一条未汇总的抑制发生的时间（steady_clock 纳秒），0 表示没有
+  static std::atomic<int64_t> pendingSince;
+
+  static int64_t Now() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+  }
+
+private:
+  // GCRA 形式的令牌桶：只维护一个“理论到达时间”
+  bool AllowRate_() {
+    int64_t now = Now();
+    int64_t tat = tat_.load(std::memory_order_relaxed);
+    for (;;) {
+      int64_t base = tat > now ? tat : now;
+      if (base - now > tolerance_ns_) {
+        return false;
+      }
+      if (tat_.compare_exchange_weak(tat, base + interval_ns_,
+                                     std::memory_order_relaxed)) {
+        return true;
+      }
+    }
+  }
+  bool AllowSample_() {
+    return hits_.fetch_add(1, std::memory_order_relaxed) % every_ == 0;
+  }
+  void MarkPending_();
+
+  const char *file_;
+  int line_;
+  int level_;
+  int module_;
+  Mode mode_;
+  int64_t interval_ns_;
+  uint64_t every_;
+  int64_t tolerance_ns_;
+  std::atomic<int64_t> tat_{0};
+  std::atomic<uint64_t> hits_{0};
+  std::atomic<uint64_t> suppressed_{0};
+  std::atomic<bool> registered_{false};
+  LogSite *next_ = nullptr;
+
+  static std::atomic<LogSite *> head_;
+};
+
+#endif
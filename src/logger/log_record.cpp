@@ -0,0 +1,374 @@
+#include "log_record.hpp"
+#include <charconv>
+#include <format>
+#include <iterator>
+
+namespace {
+const char *LevelPrefixes[] = {"[DEBUG]", "[INFO] ", "[WARN] ", "[ERROR]",
+                               "[FATAL]"};
+
+template <class T> void put(std::string &out, const T &v) {
+  out.append(reinterpret_cast<const char *>(&v), sizeof(v));
+}
+
+template <class T> bool get(std::string_view &in, T &v) {
+  if (in.size() < sizeof(v)) {
+    return false;
+  }
+  std::memcpy(&v, in.data(), sizeof(v));
+  in.remove_prefix(sizeof(v));
+  return true;
+}
+
+template <class T>
+void render_one(std::string &out, const std::string &spec, T value) {
+  std::vformat_to(std::back_inserter(out), spec, std::make_format_args(value));
+}
+} // namespace
+
+std::string_view log_level_prefix(int level) {
+  if (level < 0 || level > 4) {
+    return "[?????]";
+  }
+  return LevelPrefixes[level];
+}
+
+bool log_parse_format(LogFormat &format) {
+  const std::string &fmt = format.fmt;
+  format.segments.clear();
+  LogFormat::Segment cur;
+  size_t next_auto = 0;
+  bool manual = false, automatic = false;
+  for (size_t i = 0; i < fmt.size(); ++i) {
+    char c = fmt[i];
+    if (c == '}') {
+      if (i + 1 < fmt.size() && fmt[i + 1] == '}') {
+        cur.literal += '}';
+        ++i;
+        continue;
+      }
+      return false;
+    }
+    if (c != '{') {
+      cur.literal += c;
+      continue;
+    }
+    if (i + 1 < fmt.size() && fmt[i + 1] == '{') {
+      cur.literal += '{';
+      ++i;
+      continue;
+    }
+    size_t close = fmt.find('}', i + 1);
+    if (close == std::string::npos) {
+      return false;
+    }
+    std::string_view field(fmt.data() + i + 1, close - i - 1);
+    if (field.find('{') != field.npos) {
+      return false; // 动态宽度/精度需要额外参数，不做延迟
+    }
+    size_t colon = field.find(':');
+    std::string_view id = field.substr(0, colon);
+    size_t index = 0;
+    if (id.empty()) {
+      automatic = true;
+      index = next_auto++;
+    } else {
+      manual = true;
+      auto [p, ec] = std::from_chars(id.data(), id.data() + id.size(), index);
+      if (ec != std::errc() || p != id.data() + id.size()) {
+        return false;
+      }
+    }
+    if ((manual && automatic) || index >= format.types.size()) {
+      return false;
+    }
+    cur.arg = static_cast<int>(index);
+    cur.spec = colon == field.npos
+                   ? std::string("{}")
+                   : std::format("{{:{}}}", field.substr(colon + 1));
+    format.segments.push_back(std::move(cur));
+    cur = {};
+    i = close;
+  }
+  if (!cur.literal.empty()) {
+    format.segments.push_back(std::move(cur));
+  }
+  return true;
+}
+
+bool log_render(const LogFormat &format, const char *payload, size_t len,
+                std::string &out) {
+  struct Value {
+    int64_t i = 0;
+    uint64_t u = 0;
+    double d = 0;
+    float f = 0;
+    std::string_view s;
+  };
+  std::vector<Value> values(format.types.size());
+  std::string_view in(payload, len);
+  for (size_t k = 0; k < format.types.size(); ++k) {
+    Value &v = values[k];
+    switch (format.types[k]) {
+    case LogArgType::I64:
+      if (!get(in, v.i)) {
+        return false;
+      }
+      break;
+    case LogArgType::U64:
+    case LogArgType::Ptr:
+      if (!get(in, v.u)) {
+        return false;
+      }
+      break;
+    case LogArgType::F64:
+      if (!get(in, v.d)) {
+        return false;
+      }
+      break;
+    case LogArgType::F32:
+      if (!get(in, v.f)) {
+        return false;
+      }
+      break;
+    case LogArgType::Bool:
+    case LogArgType::Char: {
+      char c;
+      if (!get(in, c)) {
+        return false;
+      }
+      v.i = c;
+      break;
+    }
+    case LogArgType::Str: {
+      uint32_t n;
+      if (!get(in, n) || in.size() < n) {
+        return false;
+      }
+      v.s = in.substr(0, n);
+      in.remove_prefix(n);
+      break;
+    }
+    default:
+      return false;
+    }
+  }
+  // 解码损坏的文件时格式说明可能与参数类型不符（如字符串配 {:d}），
+  // std::vformat_to 会抛出 format_error
+  const size_t start = out.size();
+  try {
+    for (const auto &seg : format.segments) {
+      out += seg.literal;
+      if (seg.arg < 0) {
+        continue;
+      }
+      const Value &v = values[seg.arg];
+      switch (format.types[seg.arg]) {
+      case LogArgType::I64:
+        render_one(out, seg.spec, static_cast<long long>(v.i));
+        break;
+      case LogArgType::U64:
+        render_one(out, seg.spec, static_cast<unsigned long long>(v.u));
+        break;
+      case LogArgType::F64:
+        render_one(out, seg.spec, v.d);
+        break;
+      case LogArgType::F32:
+        render_one(out, seg.spec, v.f);
+        break;
+      case LogArgType::Bool:
+        render_one(out, seg.spec, v.i != 0);
+        break;
+      case LogArgType::Char:
+        render_one(out, seg.spec, static_cast<char>(v.i));
+        break;
+      case LogArgType::Str:
+        render_one(out, seg.spec, v.s);
+        break;
+      case LogArgType::Ptr:
+        render_one(out, seg.spec,
+                   reinterpret_cast<const void *>(static_cast<uintptr_t>(v.u)));
+        break;
+      default:
+        out.resize(start);
+        return false;
+      }
+    }
+  } catch (const std::format_error &) {
+    out.resize(start);
+    return false;
+  }
+  return true;
+}
+
+void LogTimestampCache::Append(std::string &out, int64_t ts_ns) {
+  int64_t sec = ts_ns / 1000000000;
+  int64_t nsec = ts_ns % 1000000000;
+  if (nsec < 0) {
+    --sec;
+    nsec += 1000000000;
+  }
+  if (sec != sec_) {
+    sec_ = sec;
+    int64_t sod = ((sec % 86400) + 86400) % 86400;
+    std::format_to(prefix_, "[{:02}:{:02}:{:02}.", sod / 3600, sod / 60 % 60,
+                   sod % 60);
+  }
+  char digits[9];
+  for (int k = 8; k >= 0; --k) {
+    digits[k] = static_cast<char>('0' + nsec % 10);
+    nsec /= 10;
+  }
+  out.append(prefix_, 10);
+  out.append(digits, 9);
+  out += "] ";
+}
+
+uint32_t LogFormatTable::Intern(std::string_view fmt,
+                                std::span<const LogArgType> types) {
+  for (auto t : types) {
+    if (t == LogArgType::None) {
+      return 0;
+    }
+  }
+  std::string key(fmt);
+  key += '\0';
+  key.append(reinterpret_cast<const char *>(types.data()), types.size());
+  std::lock_guard<std::mutex> lk(mutex_);
+  auto it = index_.find(key);
+  if (it != index_.end()) {
+    return it->second;
+  }
+  LogFormat format;
+  format.fmt = fmt;
+  format.types.assign(types.begin(), types.end());
+  uint32_t id = 0;
+  if (log_parse_format(format)) {
+    id = static_cast<uint32_t>(formats_.size() + 1);
+    format.id = id;
+    formats_.push_back(std::move(format));
+  }
+  index_.emplace(std::move(key), id);
+  return id;
+}
+
+const LogFormat *LogFormatTable::Find(uint32_t id) const {
+  std::lock_guard<std::mutex> lk(mutex_);
+  if (id == 0 || id > formats_.size()) {
+    return nullptr;
+  }
+  return &formats_[id - 1];
+}
+
+void log_append_definition(const LogFormat &format, std::string &out) {
+  out += 'D';
+  put(out, format.id);
+  put(out, static_cast<uint32_t>(format.fmt.size()));
+  out += format.fmt;
+  out += static_cast<char>(format.types.size());
+  for (auto t : format.types) {
+    out += static_cast<char>(t);
+  }
+}
+
+void log_append_record(const LogRecord &rec, std::string &out) {
+  out += 'R';
+  put(out, rec.fmt_id);
+  put(out, rec.level);
+  put(out, rec.ts_ns);
+  put(out, static_cast<uint32_t>(rec.Size()));
+  out.append(rec.Data(), rec.Size());
+}
+
+bool LogBinaryDecoder::Feed(std::string_view data, std::string &out) {
+  pending_.append(data);
+  std::string_view in(pending_);
+  bool ok = true;
+  while (!in.empty()) {
+    long used = DecodeFrame_(in, out);
+    if (used < 0) {
+      ok = false;
+      in = {};
+      break;
+    }
+    if (used == 0) {
+      break;
+    }
+    in.remove_prefix(used);
+  }
+  pending_.erase(0, pending_.size() - in.size());
+  return ok;
+}
+
+long LogBinaryDecoder::DecodeFrame_(std::string_view data, std::string &out) {
+  std::string_view in = data;
+  switch (in[0]) {
+  case 'W': {
+    if (in.size() < LOG_BINARY_MAGIC.size()) {
+      return LOG_BINARY_MAGIC.starts_with(in) ? 0 : -1;
+    }
+    if (!in.starts_with(LOG_BINARY_MAGIC)) {
+      return -1;
+    }
+    formats_.clear(); // 新文件头之后的 id 重新定义
+    return static_cast<long>(LOG_BINARY_MAGIC.size());
+  }
+  case 'D': {
+    in.remove_prefix(1);
+    LogFormat format;
+    uint32_t len;
+    // len 来自文件，可能是任意值；len + 1 在 uint32_t 上会回绕
+    if (!get(in, format.id) || !get(in, len) || in.size() <= len) {
+      return 0;
+    }
+    format.fmt.assign(in.data(), len);
+    in.remove_prefix(len);
+    uint8_t nargs = static_cast<uint8_t>(in[0]);
+    in.remove_prefix(1);
+    if (in.size() < nargs) {
+      return 0;
+    }
+    for (uint8_t k = 0; k < nargs; ++k) {
+      auto t = static_cast<LogArgType>(in[k]);
+      if (t == LogArgType::None || t > LogArgType::F32) {
+        return -1;
+      }
+      format.types.push_back(t);
+    }
+    in.remove_prefix(nargs);
+    if (!log_parse_format(format)) {
+      return -1;
+    }
+    formats_[format.id] = std::move(format);
+    return static_cast<long>(data.size() - in.size());
+  }
+  case 'R': {
+    in.remove_prefix(1);
+    uint32_t id, len;
+    uint8_t level;
+    int64_t ts;
+    if (!get(in, id) || !get(in, level) || !get(in, ts) || !get(in, len) ||
+        in.size() < len) {
+      return 0;
+    }
+    const size_t start = out.size();
+    timestamp_.Append(out, ts);
+    out += log_level_prefix(level);
+    if (id == 0) {
+      out.append(in.data(), len);
+    } else {
+      auto it = formats_.find(id);
+      if (it == formats_.end() ||
+          !log_render(it->second, in.data(), len, out)) {
+        out.resize(start); // 不留下半行
+        return -1;
+      }
+    }
+    out += '\n';
+    in.remove_prefix(len);
+    return static_cast<long>(data.size() - in.size());
+  }
+  default:
+    return -1;
+  }
+}
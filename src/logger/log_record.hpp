@@ -0,0 +1,201 @@
+#ifndef LOG_RECORD_HPP_
+#define LOG_RECORD_HPP_
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <mutex>
+#include <span>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <unordered_map>
+#include <vector>
+
+// 延迟格式化的日志记录：调用线程只拷贝格式串 id 与原始参数，
+// 由日志线程（或离线的 log_decode 工具）完成格式化。
+
+// 可延迟编码的参数类型，与 std::format 对原类型的格式化结果一致
+enum class LogArgType : uint8_t {
+  None = 0, // 无法编码，需要在调用线程上直接格式化
+  I64 = 1,
+  U64 = 2,
+  F64 = 3,
+  Bool = 4,
+  Char = 5,
+  Str = 6,
+  Ptr = 7,
+  F32 = 8, // float 单独保存，按 float 的最短表示输出
+};
+
+template <class T> constexpr LogArgType log_arg_type() {
+  if constexpr (std::is_same_v<T, bool>) {
+    return LogArgType::Bool;
+  } else if constexpr (std::is_same_v<T, char>) {
+    return LogArgType::Char;
+  } else if constexpr (std::is_integral_v<T> && std::is_signed_v<T>) {
+    return LogArgType::I64;
+  } else if constexpr (std::is_integral_v<T>) {
+    return LogArgType::U64;
+  } else if constexpr (std::is_same_v<T, float>) {
+    return LogArgType::F32;
+  } else if constexpr (std::is_same_v<T, double>) {
+    return LogArgType::F64;
+  } else if constexpr (std::is_convertible_v<const T &, std::string_view>) {
+    return LogArgType::Str;
+  } else if constexpr (std::is_pointer_v<T> || std::is_null_pointer_v<T>) {
+    return LogArgType::Ptr;
+  } else {
+    return LogArgType::None;
+  }
+}
+
+// 一条日志。参数较少时全部放在内联缓冲区中，入队/出队不分配内存
+class LogRecord {
+public:
+  static constexpr size_t INLINE_SIZE = 192;
+
+  // fmt_id 为 0 表示 payload 是已经格式化好的正文
+  uint32_t fmt_id = 0;
+  uint8_t level = 0;
+  int64_t ts_ns = 0;
+
+  void Reset(uint32_t id, int lvl, int64_t ts) {
+    fmt_id = id;
+    level = static_cast<uint8_t>(lvl);
+    ts_ns = ts;
+    size_ = 0;
+    spill_.clear();
+  }
+  void SetText(std::string &&text) {
+    size_ = text.size();
+    spill_ = std::move(text);
+  }
+  void Append(const void *src, size_t len) {
+    if (spill_.empty() && size_ + len <= INLINE_SIZE) {
+      std::memcpy(inline_.data() + size_, src, len);
+    } else {
+      if (spill_.empty()) {
+        spill_.assign(inline_.data(), size_);
+      }
+      spill_.append(static_cast<const char *>(src), len);
+    }
+    size_ += len;
+  }
+  const char *Data() const {
+    return spill_.empty() ? inline_.data() : spill_.data();
+  }
+  size_t Size() const { return size_; }
+
+private:
+  size_t size_ = 0;
+  std::array<char, INLINE_SIZE> inline_;
+  std::string spill_;
+};
+
+template <class T> void log_encode_arg(LogRecord &rec, const T &arg) {
+  using D = std::decay_t<T>;
+  constexpr LogArgType type = log_arg_type<D>();
+  if constexpr (type == LogArgType::I64) {
+    int64_t v = arg;
+    rec.Append(&v, sizeof(v));
+  } else if constexpr (type == LogArgType::U64) {
+    uint64_t v = arg;
+    rec.Append(&v, sizeof(v));
+  } else if constexpr (type == LogArgType::F64) {
+    double v = arg;
+    rec.Append(&v, sizeof(v));
+  } else if constexpr (type == LogArgType::F32) {
+    float v = arg;
+    rec.Append(&v, sizeof(v));
+  } else if constexpr (type == LogArgType::Bool ||
+                       type == LogArgType::Char) {
+    char v = static_cast<char>(arg);
+    rec.Append(&v, 1);
+  } else if constexpr (type == LogArgType::Str) {
+    std::string_view sv(arg);
+    uint32_t len = static_cast<uint32_t>(sv.size());
+    rec.Append(&len, sizeof(len));
+    rec.Append(sv.data(), len);
+  } else if constexpr (type == LogArgType::Ptr) {
+    uint64_t v = reinterpret_cast<uintptr_t>(arg);
+    rec.Append(&v, sizeof(v));
+  }
+}
+
+// 预先拆分好的格式串：字面量与单个替换域交替
+struct LogFormat {
+  struct Segment {
+    std::string literal; // 替换域前的字面文本
+    int arg = -1;        // 替换域对应的参数下标，-1 表示只有字面量
+    std::string spec;    // 单参数格式串，如 "{:7}"
+  };
+  uint32_t id = 0;
+  std::string fmt;
+  std::vector<LogArgType> types;
+  std::vector<Segment> segments;
+};
+
+// 拆分格式串；遇到嵌套替换域（动态宽度/精度）等无法延迟的写法返回 false
+bool log_parse_format(LogFormat &format);
+
+// 按 format 解码 payload 中的参数并追加格式化结果；payload 损坏或格式说明
+// 与参数类型不符时返回 false，out 不变
+bool log_render(const LogFormat &format, const char *payload, size_t len,
+                std::string &out);
+
+// "[HH:MM:SS.nnnnnnnnn] "（UTC），同一秒内只格式化纳秒部分
+class LogTimestampCache {
+public:
+  void Append(std::string &out, int64_t ts_ns);
+
+private:
+  int64_t sec_ = INT64_MIN;
+  char prefix_[16] = {};
+};
+
+// 格式串登记表：id 从 1 开始，相同的格式串与参数类型共用一个 id
+class LogFormatTable {
+public:
+  // 无法延迟格式化时返回 0
+  uint32_t Intern(std::string_view fmt, std::span<const LogArgType> types);
+  // id 不存在时返回 nullptr；返回的指针在表的生命周期内有效
+  const LogFormat *Find(uint32_t id) const;
+
+private:
+  mutable std::mutex mutex_;
+  std::deque<LogFormat> formats_;
+  std::unordered_map<std::string, uint32_t> index_;
+};
+
+// 二进制日志文件格式（主机字节序）：
+//   文件头  "WSBLOG1\n"，追加写入同一文件时可能重复出现
+//   'D' 格式定义  u32 id, u32 fmt_len, fmt, u8 nargs, u8 types[nargs]
+//   'R' 日志记录  u32 id, u8 level, i64 ts_ns, u32 len, payload[len]
+// 每个文件在首次引用某个 id 前写入其定义，因此切分后的文件可以独立解码。
+inline constexpr std::string_view LOG_BINARY_MAGIC = "WSBLOG1\n";
+
+void log_append_definition(const LogFormat &format, std::string &out);
+void log_append_record(const LogRecord &rec, std::string &out);
+
+// 离线解码：逐段喂入文件内容，输出与文本日志相同格式的行
+class LogBinaryDecoder {
+public:
+  // 返回 false 表示数据损坏，已解码的行仍保留在 out 中
+  bool Feed(std::string_view data, std::string &out);
+  // 数据是否刚好在帧边界结束
+  bool Complete() const { return pending_.empty(); }
+
+private:
+  // 成功解码一帧返回消耗的字节数，数据不足返回 0，损坏返回 -1
+  long DecodeFrame_(std::string_view data, std::string &out);
+
+  std::string pending_;
+  std::unordered_map<uint32_t, LogFormat> formats_;
+  LogTimestampCache timestamp_;
+};
+
+// 日志级别前缀，定宽 7 列，与文本日志一致
+std::string_view log_level_prefix(int level);
+
+#endif
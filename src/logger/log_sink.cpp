@@ -0,0 +1,207 @@
+#include "log_sink.hpp"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <new>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#include <zlib.h>
+
+LogSink::~LogSink() {
+  Close();
+  for (auto *p : free_) {
+    ::operator delete(p, std::align_val_t(BLOCK_ALIGN));
+  }
+}
+
+bool LogSink::Open(const std::string &path) {
+  Close();
+  fd_ = ::open(path.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+  path_ = path;
+  return fd_ >= 0;
+}
+
+void LogSink::Close() {
+  if (fd_ < 0) {
+    return;
+  }
+  Flush();
+  ::close(fd_);
+  fd_ = -1;
+}
+
+LogSink::Block LogSink::NewBlock_() {
+  if (!free_.empty()) {
+    char *p = free_.back();
+    free_.pop_back();
+    return {p, 0};
+  }
+  return {static_cast<char *>(
+              ::operator new(BLOCK_SIZE, std::align_val_t(BLOCK_ALIGN))),
+          0};
+}
+
+void LogSink::Append(std::string_view data) {
+  while (!data.empty()) {
+    if (blocks_.empty() || blocks_.back().used == BLOCK_SIZE) {
+      if (blocks_.size() >= MAX_PENDING_BLOCKS) {
+        Flush();
+      }
+      blocks_.push_back(NewBlock_());
+    }
+    Block &b = blocks_.back();
+    size_t n = std::min(data.size(), BLOCK_SIZE - b.used);
+    std::memcpy(b.data + b.used, data.data(), n);
+    b.used += n;
+    data.remove_prefix(n);
+  }
+}
+
+void LogSink::Flush() {
+  iovec iov[MAX_PENDING_BLOCKS];
+  int cnt = 0;
+  for (const auto &b : blocks_) {
+    if (b.used > 0) {
+      iov[cnt++] = {b.data, b.used};
+    }
+  }
+  int first = 0;
+  while (fd_ >= 0 && first < cnt) {
+    ssize_t n = ::writev(fd_, iov + first, cnt - first);
+    if (n < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      ++writeErrors_; // 磁盘出错时丢弃这批日志，不阻塞日志线程
+      break;
+    }
+    ++writes_;
+    bytesWritten_ += n;
+    // 短写：跳过已写完的部分
+    while (first < cnt && static_cast<size_t>(n) >= iov[first].iov_len) {
+      n -= iov[first].iov_len;
+      ++first;
+    }
+    if (first < cnt) {
+      iov[first].iov_base = static_cast<char *>(iov[first].iov_base) + n;
+      iov[first].iov_len -= n;
+    }
+  }
+  // 留一块复用，其余归还给系统
+  for (auto &b : blocks_) {
+    if (free_.empty()) {
+      free_.push_back(b.data);
+    } else {
+      ::operator delete(b.data, std::align_val_t(BLOCK_ALIGN));
+    }
+  }
+  blocks_.clear();
+}
+
+size_t LogSink::Buffered() const {
+  size_t n = 0;
+  for (const auto &b : blocks_) {
+    n += b.used;
+  }
+  return n;
+}
+
+LogCompressor::~LogCompressor() {
+  {
+    std::lock_guard<std::mutex> lk(mtx_);
+    stop_ = true;
+  }
+  cv_.notify_all();
+  if (worker_.joinable()) {
+    worker_.join();
+  }
+}
+
+void LogCompressor::Enqueue(std::string path) {
+  {
+    std::lock_guard<std::mutex> lk(mtx_);
+    queue_.push_back(std::move(path));
+    if (!worker_.joinable()) {
+      worker_ = std::thread([this] { Run_(); });
+    }
+  }
+  cv_.notify_one();
+}
+
+void LogCompressor::Drain() {
+  std::unique_lock<std::mutex> lk(mtx_);
+  idle_.wait(lk, [this] { return queue_.empty() && !busy_; });
+}
+
+uint64_t LogCompressor::Compressed() const {
+  std::lock_guard<std::mutex> lk(mtx_);
+  return compressed_;
+}
+
+uint64_t LogCompressor::Failed() const {
+  std::lock_guard<std::mutex> lk(mtx_);
+  return failed_;
+}
+
+void LogCompressor::Run_() {
+  // 压缩只是为了省磁盘，不和请求线程抢 CPU
+  setpriority(PRIO_PROCESS, static_cast<id_t>(::syscall(SYS_gettid)), 10);
+  std::unique_lock<std::mutex> lk(mtx_);
+  for (;;) {
+    cv_.wait(lk, [this] { return stop_ || !queue_.empty(); });
+    if (queue_.empty()) {
+      return;
+    }
+    std::string path = std::move(queue_.front());
+    queue_.pop_front();
+    busy_ = true;
+    lk.unlock();
+    bool ok = CompressFile(path);
+    lk.lock();
+    busy_ = false;
+    ++(ok ? compressed_ : failed_);
+    if (queue_.empty()) {
+      idle_.notify_all();
+    }
+  }
+}
+
+bool LogCompressor::CompressFile(const std::string &path) {
+  int in = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (in < 0) {
+    return false;
+  }
+  const std::string gzPath = path + ".gz";
+  // 同名文件在同一天的多次运行中会被反复切分，追加为新的 gzip 成员
+  gzFile out = gzopen(gzPath.c_str(), "ab6");
+  if (!out) {
+    ::close(in);
+    return false;
+  }
+  gzbuffer(out, 128 * 1024);
+  std::vector<char> buf(LogSink::BLOCK_SIZE);
+  bool ok = true;
+  for (;;) {
+    ssize_t n = ::read(in, buf.data(), buf.size());
+    if (n < 0 && errno == EINTR) {
+      continue;
+    }
+    if (n <= 0) {
+      ok = n == 0;
+      break;
+    }
+    if (gzwrite(out, buf.data(), static_cast<unsigned>(n)) != n) {
+      ok = false;
+      break;
+    }
+  }
+  ::close(in);
+  ok = gzclose(out) == Z_OK && ok;
+  if (ok) {
+    ::unlink(path.c_str());
+  }
+  return ok;
+}
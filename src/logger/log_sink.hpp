@@ -0,0 +1,93 @@
+#ifndef LOG_SINK_HPP_
+#define LOG_SINK_HPP_
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+// 日志文件输出：记录先拷进按页对齐的 64K 大块，攒够若干块或调用方
+// 显式 Flush 时用一次 writev 写出，替代逐条 fstream 写入。
+// 不是线程安全的，由 Logger 在持有 mutex_ 时调用。
+class LogSink {
+public:
+  static constexpr size_t BLOCK_SIZE = 64 * 1024;
+  static constexpr size_t BLOCK_ALIGN = 4096;
+  // 写满这么多块就立即写出，限制内存占用与单次 writev 大小
+  static constexpr size_t MAX_PENDING_BLOCKS = 4;
+
+  LogSink() = default;
+  ~LogSink();
+  LogSink(const LogSink &) = delete;
+  LogSink &operator=(const LogSink &) = delete;
+
+  // 以追加方式打开，失败返回 false；已打开的文件会先 Flush 并关闭
+  bool Open(const std::string &path);
+  void Close();
+  bool IsOpen() const { return fd_ >= 0; }
+  const std::string &Path() const { return path_; }
+
+  void Append(std::string_view data);
+  // 把所有缓冲的数据写出（一次 writev，短写时继续）
+  void Flush();
+
+  size_t Buffered() const;
+  uint64_t BytesWritten() const { return bytesWritten_; }
+  uint64_t Writes() const { return writes_; }
+  uint64_t WriteErrors() const { return writeErrors_; }
+
+private:
+  struct Block {
+    char *data;
+    size_t used;
+  };
+  Block NewBlock_();
+
+  int fd_ = -1;
+  std::string path_;
+  std::vector<Block> blocks_; // 最后一块是当前正在写入的块
+  std::vector<char *> free_;  // 写出后留待复用的块
+  uint64_t bytesWritten_ = 0;
+  uint64_t writes_ = 0;
+  uint64_t writeErrors_ = 0;
+};
+
+// 后台 gzip 压缩切分出的旧日志文件，压缩成功后删除原文件。
+// 线程在第一次提交任务时才启动，并以较低优先级运行。
+class LogCompressor {
+public:
+  LogCompressor() = default;
+  // 压缩完队列中剩余的文件后退出
+  ~LogCompressor();
+  LogCompressor(const LogCompressor &) = delete;
+  LogCompressor &operator=(const LogCompressor &) = delete;
+
+  void Enqueue(std::string path);
+  // 等待已提交的文件全部处理完
+  void Drain();
+
+  uint64_t Compressed() const;
+  uint64_t Failed() const;
+
+  // 把 path 压缩追加到 path.gz，成功后删除 path
+  static bool CompressFile(const std::string &path);
+
+private:
+  void Run_();
+
+  mutable std::mutex mtx_;
+  std::condition_variable cv_;
+  std::condition_variable idle_;
+  std::deque<std::string> queue_;
+  bool busy_ = false;
+  bool stop_ = false;
+  uint64_t compressed_ = 0;
+  uint64_t failed_ = 0;
+  std::thread worker_;
+};
+
+#endif
@@ -1,5 +1,5 @@
 #include "logger.hpp"
-#include "message_buffer.hpp"
+#include <algorithm>
 #include <cassert>
 #include <chrono>
 #include <cstring>
@@ -9,12 +9,153 @@
 #include <iostream>
 #include <memory>
 #include <mutex>
+#include <signal.h>
 #include <string>
 #include <thread>
+#include <vector>
 
 std::unique_ptr<Logger> Logger::ptr_ = nullptr;
 
-std::fstream Logger::open_new_file(
+std::atomic<LogSite *> LogSite::head_{nullptr};
+std::atomic<int64_t> LogSite::pendingSince{0};
+
+void LogSite::MarkPending_() {
+  if (!registered_.exchange(true, std::memory_order_relaxed)) {
+    LogSite *head = head_.load(std::memory_order_relaxed);
+    do {
+      next_ = head;
+    } while (!head_.compare_exchange_weak(head, this,
+                                          std::memory_order_release,
+                                          std::memory_order_relaxed));
+  }
+  int64_t none = 0;
+  pendingSince.compare_exchange_strong(none, Now(),
+                                       std::memory_order_relaxed);
+}
+
+namespace {
+const char *LevelNames[] = {"debug", "info", "warn", "error", "fatal", "off"};
+const char *ModuleNames[] = {"general", "server", "http", "db",
+                             "buffer",  "pool",   "timer"};
+static_assert(std::size(ModuleNames) == static_cast<size_t>(LogModule::Count));
+
+int parse_level(std::string_view name) {
+  for (int i = 0; i <= LOG_LEVEL_OFF; ++i) {
+    if (name == LevelNames[i]) {
+      return i;
+    }
+  }
+  return -1;
+}
+
+int parse_module(std::string_view name) {
+  for (size_t i = 0; i < std::size(ModuleNames); ++i) {
+    if (name == ModuleNames[i]) {
+      return static_cast<int>(i);
+    }
+  }
+  return -1;
+}
+} // namespace
+
+bool Logger::set_levels(std::string_view spec) {
+  // 先完整解析，全部合法后再生效
+  int global = -1;
+  std::vector<std::pair<int, int>> modules;
+  while (!spec.empty()) {
+    auto comma = spec.find(',');
+    std::string_view item = spec.substr(0, comma);
+    spec = comma == spec.npos ? std::string_view() : spec.substr(comma + 1);
+    if (item.empty()) {
+      continue;
+    }
+    auto eq = item.find('=');
+    if (eq == item.npos) {
+      global = parse_level(item);
+      if (global < 0) {
+        return false;
+      }
+      continue;
+    }
+    int module = parse_module(item.substr(0, eq));
+    std::string_view value = item.substr(eq + 1);
+    int level = value == "default" ? -1 : parse_level(value);
+    if (module < 0 || (level < 0 && value != "default")) {
+      return false;
+    }
+    modules.emplace_back(module, level + 1);
+  }
+  if (global >= 0) {
+    level_.store(global, std::memory_order_relaxed);
+  }
+  for (auto [module, stored] : modules) {
+    module_levels_[module].store(stored, std::memory_order_relaxed);
+  }
+  return true;
+}
+
+std::string Logger::levels() {
+  std::string spec = LevelNames[level_.load(std::memory_order_relaxed)];
+  for (size_t i = 0; i < std::size(ModuleNames); ++i) {
+    int stored = module_levels_[i].load(std::memory_order_relaxed);
+    if (stored != 0) {
+      spec += std::format(",{}={}", ModuleNames[i], LevelNames[stored - 1]);
+    }
+  }
+  return spec;
+}
+
+void Logger::report_suppressed(bool force) {
+  static std::atomic<int64_t> lastReport{LogSite::Now()};
+  int64_t since = LogSite::pendingSince.load(std::memory_order_relaxed);
+  int64_t now = LogSite::Now();
+  if (since == 0 ||
+      (!force && now - since < SUPPRESS_REPORT_SEC * 1000000000LL) ||
+      !LogSite::pendingSince.compare_exchange_strong(
+          since, 0, std::memory_order_relaxed)) {
+    return;
+  }
+  int64_t window = (now - lastReport.exchange(now)) / 1000000000;
+  for (LogSite *site = LogSite::Head(); site; site = site->next()) {
+    uint64_t n = site->TakeSuppressed();
+    if (n == 0 || !ptr_ ||
+        !enabled(site->level(), static_cast<LogModule>(site->module()))) {
+      continue;
+    }
+    std::string_view file = site->file();
+    file = file.substr(file.rfind('/') + 1);
+    ptr_->write_log(site->level(),
+                    "Suppressed {} messages from {}:{} in the last {}s", n,
+                    file, site->line(), window);
+  }
+}
+
+int Logger::suppressed_report_due_ms() {
+  int64_t since = LogSite::pendingSince.load(std::memory_order_relaxed);
+  if (since == 0) {
+    return -1;
+  }
+  int64_t due = since + SUPPRESS_REPORT_SEC * 1000000000LL - LogSite::Now();
+  return due <= 0 ? 0 : static_cast<int>(due / 1000000 + 1);
+}
+
+void Logger::install_signal_handlers() {
+  // 信号处理函数里只做无锁原子操作
+  static_assert(std::atomic<int>::is_always_lock_free);
+  struct sigaction sa {};
+  sa.sa_flags = SA_RESTART;
+  sa.sa_handler = [](int sig) {
+    int cur = level_.load(std::memory_order_relaxed);
+    int next = sig == SIGUSR1 ? std::max(cur - 1, int(LOG_LEVEL_DEBUG))
+                              : std::min(cur + 1, int(LOG_LEVEL_OFF));
+    level_.store(next, std::memory_order_relaxed);
+  };
+  sigemptyset(&sa.sa_mask);
+  sigaction(SIGUSR1, &sa, nullptr);
+  sigaction(SIGUSR2, &sa, nullptr);
+}
+
+void Logger::open_new_file(
     const std::chrono::time_point<std::chrono::system_clock> &tp,
     std::string_view name) {
   std::string full_file_name;
@@ -22,11 +163,16 @@ std::fstream Logger::open_new_file(
       std::chrono::floor<std::chrono::days>(tp)};
   auto p = name.find('/');
   assert(p == name.npos);
-  full_file_name =
-      std::format("{}_{:02d}_{:02d}_{}.log", static_cast<int>(ymd.year()),
-                  static_cast<unsigned>(ymd.month()),
-                  static_cast<unsigned>(ymd.day()), name);
-  return std::fstream(logs_dir + full_file_name, std::ios_base::app);
+  const bool binary = mode_ == LogMode::Binary;
+  full_file_name = std::format(
+      "{}_{:02d}_{:02d}_{}.{}", static_cast<int>(ymd.year()),
+      static_cast<unsigned>(ymd.month()), static_cast<unsigned>(ymd.day()),
+      name, binary ? "binlog" : "log");
+  sink_.Open(logs_dir + full_file_name);
+  if (binary) {
+    sink_.Append(LOG_BINARY_MAGIC);
+    defined_.clear();
+  }
 }
 
 void Logger::flush() {
@@ -35,22 +181,144 @@ void Logger::flush() {
     cv_flush_.wait(
         lk, [this] { return pending_.load(std::memory_order_acquire) == 0; });
     std::lock_guard<std::mutex> io_lk(this->mutex_);
-    fs_.flush();
+    sink_.Flush();
   } else {
     std::lock_guard<std::mutex> io_lk(this->mutex_);
-    fs_.flush();
+    sink_.Flush();
   }
 }
 
 Logger::Logger(const char *file_name, bool close_log, int split_lines,
-               int max_queue_size)
+               int max_queue_size, FullPolicy full_policy, LogMode mode,
+               bool compress_rotated)
     : close_(close_log), log_name_(file_name), split_lines_(split_lines),
-      max_queue_size_(max_queue_size), queue_(max_queue_size_) {
+      max_queue_size_(max_queue_size), count_(0), mode_(mode),
+      queue_(std::max(max_queue_size_, 2), full_policy), is_async_(false),
+      compress_rotated_(compress_rotated) {
+  open_new_file(std::chrono::system_clock::now(), file_name);
+  level_.store(close_ ? LOG_LEVEL_OFF : LOG_LEVEL_INFO,
+               std::memory_order_relaxed);
   if (max_queue_size_ > 0) {
     is_async_ = true;
-    auto worker = std::thread([this] { this->async_write_log(); });
-    worker.detach();
+    writer_ = std::thread([this] { this->async_write_log(); });
+  }
+}
+Logger::~Logger() {
+  flush();
+  queue_.stop();
+  if (writer_.joinable()) {
+    writer_.join();
+  }
+}
+
+LogRecord &Logger::staging_() {
+  thread_local LogRecord rec;
+  return rec;
+}
+
+void Logger::submit_(LogRecord &rec) {
+  if (!is_async_) {
+    std::lock_guard<std::mutex> lk(mutex_);
+    rotate_if_needed_();
+    out_.clear();
+    emit_(rec, out_);
+    sink_.Append(out_);
+    if (sink_.Buffered() >= LogSink::BLOCK_SIZE) {
+      sink_.Flush();
+    }
+    return;
+  }
+  // Async path: lock-free enqueue, rotation and IO happen on the writer
+  pending_.fetch_add(1, std::memory_order_relaxed);
+  size_t evicted = 0;
+  bool queued = queue_.push(std::move(rec), &evicted);
+  if (evicted + !queued > 0) {
+    finish_pending_(evicted + !queued);
+  }
+}
+
+void Logger::rotate_if_needed_() {
+  count_++;
+  if (count_ % split_lines_ == 0) {
+    sink_.Close();
+    if (compress_rotated_) {
+      compressor_.Enqueue(sink_.Path());
+    }
+    std::string newname = this->log_name_;
+    newname += std::format("_{}", count_ / split_lines_);
+    open_new_file(std::chrono::system_clock::now(), newname);
+  }
+}
+
+void Logger::emit_(const LogRecord &rec, std::string &out) {
+  const LogFormat *format = nullptr;
+  if (rec.fmt_id != 0) {
+    if (rec.fmt_id >= format_cache_.size()) {
+      format_cache_.resize(rec.fmt_id + 1, nullptr);
+    }
+    if (!format_cache_[rec.fmt_id]) {
+      format_cache_[rec.fmt_id] = formats_.Find(rec.fmt_id);
+    }
+    format = format_cache_[rec.fmt_id];
+  }
+  if (mode_ == LogMode::Binary) {
+    if (format) {
+      if (rec.fmt_id >= defined_.size()) {
+        defined_.resize(rec.fmt_id + 1, false);
+      }
+      if (!defined_[rec.fmt_id]) {
+        log_append_definition(*format, out);
+        defined_[rec.fmt_id] = true;
+      }
+    }
+    log_append_record(rec, out);
+    return;
+  }
+  timestamp_.Append(out, rec.ts_ns);
+  out += log_level_prefix(rec.level);
+  if (format) {
+    log_render(*format, rec.Data(), rec.Size(), out);
+  } else {
+    out.append(rec.Data(), rec.Size());
+  }
+  out += '\n';
+}
+
+void Logger::finish_pending_(size_t n) {
+  auto left = pending_.fetch_sub(n, std::memory_order_acq_rel) - n;
+  if (left == 0) {
+    std::lock_guard<std::mutex> lk(flush_mtx_);
+    cv_flush_.notify_all();
+  }
+}
+
+// 批量取出后拷进 sink 的大块；只有块攒满或队列已空时才真正写文件，
+// 因此压力越大单次 writev 越大，切分与压缩也都不占用请求线程
+void Logger::async_write_log() {
+  constexpr size_t BATCH = 256;
+  std::vector<LogRecord> batch;
+  std::string out;
+  batch.reserve(BATCH);
+  for (;;) {
+    batch.clear();
+    size_t n = queue_.pop_batch(batch, BATCH);
+    if (n == 0) {
+      return;
+    }
+    out.clear();
+    std::lock_guard<std::mutex> lk(mutex_);
+    for (const auto &rec : batch) {
+      if ((count_ + 1) % split_lines_ == 0) {
+        sink_.Append(out);
+        out.clear();
+      }
+      rotate_if_needed_();
+      emit_(rec, out);
+    }
+    sink_.Append(out);
+    if (queue_.empty()) {
+      sink_.Flush();
+    }
+    finish_pending_(n);
   }
-  fs_ = open_new_file(std::chrono::system_clock::now(), file_name);
 }
-Logger::~Logger() { flush(); }
@@ -1,29 +1,114 @@
 #ifndef LOGGER_HPP_
 #define LOGGER_HPP_
 
-#include "message_buffer.hpp"
+#include "log_limit.hpp"
+#include "log_record.hpp"
+#include "log_sink.hpp"
+#include "mpsc_ring.hpp"
+#include <array>
 #include <atomic>
 #include <chrono>
 #include <condition_variable>
 #include <format>
-#include <fstream>
 #include <string_view>
 #include <thread>
 #include <utility>
+#include <vector>
 
 namespace {
-const char *Levels[] = {"[DEBUG]", "[INFO]", "[WARN]", "[ERROR]", "[FATAL]"};
 const char *logs_dir = "log/";
 } // namespace
+
+// 低于该级别的日志调用在编译期直接消除（0=DEBUG ... 4=FATAL）
+#ifndef LOG_MIN_LEVEL
+#define LOG_MIN_LEVEL 0
+#endif
+
+enum LogLevel {
+  LOG_LEVEL_DEBUG = 0,
+  LOG_LEVEL_INFO = 1,
+  LOG_LEVEL_WARN = 2,
+  LOG_LEVEL_ERROR = 3,
+  LOG_LEVEL_FATAL = 4,
+  LOG_LEVEL_OFF = 5,
+};
+
+// 可单独设置级别的模块，默认按调用点所在的源文件路径归类
+enum class LogModule {
+  General = 0,
+  Server,   // src/server/tcp_server 等
+  Http,     // src/server/HTTP*
+  Database, // src/database
+  Buffer,   // src/buffer
+  Pool,     // src/thread_pool
+  Timer,    // src/timer
+  Count,
+};
+
+constexpr LogModule log_module_of(std::string_view path) {
+  if (path.find("/HTTP") != path.npos) {
+    return LogModule::Http;
+  } else if (path.find("/server/") != path.npos) {
+    return LogModule::Server;
+  } else if (path.find("/database/") != path.npos) {
+    return LogModule::Database;
+  } else if (path.find("/buffer/") != path.npos) {
+    return LogModule::Buffer;
+  } else if (path.find("/thread_pool/") != path.npos) {
+    return LogModule::Pool;
+  } else if (path.find("/timer/") != path.npos) {
+    return LogModule::Timer;
+  }
+  return LogModule::General;
+}
+
+// 日志输出方式
+enum class LogMode {
+  Text = 0,     // 调用线程格式化正文
+  Deferred = 1, // 调用线程只记录格式串 id 与参数，日志线程格式化为文本
+  Binary = 2,   // 同上，但直接写二进制记录，由 log_decode 离线解码
+};
+
 class Logger {
 public:
   static Logger *get_instance() { return ptr_.get(); }
-  // 可选择的参数有日志文件、日志缓冲区大小、最大行数以及最长日志条队列
+
+  // 在任何格式化之前判断；未初始化或关闭日志时所有级别都不输出
+  static bool enabled(int level, LogModule module) {
+    int threshold =
+        module_levels_[static_cast<int>(module)].load(std::memory_order_relaxed);
+    if (threshold == 0) {
+      threshold = level_.load(std::memory_order_relaxed);
+    } else {
+      --threshold;
+    }
+    return level >= threshold;
+  }
+  // 形如 "info,http=debug,db=warn"：不带模块名的一项设置全局级别，
+  // "模块=default" 取消该模块的单独设置。格式错误时不做任何修改并返回 false
+  static bool set_levels(std::string_view spec);
+  // 当前设置，格式同 set_levels
+  static std::string levels();
+  // SIGUSR1 全局级别降一档（更详细），SIGUSR2 升一档
+  static void install_signal_handlers();
+
+  // 限流/采样抑制的条数汇总周期
+  static constexpr int SUPPRESS_REPORT_SEC = 10;
+  // 为每个有抑制的调用点输出一行汇总；未到周期且 force 为 false 时不做事
+  static void report_suppressed(bool force = false);
+  // 距下一次汇总的毫秒数，没有待汇总的抑制时返回 -1
+  static int suppressed_report_due_ms();
+  // 可选择的参数有日志文件、日志缓冲区大小、最大行数、最长日志条队列、
+  // 队列满时的处理策略以及输出方式
   static bool init(const char *file_name, bool close_log,
-                   int split_lines = 5000000, int max_queue_size = 0) {
+                   int split_lines = 5000000, int max_queue_size = 0,
+                   FullPolicy full_policy = FullPolicy::Block,
+                   LogMode mode = LogMode::Text,
+                   bool compress_rotated = false) {
     if (!ptr_) {
       ptr_ = std::unique_ptr<Logger>(
-          new Logger(file_name, close_log, split_lines, max_queue_size));
+          new Logger(file_name, close_log, split_lines, max_queue_size,
+                     full_policy, mode, compress_rotated));
       return true;
     }
     return false;
@@ -31,32 +116,33 @@ public:
   template <class... Args>
   void write_log(int level, std::format_string<Args...> format,
                  Args &&...args) {
-    auto current_timestamp = std::chrono::system_clock().now();
-    std::string res = std::format("[{0:%T}] ", current_timestamp) +
-                      std::format("{:7}", Levels[level]) +
-                      std::format(format, std::forward<Args>(args)...);
-    {
-      std::lock_guard lk(this->mutex_);
-      count_++;
-      if (count_ % split_lines_ == 0) {
-        fs_.flush();
-        fs_.close();
-        std::string newname = this->log_name_;
-        newname += std::format("_{}", count_ / split_lines_);
-        fs_ = open_new_file(current_timestamp, newname);
-      }
-      if (!is_async_) {
-        fs_ << res << '\n';
+    int64_t ts = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                     std::chrono::system_clock::now().time_since_epoch())
+                     .count();
+    LogRecord &rec = staging_();
+    if constexpr (((log_arg_type<std::decay_t<Args>>() != LogArgType::None) &&
+                   ...)) {
+      uint32_t id = mode_ == LogMode::Text
+                        ? 0
+                        : format_id_<std::decay_t<Args>...>(format.get());
+      if (id != 0) {
+        rec.Reset(id, level, ts);
+        (log_encode_arg(rec, args), ...);
+        submit_(rec);
         return;
       }
     }
-    // Async path: increase pending and enqueue
-    pending_.fetch_add(1, std::memory_order_relaxed);
-    queue_.push_back(std::move(res));
+    rec.Reset(0, level, ts);
+    rec.SetText(std::format(format, std::forward<Args>(args)...));
+    submit_(rec);
   }
 
   void flush(void);
 
+  // 队列满时被丢弃/挤掉的日志条数
+  uint64_t dropped() const { return queue_.dropped() + queue_.overwritten(); }
+  size_t queue_size() const { return queue_.size(); }
+
   Logger(const Logger &) = delete;
   Logger(Logger &&) = delete;
   Logger &operator=(const Logger &) = delete;
@@ -67,62 +153,112 @@ public:
 
 private:
   Logger(const char *file_name, bool close_log, int split_lines,
-         int max_queue_size);
-  std::fstream
+         int max_queue_size, FullPolicy full_policy, LogMode mode,
+         bool compress_rotated);
+  void
   open_new_file(const std::chrono::time_point<std::chrono::system_clock> &tp,
                 std::string_view name);
-  void async_write_log() {
-    std::string log;
-    while (queue_.pop_front(log)) {
-      {
-        std::lock_guard<std::mutex> lk(mutex_);
-        fs_ << log << '\n';
-      }
-      auto left = pending_.fetch_sub(1, std::memory_order_acq_rel) - 1;
-      if (left == 0) {
-        std::lock_guard<std::mutex> lk(flush_mtx_);
-        cv_flush_.notify_all();
+  // 每个线程一份预先分配好的记录，编码后整体移入队列
+  static LogRecord &staging_();
+  // 同一调用点的格式串指针不变，按参数类型分别缓存在线程本地
+  template <class... Args> uint32_t format_id_(std::string_view fmt) {
+    struct Slot {
+      const char *key = nullptr;
+      uint32_t id = 0;
+    };
+    thread_local std::array<Slot, 4> slots{};
+    thread_local size_t next = 0;
+    for (const auto &slot : slots) {
+      if (slot.key == fmt.data()) {
+        return slot.id;
       }
     }
+    static constexpr std::array<LogArgType, sizeof...(Args)> types{
+        log_arg_type<Args>()...};
+    uint32_t id = formats_.Intern(fmt, types);
+    slots[next++ % slots.size()] = {fmt.data(), id};
+    return id;
   }
+  void submit_(LogRecord &rec);
+  // 以下调用方需持有 mutex_
+  void rotate_if_needed_();
+  void emit_(const LogRecord &rec, std::string &out);
+  void finish_pending_(size_t n);
+  void async_write_log();
 
 private:
   static std::unique_ptr<Logger> ptr_;
-  [[maybe_unused]] bool close_;
+  // 全局级别；模块级别存 level + 1，0 表示跟随全局
+  static inline std::atomic<int> level_{LOG_LEVEL_OFF};
+  static inline std::atomic<int> module_levels_[static_cast<int>(
+      LogModule::Count)];
+  bool close_;
   std::string log_name_;             // log文件名
   int split_lines_;                  // 日志最大行数
   int max_queue_size_;               // 队列大小
   std::string dir_name_;             // 路径名
   size_t count_;                     // 日志行数记录
-  MessageBuffer<std::string> queue_; // 队列
+  LogMode mode_;                     // 输出方式
+  LogFormatTable formats_;           // 延迟格式化用的格式串登记表
+  MpscRing<LogRecord> queue_;        // 无锁队列
   bool is_async_;                    // 是否同步标志位
-  std::mutex mutex_;
-  std::fstream fs_;
+  std::thread writer_;               // 异步写线程
+  std::mutex mutex_;                 // 保护 sink_ 与 count_
+  LogSink sink_;                     // 大块缓冲的文件输出
+  bool compress_rotated_;            // 切分出的旧文件是否 gzip 压缩
+  LogCompressor compressor_;         // 后台压缩线程
+  std::string out_;                  // 同步模式的输出缓冲
+  LogTimestampCache timestamp_;      // 按秒缓存的时间前缀
+  std::vector<const LogFormat *> format_cache_;
+  std::vector<bool> defined_;        // 当前二进制文件已写出定义的格式串
   // For flush synchronization in async mode
   std::condition_variable cv_flush_;
   std::mutex flush_mtx_;
   std::atomic<size_t> pending_{0};
 };
 
-template <class... Arg>
-void LOG_DEBUG(std::format_string<Arg...> format, Arg &&...args) {
-  Logger::get_instance()->write_log(0, format, std::forward<Arg>(args)...);
-}
-template <class... Arg>
-void LOG_INFO(std::format_string<Arg...> format, Arg &&...args) {
-  Logger::get_instance()->write_log(1, format, std::forward<Arg>(args)...);
-}
-template <class... Arg>
-void LOG_WARN(std::format_string<Arg...> format, Arg &&...args) {
-  Logger::get_instance()->write_log(2, format, std::forward<Arg>(args)...);
-}
-template <class... Arg>
-void LOG_ERROR(std::format_string<Arg...> format, Arg &&...args) {
-  Logger::get_instance()->write_log(3, format, std::forward<Arg>(args)...);
-}
-template <class... Arg>
-void LOG_FATAL(std::format_string<Arg...> format, Arg &&...args) {
-  Logger::get_instance()->write_log(4, format, std::forward<Arg>(args)...);
-}
+#ifndef LOG_MODULE
+#define LOG_MODULE log_module_of(__FILE__)
+#endif
+
+// 级别低于 LOG_MIN_LEVEL 的调用在编译期消除，其余先检查运行时级别，
+// 关闭时参数不会被求值
+#define LOG_AT_(level, ...)                                                    \
+  do {                                                                         \
+    if constexpr ((level) >= LOG_MIN_LEVEL) {                                  \
+      constexpr LogModule log_module_ = LOG_MODULE;                            \
+      if (Logger::enabled((level), log_module_)) {                             \
+        Logger::get_instance()->write_log((level), __VA_ARGS__);               \
+      }                                                                        \
+    }                                                                          \
+  } while (0)
+
+// 调用点级别的限流（每秒 per_sec 条，允许 burst 条突发）与 1/n 采样，
+// 被抑制的条数由 Logger::report_suppressed() 定期汇总
+#define LOG_LIMITED_(level, mode, per_sec, burst, ...)                         \
+  do {                                                                         \
+    if constexpr ((level) >= LOG_MIN_LEVEL) {                                  \
+      constexpr LogModule log_module_ = LOG_MODULE;                            \
+      if (Logger::enabled((level), log_module_)) {                             \
+        static constinit LogSite log_site_(__FILE__, __LINE__, (level),        \
+                                           static_cast<int>(log_module_),     \
+                                           (mode), (per_sec), (burst));        \
+        if (log_site_.Allow()) {                                               \
+          Logger::get_instance()->write_log((level), __VA_ARGS__);             \
+        }                                                                      \
+      }                                                                        \
+    }                                                                          \
+  } while (0)
+
+#define LOG_RATE_LIMITED(level, per_sec, burst, ...)                           \
+  LOG_LIMITED_(level, LogSite::RATE, per_sec, burst, __VA_ARGS__)
+#define LOG_SAMPLED(level, n, ...)                                             \
+  LOG_LIMITED_(level, LogSite::SAMPLE, n, 0, __VA_ARGS__)
+
+#define LOG_DEBUG(...) LOG_AT_(LOG_LEVEL_DEBUG, __VA_ARGS__)
+#define LOG_INFO(...) LOG_AT_(LOG_LEVEL_INFO, __VA_ARGS__)
+#define LOG_WARN(...) LOG_AT_(LOG_LEVEL_WARN, __VA_ARGS__)
+#define LOG_ERROR(...) LOG_AT_(LOG_LEVEL_ERROR, __VA_ARGS__)
+#define LOG_FATAL(...) LOG_AT_(LOG_LEVEL_FATAL, __VA_ARGS__)
 
 #endif
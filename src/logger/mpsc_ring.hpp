@@ -0,0 +1,209 @@
+#ifndef MPSC_RING_HPP_
+#define MPSC_RING_HPP_
+#include <atomic>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <thread>
+#include <utility>
+#include <vector>
+
+// 队列满时生产者的处理方式
+enum class FullPolicy {
+  Block = 0,     // 等待消费者腾出空间
+  Drop = 1,      // 丢弃新消息并计数
+  Overwrite = 2, // 挤掉最旧的一条并计数
+};
+
+// 有界无锁多生产者队列（Vyukov 序号槽算法）。出队同样基于 CAS，
+// 因此 Overwrite 策略下生产者可以安全地替消费者弹出最旧的元素；
+// 正常使用时只有一个消费者线程。
+template <class T> class MpscRing {
+private:
+  struct Cell {
+    std::atomic<size_t> seq;
+    T data;
+  };
+
+public:
+  explicit MpscRing(size_t capacity = 1 << 10,
+                    FullPolicy policy = FullPolicy::Block)
+      : capacity_(std::bit_ceil(std::max<size_t>(capacity, 2))),
+        mask_(capacity_ - 1), policy_(policy),
+        cells_(std::make_unique<Cell[]>(capacity_)) {
+    for (size_t i = 0; i < capacity_; ++i) {
+      cells_[i].seq.store(i, std::memory_order_relaxed);
+    }
+  }
+  ~MpscRing() { stop(); }
+
+  MpscRing(const MpscRing &) = delete;
+  MpscRing &operator=(const MpscRing &) = delete;
+
+  // 返回 false 表示消息被丢弃（Drop 策略或已停止）；
+  // Overwrite 策略下被挤掉的旧消息条数累加到 evicted
+  bool push(T &&value, size_t *evicted = nullptr) {
+    for (;;) {
+      size_t pos = tail_.load(std::memory_order_relaxed);
+      Cell &cell = cells_[pos & mask_];
+      size_t seq = cell.seq.load(std::memory_order_acquire);
+      intptr_t diff = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos);
+      if (diff == 0) {
+        if (tail_.compare_exchange_weak(pos, pos + 1,
+                                        std::memory_order_relaxed)) {
+          cell.data = std::move(value);
+          cell.seq.store(pos + 1, std::memory_order_release);
+          wake_consumer_();
+          return true;
+        }
+      } else if (diff < 0) {
+        if (stop_.load(std::memory_order_relaxed)) {
+          return false;
+        }
+        switch (policy_) {
+        case FullPolicy::Drop:
+          dropped_.fetch_add(1, std::memory_order_relaxed);
+          return false;
+        case FullPolicy::Overwrite: {
+          T oldest;
+          if (pop(oldest)) {
+            overwritten_.fetch_add(1, std::memory_order_relaxed);
+            if (evicted) {
+              ++*evicted;
+            }
+          }
+          break;
+        }
+        case FullPolicy::Block:
+          wait_for_space_(pos);
+          break;
+        }
+      }
+      // diff > 0: 其他生产者抢先占了这个位置，重试
+    }
+  }
+
+  bool pop(T &out) {
+    for (;;) {
+      size_t pos = head_.load(std::memory_order_relaxed);
+      Cell &cell = cells_[pos & mask_];
+      size_t seq = cell.seq.load(std::memory_order_acquire);
+      intptr_t diff =
+          static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos + 1);
+      if (diff == 0) {
+        if (head_.compare_exchange_weak(pos, pos + 1,
+                                        std::memory_order_relaxed)) {
+          out = std::move(cell.data);
+          cell.seq.store(pos + capacity_, std::memory_order_release);
+          wake_producers_();
+          return true;
+        }
+      } else if (diff < 0) {
+        return false; // 空
+      }
+    }
+  }
+
+  // 一次最多取出 max 条，队列为空时阻塞直到有数据或 stop()。
+  // 返回 0 表示已停止且队列为空。
+  size_t pop_batch(std::vector<T> &out, size_t max) {
+    T item;
+    for (;;) {
+      size_t n = 0;
+      while (n < max && pop(item)) {
+        out.push_back(std::move(item));
+        ++n;
+      }
+      if (n > 0 || stop_.load(std::memory_order_acquire)) {
+        return n;
+      }
+      // 先登记再复查，避免与生产者的唤醒错过
+      uint32_t ticket = consumer_signal_.load(std::memory_order_acquire);
+      consumer_waiting_.store(true, std::memory_order_seq_cst);
+      std::atomic_thread_fence(std::memory_order_seq_cst);
+      if (!empty() || stop_.load(std::memory_order_acquire)) {
+        consumer_waiting_.store(false, std::memory_order_relaxed);
+        continue;
+      }
+      consumer_signal_.wait(ticket, std::memory_order_acquire);
+      consumer_waiting_.store(false, std::memory_order_relaxed);
+    }
+  }
+
+  void stop() {
+    stop_.store(true, std::memory_order_release);
+    consumer_signal_.fetch_add(1, std::memory_order_release);
+    consumer_signal_.notify_all();
+    producer_signal_.fetch_add(1, std::memory_order_release);
+    producer_signal_.notify_all();
+  }
+
+  bool empty() const {
+    size_t pos = head_.load(std::memory_order_seq_cst);
+    return cells_[pos & mask_].seq.load(std::memory_order_acquire) != pos + 1;
+  }
+  size_t size() const {
+    size_t tail = tail_.load(std::memory_order_relaxed);
+    size_t head = head_.load(std::memory_order_relaxed);
+    return tail > head ? tail - head : 0;
+  }
+  size_t capacity() const { return capacity_; }
+  uint64_t dropped() const { return dropped_.load(std::memory_order_relaxed); }
+  uint64_t overwritten() const {
+    return overwritten_.load(std::memory_order_relaxed);
+  }
+
+private:
+  // 栅栏保证“写入槽位”与“读取等待标志”不被重排，与等待方的
+  // “登记等待标志”与“复查队列”配对，避免丢失唤醒
+  void wake_consumer_() {
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (consumer_waiting_.load(std::memory_order_seq_cst)) {
+      consumer_signal_.fetch_add(1, std::memory_order_release);
+      consumer_signal_.notify_one();
+    }
+  }
+  void wake_producers_() {
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (producers_waiting_.load(std::memory_order_seq_cst) > 0) {
+      producer_signal_.fetch_add(1, std::memory_order_release);
+      producer_signal_.notify_all();
+    }
+  }
+  void wait_for_space_(size_t pos) {
+    // 先自旋一会儿，消费者通常很快就会腾出位置
+    for (int i = 0; i < 64; ++i) {
+      if (cells_[pos & mask_].seq.load(std::memory_order_acquire) >= pos ||
+          stop_.load(std::memory_order_relaxed)) {
+        return;
+      }
+      std::this_thread::yield();
+    }
+    uint32_t ticket = producer_signal_.load(std::memory_order_acquire);
+    producers_waiting_.fetch_add(1, std::memory_order_seq_cst);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (cells_[pos & mask_].seq.load(std::memory_order_seq_cst) < pos &&
+        !stop_.load(std::memory_order_relaxed)) {
+      producer_signal_.wait(ticket, std::memory_order_acquire);
+    }
+    producers_waiting_.fetch_sub(1, std::memory_order_relaxed);
+  }
+
+  const size_t capacity_;
+  const size_t mask_;
+  const FullPolicy policy_;
+  std::unique_ptr<Cell[]> cells_;
+
+  alignas(64) std::atomic<size_t> tail_{0}; // 生产者
+  alignas(64) std::atomic<size_t> head_{0}; // 消费者
+  alignas(64) std::atomic<bool> consumer_waiting_{false};
+  std::atomic<uint32_t> consumer_signal_{0};
+  std::atomic<int> producers_waiting_{0};
+  std::atomic<uint32_t> producer_signal_{0};
+  std::atomic<bool> stop_{false};
+  std::atomic<uint64_t> dropped_{0};
+  std::atomic<uint64_t> overwritten_{0};
+};
+
+#endif
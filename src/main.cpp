@@ -4,9 +4,7 @@
 int main(int argc, char *argv[]) {
   Web::Config config;
   config.parse_arg(argc, argv);
-  Web::WebServer server(config.PORT, config.TRIGMode, 5000, config.OPT_LINGER,
-                        "db.sqlite3", config.sql_num, config.thread_num,
-                        config.close_log, config.log_queue_size);
+  Web::WebServer server(config, 5000, "db.sqlite3");
   server.Start();
   return 0;
 }
\ No newline at end of file
@@ -0,0 +1,240 @@
+#include "metrics.hpp"
+#include <bit>
+#include <cmath>
+#include <format>
+#include <iterator>
+
+std::array<std::atomic<Metrics::Slot *>, Metrics::MAX_SLOTS> Metrics::slots_{};
+std::atomic<size_t> Metrics::slotCount_{0};
+std::mutex Metrics::slotMutex_;
+Metrics::Slot Metrics::overflow_;
+
+namespace {
+// Prometheus 的 le 边界（秒），覆盖 10us 到 10s
+constexpr double BucketBounds[] = {0.00001, 0.000025, 0.00005, 0.0001,
+                                   0.00025, 0.0005,   0.001,   0.0025,
+                                   0.005,   0.01,     0.025,   0.05,
+                                   0.1,     0.25,     0.5,     1,
+                                   2.5,     5,        10};
+
+const char *StageNames[] = {"accept", "read",  "parse", "db",
+                            "build",  "write", "total"};
+static_assert(std::size(StageNames) ==
+              static_cast<size_t>(MetricStage::COUNT));
+
+struct CounterInfo {
+  const char *name;
+  const char *labels;
+};
+const CounterInfo CounterNames[] = {
+    {"webserver_accepted_connections_total", ""},
+    {"webserver_requests_total", ""},
+    {"webserver_responses_total", "code=\"2xx\""},
+    {"webserver_responses_total", "code=\"3xx\""},
+    {"webserver_responses_total", "code=\"4xx\""},
+    {"webserver_responses_total", "code=\"5xx\""},
+    {"webserver_aborted_responses_total", ""},
+    {"webserver_sent_bytes_total", ""},
+};
+static_assert(std::size(CounterNames) ==
+              static_cast<size_t>(MetricCounter::COUNT));
+
+void append_labels(std::string &out, std::string_view labels) {
+  if (!labels.empty()) {
+    out += '{';
+    out += labels;
+    out += '}';
+  }
+}
+} // namespace
+
+size_t Histogram::bucket_of(uint64_t value) {
+  if (value < SUB_BUCKETS) {
+    return value;
+  }
+  const int exp = std::bit_width(value) - 1;
+  if (exp >= MAX_BITS) {
+    return BUCKETS - 1;
+  }
+  const uint64_t sub = (value >> (exp - SUB_BITS)) & (SUB_BUCKETS - 1);
+  return (exp - SUB_BITS + 1) * SUB_BUCKETS + sub;
+}
+
+uint64_t Histogram::bucket_lower(size_t bucket) {
+  if (bucket < SUB_BUCKETS) {
+    return bucket;
+  }
+  const int shift = static_cast<int>(bucket / SUB_BUCKETS) - 1;
+  return (SUB_BUCKETS + bucket % SUB_BUCKETS) << shift;
+}
+
+uint64_t Histogram::bucket_upper(size_t bucket) {
+  if (bucket < SUB_BUCKETS) {
+    return bucket + 1;
+  }
+  const int shift = static_cast<int>(bucket / SUB_BUCKETS) - 1;
+  return bucket_lower(bucket) + (uint64_t{1} << shift);
+}
+
+void Histogram::add_to(Snapshot &out) const {
+  for (size_t i = 0; i < BUCKETS; ++i) {
+    const uint64_t n = counts_[i].load(std::memory_order_relaxed);
+    out.counts[i] += n;
+    out.count += n;
+  }
+  out.sum += sum_.load(std::memory_order_relaxed);
+}
+
+uint64_t Histogram::Snapshot::quantile(double q) const {
+  if (count == 0) {
+    return 0;
+  }
+  const double target = q <= 0 ? 1 : q * static_cast<double>(count);
+  uint64_t seen = 0;
+  for (size_t i = 0; i < BUCKETS; ++i) {
+    seen += counts[i];
+    if (counts[i] && static_cast<double>(seen) >= target) {
+      return bucket_upper(i) - 1;
+    }
+  }
+  return bucket_upper(BUCKETS - 1) - 1;
+}
+
+uint64_t Histogram::Snapshot::count_at_most(uint64_t bound) const {
+  uint64_t n = 0;
+  for (size_t i = 0; i < BUCKETS && bucket_upper(i) - 1 <= bound; ++i) {
+    n += counts[i];
+  }
+  return n;
+}
+
+Metrics::Slot &Metrics::local_slot_() {
+  // 线程退出时交还槽位，累计值留给下一个线程接着加
+  struct Lease {
+    Slot *slot = nullptr;
+    ~Lease() {
+      if (slot && slot != &overflow_) {
+        slot->in_use.store(false, std::memory_order_release);
+      }
+    }
+  };
+  thread_local Lease lease;
+  if (!lease.slot) [[unlikely]] {
+    lease.slot = acquire_slot_();
+  }
+  return *lease.slot;
+}
+
+Metrics::Slot *Metrics::acquire_slot_() {
+  std::lock_guard<std::mutex> lk(slotMutex_);
+  const size_t n = slotCount_.load(std::memory_order_relaxed);
+  for (size_t i = 0; i < n; ++i) {
+    Slot *s = slots_[i].load(std::memory_order_relaxed);
+    if (!s->in_use.load(std::memory_order_acquire)) {
+      s->in_use.store(true, std::memory_order_relaxed);
+      return s;
+    }
+  }
+  if (n == MAX_SLOTS) {
+    return &overflow_;
+  }
+  // 槽位从不释放：读取方不加锁遍历，线程退出后由新线程复用
+  Slot *s = new Slot;
+  s->in_use.store(true, std::memory_order_relaxed);
+  slots_[n].store(s, std::memory_order_release);
+  slotCount_.store(n + 1, std::memory_order_release);
+  return s;
+}
+
+uint64_t Metrics::counter(MetricCounter c) {
+  const size_t idx = static_cast<size_t>(c);
+  uint64_t total = overflow_.counters[idx].load(std::memory_order_relaxed);
+  const size_t n = slotCount_.load(std::memory_order_acquire);
+  for (size_t i = 0; i < n; ++i) {
+    total += slots_[i]
+                 .load(std::memory_order_acquire)
+                 ->counters[idx]
+                 .load(std::memory_order_relaxed);
+  }
+  return total;
+}
+
+int64_t Metrics::gauge(MetricGauge g) {
+  const size_t idx = static_cast<size_t>(g);
+  int64_t total = overflow_.gauges[idx].load(std::memory_order_relaxed);
+  const size_t n = slotCount_.load(std::memory_order_acquire);
+  for (size_t i = 0; i < n; ++i) {
+    total += slots_[i]
+                 .load(std::memory_order_acquire)
+                 ->gauges[idx]
+                 .load(std::memory_order_relaxed);
+  }
+  return total;
+}
+
+Histogram::Snapshot Metrics::stage(MetricStage s) {
+  const size_t idx = static_cast<size_t>(s);
+  Histogram::Snapshot snap;
+  overflow_.stages[idx].add_to(snap);
+  const size_t n = slotCount_.load(std::memory_order_acquire);
+  for (size_t i = 0; i < n; ++i) {
+    slots_[i].load(std::memory_order_acquire)->stages[idx].add_to(snap);
+  }
+  return snap;
+}
+
+const char *Metrics::stage_name(MetricStage s) {
+  return StageNames[static_cast<size_t>(s)];
+}
+
+void Metrics::write_gauge(std::string &out, std::string_view name,
+                          std::string_view help, double value,
+                          std::string_view labels) {
+  if (!help.empty()) {
+    std::format_to(std::back_inserter(out), "# HELP {} {}\n# TYPE {} gauge\n",
+                   name, help, name);
+  }
+  out += name;
+  append_labels(out, labels);
+  std::format_to(std::back_inserter(out), " {}\n", value);
+}
+
+void Metrics::write_prometheus(std::string &out) {
+  auto it = std::back_inserter(out);
+  const char *last = nullptr;
+  for (size_t i = 0; i < std::size(CounterNames); ++i) {
+    const CounterInfo &info = CounterNames[i];
+    if (!last || std::string_view(last) != info.name) {
+      std::format_to(it, "# TYPE {} counter\n", info.name);
+      last = info.name;
+    }
+    out += info.name;
+    append_labels(out, info.labels);
+    std::format_to(it, " {}\n", counter(static_cast<MetricCounter>(i)));
+  }
+
+  write_gauge(out, "webserver_connections", "Open client connections",
+              static_cast<double>(gauge(MetricGauge::Connections)));
+
+  constexpr std::string_view hist = "webserver_stage_duration_seconds";
+  std::format_to(it,
+                 "# HELP {} Time spent in each request stage\n"
+                 "# TYPE {} histogram\n",
+                 hist, hist);
+  for (size_t s = 0; s < static_cast<size_t>(MetricStage::COUNT); ++s) {
+    const Histogram::Snapshot snap = stage(static_cast<MetricStage>(s));
+    const char *name = stage_name(static_cast<MetricStage>(s));
+    for (double bound : BucketBounds) {
+      const auto ns = static_cast<uint64_t>(std::llround(bound * 1e9));
+      std::format_to(it, "{}_bucket{{stage=\"{}\",le=\"{}\"}} {}\n", hist,
+                     name, bound, snap.count_at_most(ns));
+    }
+    std::format_to(it,
+                   "{}_bucket{{stage=\"{}\",le=\"+Inf\"}} {}\n"
+                   "{}_sum{{stage=\"{}\"}} {}\n"
+                   "{}_count{{stage=\"{}\"}} {}\n",
+                   hist, name, snap.count, hist, name,
+                   static_cast<double>(snap.sum) / 1e9, hist, name,
+                   snap.count);
+  }
+}
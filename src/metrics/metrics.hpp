@@ -0,0 +1,134 @@
+#ifndef METRICS_HPP_
+#define METRICS_HPP_
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <string_view>
+
+// 进程内指标：每个线程写自己的槽位（独占缓存行，线程之间不争用），
+// 读取时把所有槽位加起来。线程退出后槽位留给新线程继续累加，数值不会丢。
+// 以 Prometheus 文本格式输出，由 /metrics 提供。
+
+enum class MetricCounter : uint8_t {
+  Accepted,  // 接受的连接
+  Requests,  // 解析过的请求
+  Status2xx, // 按状态码分类的响应
+  Status3xx,
+  Status4xx,
+  Status5xx,
+  Aborted,   // 响应未发完连接就关闭
+  BytesSent, // 实际发出的响应字节
+  COUNT
+};
+
+// 各线程记录增减量，读取时求和；增减可以发生在不同线程
+enum class MetricGauge : uint8_t {
+  Connections, // 当前连接数（原 HTTPConn::userCount）
+  COUNT
+};
+
+// 请求各阶段耗时
+enum class MetricStage : uint8_t {
+  Accept,   // accept 到连接注册完毕
+  Read,     // 读 socket
+  Parse,    // 解析请求
+  Database, // 登录/注册：提交到数据库通道到结果回来（含排队）
+  Build,    // 生成响应
+  Write,    // 生成响应到发送完毕
+  Total,    // 可读事件到发送完毕
+  COUNT
+};
+
+// HDR 风格的对数-线性直方图：按 2 的幂分段，每段再等分 16 份，
+// 小于 16 的值精确计数，其余桶宽不超过桶下界的 1/16。
+// 单位由调用方决定（阶段耗时用纳秒），超过 2^40 的值计入最后一个桶。
+class Histogram {
+public:
+  static constexpr int SUB_BITS = 4;
+  static constexpr uint64_t SUB_BUCKETS = 1 << SUB_BITS;
+  static constexpr int MAX_BITS = 40;
+  static constexpr size_t BUCKETS = (MAX_BITS - SUB_BITS + 1) * SUB_BUCKETS;
+
+  static size_t bucket_of(uint64_t value);
+  // 桶内值的范围 [lower, upper)
+  static uint64_t bucket_lower(size_t bucket);
+  static uint64_t bucket_upper(size_t bucket);
+
+  // 汇总后的只读副本
+  struct Snapshot {
+    std::array<uint64_t, BUCKETS> counts{};
+    uint64_t count = 0;
+    uint64_t sum = 0;
+
+    // 分位值，取所在桶的上界（偏大不超过 1/16）
+    uint64_t quantile(double q) const;
+    // 不大于 bound 的值的个数，桶跨过 bound 时按桶上界判断
+    uint64_t count_at_most(uint64_t bound) const;
+  };
+
+  void record(uint64_t value) {
+    counts_[bucket_of(value)].fetch_add(1, std::memory_order_relaxed);
+    sum_.fetch_add(value, std::memory_order_relaxed);
+  }
+  void add_to(Snapshot &out) const;
+
+private:
+  std::array<std::atomic<uint64_t>, BUCKETS> counts_{};
+  std::atomic<uint64_t> sum_{0};
+};
+
+class Metrics {
+public:
+  static void add(MetricCounter c, uint64_t n = 1) {
+    local_slot_().counters[static_cast<size_t>(c)].fetch_add(
+        n, std::memory_order_relaxed);
+  }
+  static void gauge_add(MetricGauge g, int64_t delta) {
+    local_slot_().gauges[static_cast<size_t>(g)].fetch_add(
+        delta, std::memory_order_relaxed);
+  }
+  static void observe(MetricStage s, uint64_t ns) {
+    local_slot_().stages[static_cast<size_t>(s)].record(ns);
+  }
+
+  // 汇总所有线程，不加锁
+  static uint64_t counter(MetricCounter c);
+  static int64_t gauge(MetricGauge g);
+  static Histogram::Snapshot stage(MetricStage s);
+
+  // 追加本模块的全部指标
+  static void write_prometheus(std::string &out);
+  // 追加一个抓取时采样的瞬时值；labels 形如 lane="db"
+  static void write_gauge(std::string &out, std::string_view name,
+                          std::string_view help, double value,
+                          std::string_view labels = {});
+
+  static const char *stage_name(MetricStage s);
+
+  // 同时存在的线程超过此数时，多出的线程共用一个槽位（仍然正确，只是会争用）
+  static constexpr size_t MAX_SLOTS = 256;
+
+private:
+  struct alignas(64) Slot {
+    std::atomic<bool> in_use{false};
+    std::array<std::atomic<uint64_t>, static_cast<size_t>(MetricCounter::COUNT)>
+        counters{};
+    std::array<std::atomic<int64_t>, static_cast<size_t>(MetricGauge::COUNT)>
+        gauges{};
+    std::array<Histogram, static_cast<size_t>(MetricStage::COUNT)> stages;
+  };
+
+  static Slot &local_slot_();
+  static Slot *acquire_slot_();
+
+  static std::array<std::atomic<Slot *>, MAX_SLOTS> slots_;
+  static std::atomic<size_t> slotCount_;
+  static std::mutex slotMutex_;
+  static Slot overflow_;
+};
+
+#endif
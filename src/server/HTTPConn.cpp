@@ -1,40 +1,63 @@
 #include "HTTPConn.hpp"
+#include "access_log.hpp"
 #include "config.hpp"
 #include "logger.hpp"
+#include "metrics.hpp"
+#include "trace.hpp"
+#include <cerrno>
+#include <chrono>
+#include <cstring>
 using namespace Web;
 
 const char *HTTPConn::srcDir;
-std::atomic<int> HTTPConn::userCount;
 TriggerMode HTTPConn::mode = TriggerMode::LevelTrigger;
+bool HTTPConn::reclaimIdle = false;
+std::function<void(std::string &)> HTTPConn::metricsHandler;
+std::function<void(std::string &)> HTTPConn::traceHandler;
+
+int HTTPConn::UserCount() {
+  return static_cast<int>(Metrics::gauge(MetricGauge::Connections));
+}
 
 HTTPConn::HTTPConn() {
   fd_ = -1;
   addr_ = {};
   close_ = true;
+  fileSent_ = 0;
 };
 
 HTTPConn::~HTTPConn() { close(); };
 
 void HTTPConn::init(int fd, const sockaddr_in &addr) {
   assert(fd > 0);
-  userCount++;
+  Metrics::gauge_add(MetricGauge::Connections, 1);
   addr_ = addr;
   fd_ = fd;
   writeBuff_.RetrieveAll();
   readBuff_.RetrieveAll();
   close_ = false;
-  LOG_INFO("Client[{}]({}:{}) in, userCount:{}", fd_, get_IP(), get_port(),
-           userCount.load());
+  generation_.fetch_add(1, std::memory_order_acq_rel);
+  timing_ = {};
+  newData_ = false;
+  inFlight_ = false;
+  requests_ = 0;
+  acceptNs_ = NowNs_();
+  traceId_ = 0;
+  LOG_RATE_LIMITED(LOG_LEVEL_INFO, CONN_LOG_RATE, CONN_LOG_BURST,
+                   "Client[{}]({}:{}) in, userCount:{}", fd_, get_IP(),
+                   get_port(), UserCount());
 }
 
 void HTTPConn::close() {
   response_.UnmapFile();
   if (close_ == false) {
     close_ = true;
-    userCount--;
+    generation_.fetch_add(1, std::memory_order_acq_rel);
+    Metrics::gauge_add(MetricGauge::Connections, -1);
     ::close(fd_);
-    LOG_INFO("Client[{}]({}:{}) quit, UserCount:{}", fd_, get_IP(), get_port(),
-             userCount.load());
+    LOG_RATE_LIMITED(LOG_LEVEL_INFO, CONN_LOG_RATE, CONN_LOG_BURST,
+                     "Client[{}]({}:{}) quit, UserCount:{}", fd_, get_IP(),
+                     get_port(), UserCount());
   }
 }
 
@@ -47,6 +70,7 @@ const char *HTTPConn::get_IP() const { return inet_ntoa(addr_.sin_addr); }
 int HTTPConn::get_port() const { return addr_.sin_port; }
 
 ssize_t HTTPConn::read(int *saveErrno) {
+  const int64_t start = NowNs_();
   ssize_t len = -1;
   do {
     len = readBuff_.ReadFd(fd_, saveErrno);
@@ -54,60 +78,250 @@ ssize_t HTTPConn::read(int *saveErrno) {
       break;
     }
   } while (mode == TriggerMode::EdgeTrigger);
+  if (len < 0 && *saveErrno == ENOMEM) {
+    /* 环形读缓冲区映射失败（如超过 vm.max_map_count），调用方关闭连接 */
+    LOG_RATE_LIMITED(LOG_LEVEL_WARN, CONN_LOG_RATE, CONN_LOG_BURST,
+                     "Client[{}] read buffer unavailable, closing", fd_);
+  }
+  if (readBuff_.ReadableBytes() > 0) {
+    timing_.readStart = start;
+    timing_.readDone = NowNs_();
+    newData_ = true;
+    Metrics::observe(MetricStage::Read, timing_.readDone - start);
+    Trace::mark_at(traceId_, TracePoint::Dequeued, start);
+    Trace::mark_at(traceId_, TracePoint::Read, timing_.readDone);
+  }
   return len;
 }
 
 ssize_t HTTPConn::write(int *saveErrno) {
   ssize_t len = -1;
+  bool first =
+      traceId_ && to_write_bytes() == static_cast<int>(responseBytes_);
   do {
-    len = writev(fd_, iov_, iov_cnt_);
+    /* 响应头（可能分多段）在前，mmap 的文件在后 */
+    struct iovec iov[MAX_IOV];
+    int iovCnt = writeBuff_.ReadableIov(iov, MAX_IOV - 1);
+    size_t buffered = 0;
+    for (int i = 0; i < iovCnt; i++) {
+      buffered += iov[i].iov_len;
+    }
+    if (buffered == writeBuff_.ReadableBytes() && FileRemaining_() > 0) {
+      iov[iovCnt].iov_base = response_.File() + fileSent_;
+      iov[iovCnt].iov_len = FileRemaining_();
+      iovCnt++;
+    }
+    len = writev(fd_, iov, iovCnt);
     if (len <= 0) {
       *saveErrno = errno;
       break;
     }
-    if (iov_[0].iov_len + iov_[1].iov_len == 0) {
+    if (first) {
+      Trace::mark(traceId_, TracePoint::FirstByte);
+      first = false;
+    }
+    size_t fromBuff = std::min<size_t>(len, writeBuff_.ReadableBytes());
+    writeBuff_.Retrieve(fromBuff);
+    fileSent_ += len - fromBuff;
+    if (to_write_bytes() == 0) {
       break;
     } /* 传输结束 */
-    else if (static_cast<size_t>(len) > iov_[0].iov_len) {
-      iov_[1].iov_base = (uint8_t *)iov_[1].iov_base + (len - iov_[0].iov_len);
-      iov_[1].iov_len -= (len - iov_[0].iov_len);
-      if (iov_[0].iov_len) {
-        writeBuff_.RetrieveAll();
-        iov_[0].iov_len = 0;
-      }
-    } else {
-      iov_[0].iov_base = (uint8_t *)iov_[0].iov_base + len;
-      iov_[0].iov_len -= len;
-      writeBuff_.Retrieve(len);
-    }
   } while (mode == TriggerMode::EdgeTrigger || to_write_bytes() > 10240);
   return len;
 }
 
+size_t HTTPConn::FileRemaining_() const {
+  if (!response_.File()) {
+    return 0;
+  }
+  return response_.FileLen() - fileSent_;
+}
+
 bool HTTPConn::process() {
   request_.init();
   if (readBuff_.ReadableBytes() <= 0) {
     return false;
-  } else if (request_.parse(readBuff_)) {
-    LOG_DEBUG("%s", request_.path().c_str());
+  }
+  timing_.processStart = NowNs_();
+  if (!newData_) {
+    /* 同一次读入中流水线的后续请求，没有排队与读取阶段 */
+    timing_.ready = timing_.readStart = timing_.readDone =
+        timing_.processStart;
+  }
+  newData_ = false;
+  if (!traceId_) {
+    /* 长连接上紧接着的请求，没有经过 mark_ready */
+    BeginTrace_();
+  }
+  requests_++;
+  Metrics::add(MetricCounter::Requests);
+  const bool parsed = request_.parse(readBuff_);
+  const int64_t parsedAt = NowNs_();
+  Metrics::observe(MetricStage::Parse, parsedAt - timing_.processStart);
+  if (traceId_) {
+    const std::string line = request_.method() + " " + request_.path();
+    Trace::mark_at(traceId_, TracePoint::Parsed, parsedAt, 0, line);
+  }
+  if (parsed && request_.VerifyPending()) {
+    timing_.dbStart = parsedAt;
+    return true;
+  }
+  MakeResponse_(parsed);
+  return true;
+}
+
+HTTPConn::VerifyJob HTTPConn::verify_job() const {
+  return {request_.GetPost("username"), request_.GetPost("password"),
+          request_.IsLoginRequest()};
+}
+
+void HTTPConn::finish_database(bool ok) {
+  const int64_t now = NowNs_();
+  Metrics::observe(MetricStage::Database, now - timing_.dbStart);
+  Trace::mark_at(traceId_, TracePoint::Resumed, now);
+  request_.FinishVerify(ok);
+  MakeResponse_(true);
+}
+
+void HTTPConn::MakeResponse_(bool parsed) {
+  const int64_t start = NowNs_();
+  if (parsed) {
+    LOG_DEBUG("{}", request_.path());
     response_.Init(srcDir, request_.path(), request_.IsKeepAlive(), 200);
   } else {
     response_.Init(srcDir, request_.path(), false, 400);
   }
 
-  response_.MakeResponse(writeBuff_);
-  /* 响应头 */
-  iov_[0].iov_base = const_cast<char *>(writeBuff_.Peek());
-  iov_[0].iov_len = writeBuff_.ReadableBytes();
-  iov_cnt_ = 1;
+  if (!parsed || !MakeBuiltinResponse_()) {
+    response_.MakeResponse(writeBuff_);
+  }
+  fileSent_ = 0;
+  responseBytes_ = to_write_bytes();
+  timing_.processDone = NowNs_();
+  inFlight_ = true;
+  Metrics::observe(MetricStage::Build, timing_.processDone - start);
+  Trace::mark_at(traceId_, TracePoint::Built, timing_.processDone);
+  LOG_DEBUG("filesize:{}, {} to {}", response_.FileLen(),
+            writeBuff_.ReadableBytes(), to_write_bytes());
+}
 
-  /* 文件 */
-  if (response_.FileLen() > 0 && response_.File()) {
-    iov_[1].iov_base = response_.File();
-    iov_[1].iov_len = response_.FileLen();
-    iov_cnt_ = 2;
+bool HTTPConn::MakeBuiltinResponse_() {
+  /* 保留路径：在内存中生成，不查找 resource 目录 */
+  const std::function<void(std::string &)> *handler = nullptr;
+  std::string_view contentType;
+  if (request_.method() != "GET") {
+    return false;
+  } else if (metricsHandler && request_.path() == METRICS_PATH) {
+    handler = &metricsHandler;
+    contentType = "text/plain; version=0.0.4";
+  } else if (traceHandler && request_.path() == TRACE_PATH) {
+    handler = &traceHandler;
+    contentType = "application/json";
+  } else {
+    return false;
   }
-  LOG_DEBUG("filesize:{}, {} to {}", response_.FileLen(), iov_cnt_,
-            to_write_bytes());
+  thread_local std::string body;
+  body.clear();
+  (*handler)(body);
+  response_.MakeBodyResponse(writeBuff_, contentType, body);
   return true;
 }
+
+void HTTPConn::BeginTrace_() {
+  traceId_ = Trace::begin();
+  if (traceId_ && requests_ == 0) {
+    Trace::mark_at(traceId_, TracePoint::Accept, acceptNs_, fd_);
+  }
+}
+
+int64_t HTTPConn::NowNs_() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+void HTTPConn::mark_ready() {
+  timing_.ready = NowNs_();
+  if (!traceId_) {
+    BeginTrace_();
+  }
+  Trace::mark_at(traceId_, TracePoint::Readable, timing_.ready, fd_);
+}
+
+void HTTPConn::mark_writable() { Trace::mark(traceId_, TracePoint::Writable); }
+
+void HTTPConn::finish_request(bool aborted) {
+  if (!inFlight_) {
+    /* 响应生成前连接就关闭了（对端断开、等待数据库时超时） */
+    if (aborted) {
+      Trace::mark_at(traceId_, TracePoint::LastByte, NowNs_(), 0, "closed");
+      traceId_ = 0;
+    }
+    return;
+  }
+  inFlight_ = false;
+  const int64_t now = NowNs_();
+  const int64_t ready = timing_.ready ? timing_.ready : timing_.readStart;
+  const size_t sent = responseBytes_ - to_write_bytes();
+  const int code = response_.Code();
+  Trace::mark_at(traceId_, TracePoint::LastByte, now, code,
+                 aborted ? "aborted" : "");
+  traceId_ = 0;
+  Metrics::observe(MetricStage::Write, now - timing_.processDone);
+  Metrics::observe(MetricStage::Total, now - ready);
+  Metrics::add(MetricCounter::BytesSent, sent);
+  if (code >= 200 && code < 600) {
+    Metrics::add(static_cast<MetricCounter>(
+        static_cast<int>(MetricCounter::Status2xx) + code / 100 - 2));
+  }
+  if (aborted) {
+    Metrics::add(MetricCounter::Aborted);
+  }
+
+  AccessLog *log = AccessLog::get_instance();
+  if (!log || !log->sample(code)) {
+    return;
+  }
+  auto us = [](int64_t from, int64_t to) {
+    return static_cast<uint32_t>(to > from ? (to - from) / 1000 : 0);
+  };
+  AccessRecord rec{};
+  rec.ts_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                  std::chrono::system_clock::now().time_since_epoch())
+                  .count() -
+              (now - ready);
+  rec.addr = addr_.sin_addr.s_addr;
+  rec.port = addr_.sin_port;
+  rec.status = static_cast<uint16_t>(code);
+  rec.bytes = sent;
+  rec.queue_us = us(ready, timing_.readStart);
+  rec.read_us = us(timing_.readStart, timing_.readDone);
+  rec.wait_us = us(timing_.readDone, timing_.processStart);
+  rec.process_us = us(timing_.processStart, timing_.processDone);
+  rec.write_us = us(timing_.processDone, now);
+  rec.total_us = us(ready, now);
+  rec.requests = requests_;
+  rec.aborted = aborted;
+  const std::string &method = request_.method();
+  std::memcpy(rec.method, method.data(),
+              std::min(method.size(), sizeof(rec.method)));
+  const std::string &version = request_.version();
+  std::memcpy(rec.version, version.data(),
+              std::min(version.size(), sizeof(rec.version)));
+  const std::string &path = request_.path();
+  rec.path_len =
+      static_cast<uint8_t>(std::min(path.size(), AccessRecord::PATH_MAX_LEN));
+  std::memcpy(rec.path, path.data(), rec.path_len);
+  log->submit(rec);
+}
+
+void HTTPConn::reclaim() {
+  if (readBuff_.ReadableBytes() > 0 || to_write_bytes() > 0) {
+    return;
+  }
+  readBuff_.Release();
+  writeBuff_.Release();
+  request_.Release();
+  response_.Release();
+  fileSent_ = 0;
+}
@@ -5,12 +5,22 @@
 #include "HTTPResponse.hpp"
 #include "buffer.hpp"
 #include "config.hpp"
+#include "ring_buffer.hpp"
 
 #include <arpa/inet.h>
 #include <atomic>
+#include <cstdint>
+#include <functional>
+#include <string>
 
 namespace Web {
 
+#ifdef WEBSERVER_RING_BUFFER
+using ReadBuffer = RingBuffer; // 镜像环形缓冲区，免去压缩搬移
+#else
+using ReadBuffer = Buffer;
+#endif
+
 class HTTPConn {
 public:
   HTTPConn();
@@ -33,30 +43,105 @@ public:
 
   sockaddr_in get_addr() const;
 
+  // 解析请求并生成响应；登录/注册请求解析后挂起（database_pending），
+  // 由调用方把 verify_job 交给数据库线程，结果到达后调用 finish_database
   bool process();
 
-  int to_write_bytes() { return iov_[0].iov_len + iov_[1].iov_len; }
+  struct VerifyJob {
+    std::string name;
+    std::string pwd;
+    bool isLogin;
+  };
+  bool database_pending() const { return request_.VerifyPending(); }
+  VerifyJob verify_job() const;
+  void finish_database(bool ok);
+
+  // 每次 init/close 递增；异步回调据此识别连接已关闭或 fd 已被复用
+  uint64_t generation() const {
+    return generation_.load(std::memory_order_acquire);
+  }
+
+  // 一次响应发送完毕且没有待处理数据时调用：归还缓冲区、清空请求/响应状态，
+  // 下次 EPOLLIN 时再按需申请，让空闲长连接只占用对象本身的几百字节
+  void reclaim();
+
+  // 主线程分发可读事件时打点；响应发送完毕（或中途出错）时记录各阶段
+  // 耗时与状态码到 Metrics，开启访问日志时再组装一条记录交给 AccessLog
+  void mark_ready();
+  void finish_request(bool aborted);
+  // 主线程分发可写事件时打点，只对被追踪的请求有效
+  void mark_writable();
+
+  // 当前请求的追踪 id，未被采样时为 0；交给数据库线程继续打点
+  uint64_t trace_id() const { return traceId_; }
+
+  int to_write_bytes() {
+    return writeBuff_.ReadableBytes() + FileRemaining_();
+  }
 
   bool is_keep_alive() const { return request_.IsKeepAlive(); }
 
+  bool needs_database() const { return HTTPRequest::NeedsDatabase(readBuff_); }
+
+  // 当前连接数，由各线程的增减量汇总而来
+  static int UserCount();
+
   static TriggerMode mode;
   static const char *srcDir;
-  static std::atomic<int> userCount;
+  static bool reclaimIdle;
+  // 生成 /metrics 的响应体；为空时该路径按普通文件处理
+  static std::function<void(std::string &)> metricsHandler;
+  static constexpr std::string_view METRICS_PATH = "/metrics";
+  // 生成 /trace 的响应体（Chrome trace JSON）；为空时该路径按普通文件处理
+  static std::function<void(std::string &)> traceHandler;
+  static constexpr std::string_view TRACE_PATH = "/trace";
+
+  // 连接建立/关闭日志的限流：每秒条数与突发条数；
+  // WebServer 的同类日志按 1/CONN_LOG_SAMPLE 采样
+  static const int CONN_LOG_RATE = 20;
+  static const int CONN_LOG_BURST = 100;
+  static const int CONN_LOG_SAMPLE = 100;
 
 private:
+  size_t FileRemaining_() const;
+  void MakeResponse_(bool parsed);
+  // /metrics、/trace 等内存中生成的响应，不是这些路径时返回 false
+  bool MakeBuiltinResponse_();
+  void BeginTrace_();
+  static int64_t NowNs_();
+
+  static const int MAX_IOV = 16;
+
   int fd_;
   struct sockaddr_in addr_;
 
   bool close_;
+  std::atomic<uint64_t> generation_{0};
 
-  int iov_cnt_;
-  struct iovec iov_[2];
+  size_t fileSent_; // 已发送的文件字节数
 
-  Buffer readBuff_;  // 读缓冲区
-  Buffer writeBuff_; // 写缓冲区
+  ReadBuffer readBuff_;          // 读缓冲区
+  Buffer writeBuff_{1024, true}; // 写缓冲区，大响应分段挂链而不整体扩容
 
   HTTPRequest request_;
   HTTPResponse response_;
+
+  // 各阶段时间点（steady_clock 纳秒）
+  struct Timing {
+    int64_t ready = 0;
+    int64_t readStart = 0;
+    int64_t readDone = 0;
+    int64_t processStart = 0;
+    int64_t dbStart = 0;
+    int64_t processDone = 0;
+  };
+  Timing timing_;
+  bool newData_ = false;  // 上次 process 之后读到过新数据
+  bool inFlight_ = false; // 已生成响应、尚未记录完成
+  uint32_t requests_ = 0; // 本连接上处理过的请求数
+  size_t responseBytes_ = 0;
+  int64_t acceptNs_ = 0;  // 连接建立时间，追踪第一个请求时用
+  uint64_t traceId_ = 0;  // 被采样的请求在完成前非 0
 };
 
 } // namespace Web
@@ -1,6 +1,7 @@
 #include "HTTPRequest.hpp"
 #include "logger.hpp"
 #include "sqlite.hpp"
+#include "user_cache.hpp"
 #include <cassert>
 #include <cctype>
 #include <format>
@@ -22,10 +23,21 @@ const unordered_map<string, int> HTTPRequest::DEFAULT_HTML_TAG{
 void HTTPRequest::init() {
   method_ = path_ = version_ = body_ = "";
   state_ = PARSE_STATE::REQUEST_LINE;
+  verifyPending_ = verifyLogin_ = false;
   header_.clear();
   post_.clear();
 }
 
+void HTTPRequest::Release() {
+  init();
+  string().swap(method_);
+  string().swap(path_);
+  string().swap(version_);
+  string().swap(body_);
+  unordered_map<string, string>().swap(header_);
+  unordered_map<string, string>().swap(post_);
+}
+
 bool HTTPRequest::IsKeepAlive() const {
   if (header_.count("Connection") == 1) {
     return header_.find("Connection")->second == "keep-alive" &&
@@ -34,7 +46,24 @@ bool HTTPRequest::IsKeepAlive() const {
   return false;
 }
 
-bool HTTPRequest::parse(Buffer &buff) {
+template <class Buf> bool HTTPRequest::NeedsDatabase_(const Buf &buff) {
+  const char CRLF[] = "\r\n";
+  const char *lineEnd =
+      search(buff.Peek(), buff.BeginWriteConst(), CRLF, CRLF + 2);
+  std::string_view line(buff.Peek(), lineEnd - buff.Peek());
+  constexpr std::string_view post = "POST ";
+  if (line.substr(0, post.size()) != post) {
+    return false;
+  }
+  line.remove_prefix(post.size());
+  std::string path(line.substr(0, line.find(' ')));
+  if (DEFAULT_HTML.count(path)) {
+    path += ".html";
+  }
+  return DEFAULT_HTML_TAG.count(path) == 1;
+}
+
+template <class Buf> bool HTTPRequest::Parse_(Buf &buff) {
   const char CRLF[] = "\r\n";
   if (buff.ReadableBytes() <= 0) {
     return false;
@@ -63,6 +92,10 @@ bool HTTPRequest::parse(Buffer &buff) {
       break;
     }
     if (lineEnd == buff.BeginWrite()) {
+      if (state_ == PARSE_STATE::FINISH) {
+        /* 请求体没有结尾 CRLF，同样取走，免得混进长连接的下一个请求 */
+        buff.RetrieveUntil(lineEnd);
+      }
       break;
     }
     buff.RetrieveUntil(lineEnd + 2);
@@ -71,6 +104,18 @@ bool HTTPRequest::parse(Buffer &buff) {
   return true;
 }
 
+bool HTTPRequest::NeedsDatabase(const Buffer &buff) {
+  return NeedsDatabase_(buff);
+}
+
+bool HTTPRequest::NeedsDatabase(const RingBuffer &buff) {
+  return NeedsDatabase_(buff);
+}
+
+bool HTTPRequest::parse(Buffer &buff) { return Parse_(buff); }
+
+bool HTTPRequest::parse(RingBuffer &buff) { return Parse_(buff); }
+
 void HTTPRequest::ParsePath_() {
   if (path_ == "/") {
     path_ = "/index.html";
@@ -171,12 +216,8 @@ void HTTPRequest::ParsePost_() {
       int tag = DEFAULT_HTML_TAG.find(path_)->second;
       LOG_DEBUG("Tag:{}", tag);
       if (tag == 0 || tag == 1) {
-        bool isLogin = (tag == 1);
-        if (UserVerify(post_["username"], post_["password"], isLogin)) {
-          path_ = "/welcome.html";
-        } else {
-          path_ = "/error.html";
-        }
+        verifyPending_ = true;
+        verifyLogin_ = (tag == 1);
       }
     }
   }
@@ -225,40 +266,46 @@ void HTTPRequest::ParseFromUrlencoded_() {
   }
 }
 
+void HTTPRequest::FinishVerify(bool ok) {
+  verifyPending_ = false;
+  path_ = ok ? "/welcome.html" : "/error.html";
+}
+
 bool HTTPRequest::UserVerify(std::string_view name, std::string_view pwd,
                              bool isLogin) {
   if (name == "" || pwd == "") {
     return false;
   }
   LOG_INFO("Verify name:{} pwd:{}", name, pwd);
-  auto sql = Database::SQLite::get_instance();
-  if (!sql) {
+  /* 分片模式下按用户名路由到所在的数据库文件 */
+  auto sql = Database::SQLite::for_key(name);
+  auto users = Database::UserCache::get_instance();
+  if (!sql || !users) {
     LOG_ERROR("sql uninialized");
     return false;
   }
-  auto order = std::format(
-      "SELECT username, password FROM user WHERE username='{}' LIMIT 1", name);
-
+  /* 热点用户命中内存缓存；布隆过滤器判定一定不存在的用户名
+   * （多为注册）也不必查询数据库 */
   std::string error_msg;
-  auto res = sql->query(order, &error_msg);
-  if (res == nullopt) {
-    LOG_ERROR("query failed");
+  auto user = users->find(name, &error_msg);
+  if (!error_msg.empty()) {
+    LOG_ERROR("query failed: {}", error_msg);
     return false;
   }
 
   if (isLogin) {
-    if (res->rows.empty()) {
+    if (!user) {
       LOG_ERROR("record not found");
       return false;
     }
-    return res->rows[0][0] == name && res->rows[0][1] == pwd;
+    return user->password == pwd;
   }
-  if (!res->rows.empty()) {
+  if (user) {
     LOG_ERROR("already registered");
     return false;
   }
-  auto insert_flag = sql->execute(std::format(
-      "INSERT INTO user(username, password) VALUES('{}','{}')", name, pwd));
+  auto insert_flag = sql->execute(
+      "INSERT INTO user(username, password) VALUES(?, ?)", {name, pwd});
   return insert_flag;
 }
 
@@ -2,6 +2,7 @@
 #define HTTP_REQUEST_HPP_
 
 #include "buffer.hpp"
+#include "ring_buffer.hpp"
 #include <string>
 #include <string_view>
 #include <unordered_map>
@@ -32,7 +33,10 @@ public:
   ~HTTPRequest() = default;
 
   void init();
+  // 连同字符串、哈希表的堆内存一起释放，供空闲连接回收使用
+  void Release();
   bool parse(Buffer &buff);
+  bool parse(RingBuffer &buff);
 
   std::string path() const;
   std::string &path();
@@ -42,6 +46,21 @@ public:
 
   bool IsKeepAlive() const;
 
+  // 只看请求行，判断该请求是否会走到数据库（登录/注册表单）
+  static bool NeedsDatabase(const Buffer &buff);
+  static bool NeedsDatabase(const RingBuffer &buff);
+
+  // 登录/注册表单解析完后不在解析线程里查库，而是挂起等待校验：
+  // 调用方把 GetPost 得到的用户名密码交给 UserVerify 异步执行，
+  // 结果到达后调用 FinishVerify 决定跳转页面
+  bool VerifyPending() const { return verifyPending_; }
+  bool IsLoginRequest() const { return verifyLogin_; }
+  void FinishVerify(bool ok);
+
+  // 会阻塞在 SQLite 上，只应在数据库线程中调用
+  static bool UserVerify(std::string_view name, std::string_view pwd,
+                         bool isLogin);
+
   /*
   todo
   void HttpConn::ParseFormData() {}
@@ -49,6 +68,9 @@ public:
   */
 
 private:
+  template <class Buf> bool Parse_(Buf &buff);
+  template <class Buf> static bool NeedsDatabase_(const Buf &buff);
+
   bool ParseRequestLine_(std::string_view line);
   void ParseHeader_(std::string_view line);
   void ParseBody_(std::string_view line);
@@ -57,10 +79,9 @@ private:
   void ParsePost_();
   void ParseFromUrlencoded_();
 
-  static bool UserVerify(std::string_view name, std::string_view pwd,
-                         bool isLogin);
-
   PARSE_STATE state_;
+  bool verifyPending_;
+  bool verifyLogin_;
   std::string method_, path_, version_, body_;
   std::unordered_map<std::string, std::string> header_;
   std::unordered_map<std::string, std::string> post_;
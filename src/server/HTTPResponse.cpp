@@ -80,11 +80,20 @@ void HTTPResponse::MakeResponse(Buffer &buff) {
   }
   ErrorHtml_();
   AddStateLine_(buff);
-  AddHeader_(buff);
+  AddHeader_(buff, GetFileType_());
   AddContent_(buff);
 }
 
-char *HTTPResponse::File() { return mmFile_; }
+void HTTPResponse::MakeBodyResponse(Buffer &buff, std::string_view contentType,
+                                    std::string_view body) {
+  code_ = 200;
+  AddStateLine_(buff);
+  AddHeader_(buff, string(contentType));
+  buff.Append("Content-length: " + to_string(body.size()) + "\r\n\r\n");
+  buff.Append(body.data(), body.size());
+}
+
+char *HTTPResponse::File() const { return mmFile_; }
 
 size_t HTTPResponse::FileLen() const { return mmFileStat_.st_size; }
 
@@ -106,7 +115,7 @@ void HTTPResponse::AddStateLine_(Buffer &buff) {
   buff.Append("HTTP/1.1 " + to_string(code_) + " " + status + "\r\n");
 }
 
-void HTTPResponse::AddHeader_(Buffer &buff) {
+void HTTPResponse::AddHeader_(Buffer &buff, const string &contentType) {
   buff.Append("Connection: ");
   if (isKeepAlive_) {
     buff.Append("keep-alive\r\n");
@@ -114,7 +123,7 @@ void HTTPResponse::AddHeader_(Buffer &buff) {
   } else {
     buff.Append("close\r\n");
   }
-  buff.Append("Content-type: " + GetFileType_() + "\r\n");
+  buff.Append("Content-type: " + contentType + "\r\n");
 }
 
 void HTTPResponse::AddContent_(Buffer &buff) {
@@ -145,6 +154,13 @@ void HTTPResponse::UnmapFile() {
   }
 }
 
+void HTTPResponse::Release() {
+  UnmapFile();
+  mmFileStat_ = {};
+  string().swap(path_);
+  string().swap(srcDir_);
+}
+
 string HTTPResponse::GetFileType_() {
   /* 判断文件类型 */
   string::size_type idx = path_.find_last_of('.');
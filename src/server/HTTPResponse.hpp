@@ -19,15 +19,20 @@ public:
   void Init(std::string_view srcDir, std::string_view path,
             bool isKeepAlive = false, int code = -1);
   void MakeResponse(Buffer &buff);
+  // 响应体已在内存中（如 /metrics），不访问文件系统；需先调用 Init
+  void MakeBodyResponse(Buffer &buff, std::string_view contentType,
+                        std::string_view body);
   void UnmapFile();
-  char *File();
+  // 解除映射并释放路径字符串，供空闲连接回收使用
+  void Release();
+  char *File() const;
   size_t FileLen() const;
   void ErrorContent(Buffer &buff, std::string message);
   int Code() const { return code_; }
 
 private:
   void AddStateLine_(Buffer &buff);
-  void AddHeader_(Buffer &buff);
+  void AddHeader_(Buffer &buff, const std::string &contentType);
   void AddContent_(Buffer &buff);
 
   void ErrorHtml_();
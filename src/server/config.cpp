@@ -1,54 +1,223 @@
 #include "config.hpp"
+#include "sqlite.hpp"
+#include <climits>
+#include <cstdio>
 #include <cstdlib>
 #include <unistd.h>
 namespace Web {
 
+namespace {
+// 取值须为 [lo, hi] 内的整数；否则与 getopt 对未知选项的处理一样，
+// 在 stderr 提示并忽略，保留默认值（action 为提示中的后续处理）
+bool ParseInRange(int opt, const char *arg, long lo, long hi, long *out,
+                  const char *action = "ignored") {
+  char *end = nullptr;
+  long v = strtol(arg, &end, 10);
+  if (end == arg || *end != '\0' || v < lo || v > hi) {
+    fprintf(stderr, "invalid value for -%c: \"%s\" (expected %ld..%ld), %s\n",
+            opt, arg, lo, hi, action);
+    return false;
+  }
+  *out = v;
+  return true;
+}
+
+bool ParseInRange(int opt, const char *arg, int lo, int hi, int *out,
+                  const char *action = "ignored") {
+  long v;
+  if (!ParseInRange(opt, arg, static_cast<long>(lo), static_cast<long>(hi),
+                    &v, action)) {
+    return false;
+  }
+  *out = static_cast<int>(v);
+  return true;
+}
+
+// 开关类选项只接受 0 或 1
+bool ParseInRange(int opt, const char *arg, bool *out) {
+  int v;
+  if (!ParseInRange(opt, arg, 0, 1, &v)) {
+    return false;
+  }
+  *out = v != 0;
+  return true;
+}
+} // namespace
+
 Config::Config() {
   PORT = 9999;
   TRIGMode = 0;
   OPT_LINGER = 0;
   sql_num = 8;
+  sql_thread_local = true;
+  sql_checkpoint_ms = 1000;
+  sql_mmap_mb = 64;
+  sql_cache_kb = 0;
+  sql_shards = 1;
   thread_num = 8;
+  db_thread_num = 2;
   close_log = false;
   log_queue_size = 1024;
+  log_full_policy = 0;
+  log_mode = 0;
+  log_compress = true;
+  log_levels = "info";
+  access_log = 0;
+  access_sample = 1;
+  user_cache_size = 100000;
+  admission = {};
+  adaptive = {};
+  reclaim_idle = false;
+  metrics = false;
+  trace_sample = 0;
 }
 
 void Config::parse_arg(int argc, char *argv[]) {
   int opt;
-  const char *str = "p:m:o:s:t:c:q:";
+  const char *str =
+      "p:m:o:s:T:k:M:K:D:t:d:x:n:w:c:q:F:l:v:z:A:S:U:a:Q:L:r:e:g:";
   while ((opt = getopt(argc, argv, str)) != -1) {
     switch (opt) {
     case 'p': {
-      PORT = atoi(optarg);
+      ParseInRange(opt, optarg, 1, 65535, &PORT);
       break;
     }
     case 'm': {
-      TRIGMode = atoi(optarg);
+      ParseInRange(opt, optarg, 0, 3, &TRIGMode);
       break;
     }
     case 'o': {
-      OPT_LINGER = atoi(optarg);
+      ParseInRange(opt, optarg, 0, 1, &OPT_LINGER);
       break;
     }
     case 's': {
-      sql_num = atoi(optarg);
+      ParseInRange(opt, optarg, 1, INT_MAX, &sql_num);
+      break;
+    }
+    case 'T': {
+      ParseInRange(opt, optarg, &sql_thread_local);
+      break;
+    }
+    case 'k': {
+      ParseInRange(opt, optarg, 0, INT_MAX, &sql_checkpoint_ms);
+      break;
+    }
+    case 'M': {
+      ParseInRange(opt, optarg, 0, INT_MAX, &sql_mmap_mb);
+      break;
+    }
+    case 'K': {
+      ParseInRange(opt, optarg, 0, INT_MAX, &sql_cache_kb);
+      break;
+    }
+    case 'D': {
+      // 分片数决定用户数据在哪个文件里，不能换成默认值继续运行
+      if (!ParseInRange(opt, optarg, 1,
+                        static_cast<int>(Database::SQLite::MAX_SHARDS),
+                        &sql_shards, "exiting")) {
+        exit(EXIT_FAILURE);
+      }
       break;
     }
     case 't': {
-      thread_num = atoi(optarg);
+      ParseInRange(opt, optarg, 1, INT_MAX, &thread_num);
+      break;
+    }
+    case 'd': {
+      ParseInRange(opt, optarg, 1, INT_MAX, &db_thread_num);
+      break;
+    }
+    case 'x': {
+      ParseInRange(opt, optarg, 0, INT_MAX, &adaptive.max_threads);
+      break;
+    }
+    case 'n': {
+      ParseInRange(opt, optarg, 1, INT_MAX, &adaptive.min_threads);
+      break;
+    }
+    case 'w': {
+      ParseInRange(opt, optarg, 1, INT_MAX, &adaptive.target_wait_ms);
       break;
     }
     case 'c': {
-      close_log = atoi(optarg);
+      ParseInRange(opt, optarg, &close_log);
       break;
     }
     case 'q': {
-      log_queue_size = atoi(optarg);
+      ParseInRange(opt, optarg, 1, INT_MAX, &log_queue_size);
+      break;
+    }
+    case 'F': {
+      ParseInRange(opt, optarg, 0, 2, &log_full_policy);
+      break;
+    }
+    case 'l': {
+      ParseInRange(opt, optarg, 0, 2, &log_mode);
+      break;
+    }
+    case 'z': {
+      ParseInRange(opt, optarg, &log_compress);
+      break;
+    }
+    case 'v': {
+      log_levels = optarg;
+      break;
+    }
+    case 'A': {
+      ParseInRange(opt, optarg, 0, 2, &access_log);
+      break;
+    }
+    case 'S': {
+      ParseInRange(opt, optarg, 1, INT_MAX, &access_sample);
+      break;
+    }
+    case 'U': {
+      ParseInRange(opt, optarg, 0, INT_MAX, &user_cache_size);
+      break;
+    }
+    case 'a': {
+      long v;
+      if (ParseInRange(opt, optarg,
+                       static_cast<long>(AdmissionMode::Off),
+                       static_cast<long>(AdmissionMode::PauseAccept), &v)) {
+        admission.mode = static_cast<AdmissionMode>(v);
+      }
+      break;
+    }
+    case 'Q': {
+      long v;
+      if (ParseInRange(opt, optarg, 1, INT_MAX, &v)) {
+        admission.max_queue_depth = static_cast<size_t>(v);
+      }
+      break;
+    }
+    case 'L': {
+      long v;
+      if (ParseInRange(opt, optarg, 1, INT_MAX, &v)) {
+        admission.max_queue_latency_ms = static_cast<int>(v);
+      }
+      break;
+    }
+    case 'r': {
+      ParseInRange(opt, optarg, &reclaim_idle);
+      break;
+    }
+    case 'e': {
+      ParseInRange(opt, optarg, &metrics);
+      break;
+    }
+    case 'g': {
+      ParseInRange(opt, optarg, 0, INT_MAX, &trace_sample);
       break;
     }
     default:
       break;
     }
   }
+  if (adaptive.max_threads > 0 && adaptive.min_threads > adaptive.max_threads) {
+    fprintf(stderr, "-n %d is above -x %d, ignored\n", adaptive.min_threads,
+            adaptive.max_threads);
+    adaptive.min_threads = AdaptivePolicy{}.min_threads;
+  }
 }
 } // namespace Web
\ No newline at end of file
@@ -1,9 +1,38 @@
 #ifndef CONFIG_HPP_
 #define CONFIG_HPP_
+#include <cstddef>
+#include <string>
 namespace Web {
 
 enum class TriggerMode { EdgeTrigger = 0, LevelTrigger = 1 };
 
+// 过载时的准入策略
+enum class AdmissionMode {
+  Off = 0,         // 不做限制，仅在 MAX_FD 时拒绝
+  Shed = 1,        // 直接回复预先渲染好的 503
+  PauseAccept = 2, // 暂停 accept，已建立的连接照常处理
+};
+
+struct AdmissionPolicy {
+  AdmissionMode mode = AdmissionMode::Off;
+  // 线程池排队任务数阈值
+  size_t max_queue_depth = 1024;
+  // 线程池排队时延阈值（毫秒）
+  int max_queue_latency_ms = 500;
+  // 503 响应中的 Retry-After（秒）
+  int retry_after_sec = 1;
+};
+
+// 静态资源通道线程池的自适应伸缩
+struct AdaptivePolicy {
+  // 线程数上限，0 表示关闭自适应、固定为 -t 指定的规模
+  int max_threads = 0;
+  // 线程数下限
+  int min_threads = 1;
+  // 排队时延目标（毫秒），持续超过即扩容
+  int target_wait_ms = 20;
+};
+
 class Config {
 
 public:
@@ -22,14 +51,66 @@ public:
   // 数据库连接池数量
   int sql_num;
 
-  // 线程池内的线程数量
+  // 查询线程各自持有只读连接，连接池只作后备
+  bool sql_thread_local;
+
+  // 后台 WAL checkpoint 周期（毫秒），0 为沿用 SQLite 写入时的自动 checkpoint
+  int sql_checkpoint_ms;
+
+  // 只读连接的 mmap 大小（MB）与页缓存大小（KB），0 为 SQLite 默认
+  int sql_mmap_mb;
+  int sql_cache_kb;
+
+  // 用户表按用户名哈希分到几个数据库文件，1 为不分片
+  int sql_shards;
+
+  // 线程池内的线程数量（两个通道合计）
   int thread_num;
 
+  // 其中分给数据库通道（登录/注册）的线程数量
+  int db_thread_num;
+
   // 是否关闭日志
   bool close_log;
 
   int log_queue_size;
+
+  // 异步日志队列满时的策略：0=阻塞，1=丢弃新日志并计数，2=覆盖最旧的日志
+  int log_full_policy;
+
+  // 日志输出方式：0=文本，1=日志线程延迟格式化，2=二进制（log_decode 解码）
+  int log_mode;
+
+  // 切分出的旧日志文件是否在后台 gzip 压缩
+  bool log_compress;
+
+  // 日志级别，如 "info,http=debug"，运行时可用 SIGUSR1/SIGUSR2 调整
+  std::string log_levels;
+
+  // 访问日志：0=关闭，1=CLF 文本，2=定长二进制（log_decode 解码）
+  int access_log;
+
+  // 访问日志采样，每 N 个请求记一条，错误响应总是记录
+  int access_sample;
+
+  // 用户记录缓存容量（条），0 为关闭
+  int user_cache_size;
+
+  // 过载保护
+  AdmissionPolicy admission;
+
+  // 线程池自适应伸缩
+  AdaptivePolicy adaptive;
+
+  // 长连接空闲时释放缓冲区与请求/响应状态
+  bool reclaim_idle;
+
+  // 是否在 /metrics 提供 Prometheus 格式的运行指标；该路径不做鉴权，默认关闭
+  bool metrics;
+
+  // 请求追踪采样，每 N 个请求追踪一个，0 为关闭
+  int trace_sample;
 };
 } // namespace Web
 
-#endif
\ No newline at end of file
+#endif
@@ -1,31 +1,104 @@
 #include "tcp_server.hpp"
 #include "HTTPConn.hpp"
+#include "access_log.hpp"
+#include "async_executor.hpp"
+#include "buffer_pool.hpp"
 #include "config.hpp"
 #include "epoller.hpp"
 #include "heaptimer.hpp"
 #include "logger.hpp"
+#include "metrics.hpp"
 #include "sqlite.hpp"
+#include "user_cache.hpp"
 #include "thread_pool.hpp"
+#include "trace.hpp"
 #include <cstdint>
+#include <format>
 #include <memory>
 
 namespace Web {
 
-WebServer::WebServer(int port, int trigMode, int timeoutMS, bool OptLinger,
-                     const char *dbName, int connPoolNum, int threadNum,
-                     bool closelog, int logQueSize)
-    : port_(port), openLinger_(OptLinger), timeoutMS_(timeoutMS),isClose_(false) {
+WebServer::WebServer(const Config &config, int timeoutMS, const char *dbName)
+    : port_(config.PORT), openLinger_(config.OPT_LINGER),
+      timeoutMS_(timeoutMS), isClose_(false), admission_(config.admission),
+      acceptPaused_(false), shedRequests_(0), shedConns_(0), acceptPauses_(0),
+      timerCount_(0) {
   srcDir_ = getcwd(nullptr, 256);
   assert(srcDir_);
   strncat(srcDir_, "/resource/", 16);
-  HTTPConn::userCount = 0;
   HTTPConn::srcDir = srcDir_;
-  Database::SQLite::init(dbName, connPoolNum);
-  threadpool_ = std::make_unique<ThreadPool>(threadNum);
+  HTTPConn::reclaimIdle = config.reclaim_idle;
+  if (config.metrics) {
+    HTTPConn::metricsHandler = [this](std::string &out) { WriteMetrics_(out); };
+  }
+  const int traceSample = std::max(config.trace_sample, 0);
+  Trace::set_sample(static_cast<uint32_t>(traceSample));
+  if (traceSample > 0) {
+    HTTPConn::traceHandler = [](std::string &out) {
+      Trace::write_chrome_json(out);
+    };
+  }
+  Database::SQLite::Options dbOptions;
+  dbOptions.read_pool_size = config.sql_num;
+  dbOptions.thread_local_reads = config.sql_thread_local;
+  /* checkpoint 交给后台线程，不再由恰好越过阈值的那次提交同步执行 */
+  dbOptions.checkpoint_interval =
+      std::chrono::milliseconds(std::max(config.sql_checkpoint_ms, 0));
+  dbOptions.mmap_size = static_cast<int64_t>(std::max(config.sql_mmap_mb, 0))
+                        << 20;
+  dbOptions.cache_size = -std::max(config.sql_cache_kb, 0);
+  dbOptions.temp_store = 2;
+  dbOptions.shards = static_cast<size_t>(config.sql_shards);
+  Database::SQLite::init(dbName, dbOptions);
+  const size_t userCacheSize =
+      static_cast<size_t>(std::max(config.user_cache_size, 0));
+  Database::UserCache::init(userCacheSize);
   epoller_ = std::make_unique<Epoller>();
   timer_ = std::make_unique<HeapTimer>();
-  Logger::init("log", closelog, 50000, logQueSize);
-  InitEventMode_(trigMode);
+  const bool closelog = config.close_log;
+  Logger::init(
+      "log", closelog, 50000, config.log_queue_size,
+      static_cast<FullPolicy>(std::clamp(config.log_full_policy, 0, 2)),
+      static_cast<LogMode>(std::clamp(config.log_mode, 0, 2)),
+      config.log_compress);
+  const bool levelsOk = closelog || Logger::set_levels(config.log_levels);
+  Logger::install_signal_handlers();
+  const bool accessLogOn = AccessLog::init(
+      static_cast<AccessLogFormat>(std::clamp(config.access_log, 0, 2)),
+      config.access_sample, config.log_queue_size * 4, 1000000,
+      config.log_compress);
+  InitEventMode_(config.TRIGMode);
+  /* 数据库请求只在专用线程上阻塞，解析线程提交后立即返回，
+   * 慢查询不会占住处理静态资源的线程 */
+  const int threadNum = config.thread_num;
+  const int dbThreadNum =
+      std::clamp(config.db_thread_num, 1, std::max(1, threadNum - 1));
+  const int staticThreadNum = std::max(1, threadNum - dbThreadNum);
+  dbExecutor_ = std::make_unique<Database::AsyncExecutor>(dbThreadNum);
+  epoller_->insert(dbExecutor_->event_fd(), EPOLLIN);
+  const AdaptivePolicy &adaptive = config.adaptive;
+  if (adaptive.max_threads > 0) {
+    ThreadPool::Adaptive opt;
+    opt.min_threads = std::max(1, adaptive.min_threads);
+    opt.max_threads = adaptive.max_threads;
+    opt.target_wait = std::chrono::milliseconds(adaptive.target_wait_ms);
+    threadpool_ = std::make_unique<ThreadPool>(
+        staticThreadNum, opt,
+        [](size_t from, size_t to, std::string_view reason) {
+          LOG_INFO("ThreadPool[static] resize {} -> {}: {}", from, to, reason);
+        });
+  } else {
+    threadpool_ = std::make_unique<ThreadPool>(staticThreadNum);
+  }
+
+  const std::string busyBody = "Server busy, retry later.\n";
+  busyResponse_ = std::format("HTTP/1.1 503 Service Unavailable\r\n"
+                              "Retry-After: {}\r\n"
+                              "Connection: close\r\n"
+                              "Content-type: text/plain\r\n"
+                              "Content-length: {}\r\n\r\n{}",
+                              admission_.retry_after_sec, busyBody.size(),
+                              busyBody);
 
   if (!InitSocket_()) {
     isClose_ = true;
@@ -36,19 +109,113 @@ WebServer::WebServer(int port, int trigMode, int timeoutMS, bool OptLinger,
       LOG_ERROR("========== Server init error!==========");
     } else {
       LOG_INFO("========== Server init ==========");
-      LOG_INFO("Port:{}, OpenLinger: {}", port_, OptLinger);
+      if (!levelsOk) {
+        LOG_WARN("Invalid log level spec \"{}\", ignored",
+                 config.log_levels);
+      }
+      LOG_INFO("Log levels: {}", Logger::levels());
+      LOG_INFO("Port:{}, OpenLinger: {}", port_, openLinger_);
       LOG_INFO("Listen Mode: {}, OpenConn Mode: {}",
                (listenEvent_ & EPOLLET ? "ET" : "LT"),
                (connEvent_ & EPOLLET ? "ET" : "LT"));
       LOG_INFO("srcDir: {}", HTTPConn::srcDir);
-      LOG_INFO("SqlConnPool num: {}, ThreadPool num: {}", connPoolNum,
-               threadNum);
+      LOG_INFO("Reclaim idle connection memory: {}", config.reclaim_idle);
+      LOG_INFO("Metrics endpoint: {}",
+               config.metrics ? HTTPConn::METRICS_PATH : "off");
+      if (traceSample > 0) {
+        LOG_INFO("Request tracing: 1/{}, dump at {}", traceSample,
+                 HTTPConn::TRACE_PATH);
+      }
+      LOG_INFO("User cache capacity: {}", userCacheSize);
+      if (accessLogOn) {
+        LOG_INFO("Access log: {}, sample 1/{}",
+                 config.access_log == 2 ? "binary" : "CLF",
+                 std::max(config.access_sample, 1));
+      }
+      LOG_INFO("SqlConnPool num: {}, thread-local reads: {}, ThreadPool num: "
+               "{} (static: {}, db: {})",
+               config.sql_num, config.sql_thread_local, threadNum,
+               staticThreadNum, dbThreadNum);
+      LOG_INFO("SQLite shards: {}, checkpoint interval: {}ms, mmap: {}MB, "
+               "cache: {}",
+               Database::SQLite::shard_count(),
+               std::max(config.sql_checkpoint_ms, 0),
+               std::max(config.sql_mmap_mb, 0),
+               config.sql_cache_kb > 0
+                   ? std::format("{}KB", config.sql_cache_kb)
+                   : "default");
+      if (adaptive.max_threads > 0) {
+        LOG_INFO("Adaptive ThreadPool: {}-{} threads, target wait: {}ms",
+                 adaptive.min_threads, adaptive.max_threads,
+                 adaptive.target_wait_ms);
+      }
+      LOG_INFO("Admission mode: {}, max queue depth: {}, max queue latency: "
+               "{}ms",
+               static_cast<int>(admission_.mode), admission_.max_queue_depth,
+               admission_.max_queue_latency_ms);
     }
   }
   Logger::get_instance()->flush();
 }
 
 WebServer::~WebServer() {
+  LogLaneStats_("static", *threadpool_);
+  LogLaneStats_("db", dbExecutor_->pool());
+  /* 先停线程池：静态通道的任务可能还在提交数据库请求、读取两个处理函数，
+   * 工作线程全部退出后再清空，避免与正在处理 /metrics 的线程竞争 */
+  threadpool_.reset();
+  dbExecutor_.reset();
+  HTTPConn::metricsHandler = nullptr;
+  HTTPConn::traceHandler = nullptr;
+  auto bufStats = BufferPool::Instance().GetStats();
+  LOG_INFO("BufferPool in use: {}B / allocated: {}B, blocks in use 4K: {}/{}, "
+           "16K: {}/{}, 64K: {}/{}, oversize: {}",
+           bufStats.bytes_in_use(), bufStats.bytes_allocated(),
+           bufStats.in_use[0], bufStats.allocated[0], bufStats.in_use[1],
+           bufStats.allocated[1], bufStats.in_use[2], bufStats.allocated[2],
+           bufStats.oversize_in_use);
+  for (size_t shard = 0; shard < Database::SQLite::shard_count(); ++shard) {
+    auto *sql = Database::SQLite::shard(shard);
+    auto readStats = sql->read_stats();
+    LOG_INFO("SQLite[{}] reads thread-local: {} ({} connections), pooled: "
+             "{}, pool waits: {} (avg {}us, max {}us), pool lock contended: "
+             "{}",
+             shard, readStats.thread_reads, readStats.thread_connections,
+             readStats.pool_reads, readStats.pool_waits,
+             readStats.pool_waits
+                 ? readStats.pool_wait_ns / readStats.pool_waits / 1000
+                 : 0,
+             readStats.pool_max_wait_ns / 1000, readStats.pool_lock_contended);
+    auto ckpt = sql->checkpoint_stats();
+    LOG_INFO("SQLite[{}] checkpoints: {} (restart: {}, incomplete: {}), avg "
+             "{}us, max {}us, WAL pages: {} (max {}, page size {}B)",
+             shard, ckpt.checkpoints, ckpt.restarts, ckpt.busy,
+             ckpt.checkpoints ? ckpt.total_ns / ckpt.checkpoints / 1000 : 0,
+             ckpt.max_ns / 1000, ckpt.wal_pages, ckpt.max_wal_pages,
+             ckpt.page_size);
+  }
+  auto userStats = Database::UserCache::get_instance()->stats();
+  LOG_INFO("User cache hits: {}, misses: {}, evictions: {}, size: {}",
+           userStats.hits, userStats.misses, userStats.evictions,
+           userStats.size);
+  LOG_INFO("User filter skipped queries: {}, false positives: {} ({:.4f}, "
+           "estimated {:.4f}), items: {}, bits: {}, rebuilds: {}",
+           userStats.filter_negatives, userStats.filter_false_positives,
+           userStats.filter_fp_rate(), userStats.filter_estimated_fp_rate,
+           userStats.filter_items, userStats.filter_bits,
+           userStats.filter_rebuilds);
+  /* 两者是不同编译单元里的静态对象，析构顺序不确定：
+   * 缓存要在各分片之前撤下提交监听 */
+  Database::UserCache::shutdown();
+  Database::SQLite::shutdown();
+  Logger::report_suppressed(true);
+  if (AccessLog *access = AccessLog::get_instance()) {
+    access->flush();
+    LOG_INFO("Access log written: {}, dropped: {}", access->written(),
+             access->dropped());
+  }
+  LOG_INFO("Logger dropped/overwritten entries: {}",
+           Logger::get_instance()->dropped());
   close(listenFd_);
   isClose_ = true;
   free(srcDir_);
@@ -84,10 +251,20 @@ void WebServer::Start() {
   if (!isClose_) {
     LOG_INFO("========== Server start ==========");
   }
+  Trace::name_thread("event loop");
   while (!isClose_) {
     if (timeoutMS_ > 0) {
       timeMS = timer_->GetNextTick();
     }
+    if (acceptPaused_ && (timeMS < 0 || timeMS > ACCEPT_RETRY_MS)) {
+      /* 暂停 accept 期间需要定期检查负载以便恢复 */
+      timeMS = ACCEPT_RETRY_MS;
+    }
+    /* 有被限流的日志时按时醒来输出汇总 */
+    int reportMS = Logger::suppressed_report_due_ms();
+    if (reportMS >= 0 && (timeMS < 0 || timeMS > reportMS)) {
+      timeMS = reportMS;
+    }
     int eventCnt = epoller_->wait(timeMS);
     for (int i = 0; i < eventCnt; i++) {
       /* 处理事件 */
@@ -95,6 +272,9 @@ void WebServer::Start() {
       uint32_t fd = data.fd;
       if (fd == listenFd_) {
         DealListen_();
+      } else if (fd == static_cast<uint32_t>(dbExecutor_->event_fd())) {
+        /* 数据库结果回到主线程 */
+        dbExecutor_->drain();
       } else if (events & (EPOLLRDHUP | EPOLLHUP | EPOLLERR)) {
         assert(users_.count(fd) > 0);
         CloseConn_(&users_[fd]);
@@ -108,6 +288,11 @@ void WebServer::Start() {
         LOG_ERROR("Unexpected event");
       }
     }
+    if (acceptPaused_) {
+      ResumeAccept_();
+    }
+    timerCount_.store(timer_->size(), std::memory_order_relaxed);
+    Logger::report_suppressed();
   }
 }
 
@@ -122,7 +307,10 @@ void WebServer::SendError_(int fd, const char *info) {
 
 void WebServer::CloseConn_(HTTPConn *client) {
   assert(client);
-  LOG_INFO("Client[{}] quit!", client->get_fd());
+  LOG_SAMPLED(LOG_LEVEL_INFO, HTTPConn::CONN_LOG_SAMPLE, "Client[{}] quit!",
+              client->get_fd());
+  /* 响应未发送完连接就关闭（出错、超时、对端断开），记为中断的请求 */
+  client->finish_request(true);
   epoller_->erase(client->get_fd());
   client->close();
 }
@@ -136,37 +324,147 @@ void WebServer::AddClient_(int fd, sockaddr_in addr) {
   }
   epoller_->insert(fd, EPOLLIN | connEvent_);
   SetFdNonblock(fd);
-  LOG_INFO("Client[{}] in!", users_[fd].get_fd());
+  LOG_SAMPLED(LOG_LEVEL_INFO, HTTPConn::CONN_LOG_SAMPLE, "Client[{}] in!",
+              users_[fd].get_fd());
 }
 
 void WebServer::DealListen_() {
   struct sockaddr_in addr;
   socklen_t len = sizeof(addr);
   do {
+    const auto start = std::chrono::steady_clock::now();
+    if (admission_.mode == AdmissionMode::PauseAccept &&
+        IsOverloaded_(*threadpool_)) {
+      /* 连接留在内核 backlog 中，待线程池消化后再接收 */
+      PauseAccept_();
+      return;
+    }
     int fd = accept(listenFd_, (struct sockaddr *)&addr, &len);
     if (fd <= 0) {
       return;
-    } else if (HTTPConn::userCount >= MAX_FD) {
+    } else if (HTTPConn::UserCount() >= MAX_FD) {
       SendError_(fd, "Server busy!");
       LOG_WARN("Clients is full!");
       return;
+    } else if (admission_.mode == AdmissionMode::Shed &&
+               IsOverloaded_(*threadpool_)) {
+      shedConns_++;
+      SendError_(fd, busyResponse_.c_str());
+      continue;
     }
     AddClient_(fd, addr);
+    Metrics::add(MetricCounter::Accepted);
+    Metrics::observe(MetricStage::Accept,
+                     std::chrono::duration_cast<std::chrono::nanoseconds>(
+                         std::chrono::steady_clock::now() - start)
+                         .count());
   } while (listenEvent_ & EPOLLET);
 }
 
 void WebServer::DealRead_(HTTPConn *client) {
   assert(client);
+  if (admission_.mode == AdmissionMode::Shed && IsOverloaded_(*threadpool_)) {
+    ShedConn_(client);
+    return;
+  }
   ExtentTime_(client);
+  client->mark_ready();
   threadpool_->enqueue(&WebServer::OnRead_, this, client);
 }
 
 void WebServer::DealWrite_(HTTPConn *client) {
   assert(client);
   ExtentTime_(client);
+  client->mark_writable();
   threadpool_->enqueue(&WebServer::OnWrite_, this, client);
 }
 
+bool WebServer::IsOverloaded_(const ThreadPool &pool) const {
+  return pool.queue_depth() >= admission_.max_queue_depth ||
+         pool.queue_latency() >=
+             std::chrono::milliseconds(admission_.max_queue_latency_ms);
+}
+
+void WebServer::LogLaneStats_(const char *lane, const ThreadPool &pool) {
+  uint64_t n = pool.tasks_dequeued();
+  LOG_INFO("Lane[{}] threads: {}, resizes: {}, tasks: {}, avg queue time: "
+           "{}us, queue latency: {}us",
+           lane, pool.thread_count(), pool.resize_count(), n,
+           n ? pool.total_queue_wait().count() / n : 0,
+           pool.queue_latency().count());
+}
+
+void WebServer::WriteMetrics_(std::string &out) const {
+  Metrics::write_prometheus(out);
+  /* 以下为抓取时采样的瞬时值 */
+  const ThreadPool *lanes[] = {threadpool_.get(), &dbExecutor_->pool()};
+  const char *laneLabels[] = {"lane=\"static\"", "lane=\"db\""};
+  for (int i = 0; i < 2; ++i) {
+    Metrics::write_gauge(out, "webserver_thread_pool_queue_depth",
+                         i == 0 ? "Tasks waiting in the thread pool" : "",
+                         lanes[i]->queue_depth(), laneLabels[i]);
+  }
+  for (int i = 0; i < 2; ++i) {
+    Metrics::write_gauge(out, "webserver_thread_pool_threads",
+                         i == 0 ? "Live thread pool workers" : "",
+                         lanes[i]->thread_count(), laneLabels[i]);
+  }
+  Metrics::write_gauge(out, "webserver_timers", "Pending connection timers",
+                       timerCount_.load(std::memory_order_relaxed));
+  auto bufStats = BufferPool::Instance().GetStats();
+  Metrics::write_gauge(out, "webserver_buffer_pool_bytes",
+                       "Buffer pool memory by state", bufStats.bytes_in_use(),
+                       "state=\"in_use\"");
+  Metrics::write_gauge(out, "webserver_buffer_pool_bytes", "",
+                       bufStats.bytes_allocated(), "state=\"allocated\"");
+  Logger *logger = Logger::get_instance();
+  Metrics::write_gauge(out, "webserver_logger_queue_depth",
+                       "Log entries waiting for the writer thread",
+                       logger->queue_size());
+  Metrics::write_gauge(out, "webserver_logger_dropped",
+                       "Log entries dropped or overwritten so far",
+                       logger->dropped());
+  if (AccessLog *access = AccessLog::get_instance()) {
+    Metrics::write_gauge(out, "webserver_access_log_dropped",
+                         "Access log records dropped so far",
+                         access->dropped());
+  }
+}
+
+void WebServer::ShedConn_(HTTPConn *client) {
+  assert(client);
+  shedRequests_++;
+  /* 不读取、不解析请求，直接回复 503 并关闭，尽量少占用资源 */
+  send(client->get_fd(), busyResponse_.data(), busyResponse_.size(),
+       MSG_DONTWAIT | MSG_NOSIGNAL);
+  CloseConn_(client);
+}
+
+void WebServer::PauseAccept_() {
+  if (acceptPaused_) {
+    return;
+  }
+  acceptPaused_ = true;
+  acceptPauses_++;
+  epoller_->erase(listenFd_);
+  LOG_WARN("Overloaded (queue depth: {}, queue latency: {}us), pause accept",
+           threadpool_->queue_depth(), threadpool_->queue_latency().count());
+}
+
+void WebServer::ResumeAccept_() {
+  /* 负载降到阈值一半以下才恢复，避免在阈值附近反复切换 */
+  if (threadpool_->queue_depth() >= admission_.max_queue_depth / 2 ||
+      threadpool_->queue_latency() >=
+          std::chrono::milliseconds(admission_.max_queue_latency_ms / 2)) {
+    return;
+  }
+  acceptPaused_ = false;
+  epoller_->insert(listenFd_, listenEvent_ | EPOLLIN);
+  LOG_INFO("Load recovered, resume accept (shed requests: {}, shed "
+           "connections: {}, pauses: {})",
+           shedRequests_.load(), shedConns_.load(), acceptPauses_.load());
+}
+
 void WebServer::ExtentTime_(HTTPConn *client) {
   assert(client);
   if (timeoutMS_ > 0) {
@@ -176,6 +474,7 @@ void WebServer::ExtentTime_(HTTPConn *client) {
 
 void WebServer::OnRead_(HTTPConn *client) {
   assert(client);
+  Trace::name_thread("static");
   int ret = -1;
   int readErrno = 0;
   ret = client->read(&readErrno);
@@ -183,24 +482,74 @@ void WebServer::OnRead_(HTTPConn *client) {
     CloseConn_(client);
     return;
   }
+  if (client->needs_database() && admission_.mode == AdmissionMode::Shed &&
+      IsOverloaded_(dbExecutor_->pool())) {
+    ShedConn_(client);
+    return;
+  }
   OnProcess(client);
 }
 
 void WebServer::OnProcess(HTTPConn *client) {
   if (client->process()) {
+    if (client->database_pending()) {
+      /* 登录/注册：交给数据库线程，结果到达前连接不注册任何事件 */
+      StartVerify_(client);
+      return;
+    }
     epoller_->update(client->get_fd(), connEvent_ | EPOLLOUT);
   } else {
+    /* 必须在重新注册 EPOLLIN 之前回收，之后连接可能已被其他线程接手 */
+    if (HTTPConn::reclaimIdle) {
+      client->reclaim();
+    }
     epoller_->update(client->get_fd(), connEvent_ | EPOLLIN);
   }
 }
 
+void WebServer::StartVerify_(HTTPConn *client) {
+  const uint64_t gen = client->generation();
+  dbExecutor_->submit(
+      [job = client->verify_job(), trace = client->trace_id()] {
+        Trace::name_thread("db");
+        Trace::mark(trace, TracePoint::DbStart);
+        const uint64_t waited = Database::SQLite::thread_pool_wait_ns();
+        const bool ok =
+            HTTPRequest::UserVerify(job.name, job.pwd, job.isLogin);
+        /* 附上取只读连接时的等待 */
+        Trace::mark(trace, TracePoint::DbEnd,
+                    static_cast<int32_t>(
+                        (Database::SQLite::thread_pool_wait_ns() - waited) /
+                        1000));
+        return ok;
+      },
+      [this, client, gen](bool ok) {
+        /* 等待期间连接已关闭（超时、出错）或 fd 已被新连接复用 */
+        if (client->generation() != gen) {
+          return;
+        }
+        threadpool_->enqueue(&WebServer::OnVerified_, this, client, gen, ok);
+      });
+}
+
+void WebServer::OnVerified_(HTTPConn *client, uint64_t gen, bool ok) {
+  Trace::name_thread("static");
+  if (client->generation() != gen) {
+    return;
+  }
+  client->finish_database(ok);
+  epoller_->update(client->get_fd(), connEvent_ | EPOLLOUT);
+}
+
 void WebServer::OnWrite_(HTTPConn *client) {
   assert(client);
+  Trace::name_thread("static");
   int ret = -1;
   int writeErrno = 0;
   ret = client->write(&writeErrno);
   if (client->to_write_bytes() == 0) {
     /* 传输完成 */
+    client->finish_request(false);
     if (client->is_keep_alive()) {
       OnProcess(client);
       return;
@@ -2,17 +2,21 @@
 #define TCP_SERVER_HPP_
 
 #include "HTTPConn.hpp"
+#include "config.hpp"
 #include "epoller.hpp"
 #include "heaptimer.hpp"
 #include "thread_pool.hpp"
+
+namespace Database {
+class AsyncExecutor;
+}
 #include <bits/stdc++.h>
 
 namespace Web {
 class WebServer {
 public:
-  WebServer(int port, int trigMode, int timeoutMS, bool OptLinger,
-            const char *dbName, int connPoolNum, int threadNum, bool closelog,
-            int logQueSize);
+  // 运行参数取自解析好的命令行配置
+  WebServer(const Config &config, int timeoutMS, const char *dbName);
 
   ~WebServer();
   void Start();
@@ -33,8 +37,18 @@ private:
   void OnRead_(HTTPConn *client);
   void OnWrite_(HTTPConn *client);
   void OnProcess(HTTPConn *client);
+  void StartVerify_(HTTPConn *client);
+  void OnVerified_(HTTPConn *client, uint64_t gen, bool ok);
+
+  bool IsOverloaded_(const ThreadPool &pool) const;
+  void ShedConn_(HTTPConn *client);
+  void LogLaneStats_(const char *lane, const ThreadPool &pool);
+  void WriteMetrics_(std::string &out) const;
+  void PauseAccept_();
+  void ResumeAccept_();
 
   static const int MAX_FD = 65536;
+  static const int ACCEPT_RETRY_MS = 10;
 
   static int SetFdNonblock(int fd);
 
@@ -49,9 +63,20 @@ private:
   uint32_t connEvent_;
 
   std::unique_ptr<HeapTimer> timer_;
-  std::unique_ptr<ThreadPool> threadpool_;
+  std::unique_ptr<ThreadPool> threadpool_; /* 静态资源通道 */
+  /* 数据库通道：专用线程执行查询，结果经 eventfd 回到主循环 */
+  std::unique_ptr<Database::AsyncExecutor> dbExecutor_;
   std::unique_ptr<Epoller> epoller_;
   std::unordered_map<int, HTTPConn> users_;
+
+  AdmissionPolicy admission_;
+  std::string busyResponse_; /* 预先渲染的 503 */
+  bool acceptPaused_;
+  std::atomic<uint64_t> shedRequests_;
+  std::atomic<uint64_t> shedConns_;
+  std::atomic<uint64_t> acceptPauses_;
+  /* 定时器只在主线程访问，每轮事件循环后把数量记在这里供 /metrics 读取 */
+  std::atomic<size_t> timerCount_;
 };
 
 } // namespace Web
@@ -4,44 +4,239 @@
 #include <type_traits>
 class ThreadPool {
 public:
+  using Clock = std::chrono::steady_clock;
+
+  // 自适应模式：排队时延持续超过 target_wait 时扩容，持续空闲时缩容
+  struct Adaptive {
+    size_t min_threads = 1;
+    size_t max_threads = 1;
+    std::chrono::milliseconds target_wait{20};
+    // controller sampling period
+    std::chrono::milliseconds interval{100};
+    // consecutive samples needed before acting; shrinking is deliberately
+    // much slower than growing so a short lull does not undo a burst resize
+    int grow_after = 3;
+    int shrink_after = 50;
+  };
+  // called from the controller thread after every resize
+  using ResizeCallback =
+      std::function<void(size_t from, size_t to, std::string_view reason)>;
+
   ThreadPool(size_t);
+  ThreadPool(size_t threads, const Adaptive &adaptive,
+             ResizeCallback on_resize = {});
   template <class F, class... Args>
   auto enqueue(F &&f, Args &&...args)
       -> std::future<typename std::invoke_result<F, Args...>::type>;
   ~ThreadPool();
 
+  // tasks waiting for a worker
+  size_t queue_depth() const { return depth_.load(std::memory_order_relaxed); }
+  // smoothed queueing delay, or the age of the oldest waiting task if that
+  // is larger (so a stalled pool is noticed before anything is dequeued).
+  // While the queue is empty the average halves every IDLE_HALF_LIFE, so
+  // callers that stop enqueueing because the latency is high (load
+  // shedding) still see it fall once the pool has drained
+  std::chrono::microseconds queue_latency() const;
+  static constexpr std::chrono::milliseconds IDLE_HALF_LIFE{20};
+  // tasks picked up by a worker so far, and the time they spent queued
+  uint64_t tasks_dequeued() const {
+    return dequeued_.load(std::memory_order_relaxed);
+  }
+  std::chrono::microseconds total_queue_wait() const {
+    return std::chrono::microseconds(
+        total_wait_us_.load(std::memory_order_relaxed));
+  }
+  // live workers, including ones currently idle
+  size_t thread_count() const { return live_.load(std::memory_order_relaxed); }
+  uint64_t resize_count() const {
+    return resizes_.load(std::memory_order_relaxed);
+  }
+
 private:
+  struct Task {
+    std::function<void()> fn;
+    Clock::time_point enqueued;
+  };
+
+  void spawn_worker_();
+  void worker_loop_();
+  void control_loop_();
+  void reap_workers_();
+  void record_wait_(Clock::time_point enqueued, Clock::time_point now);
+  int64_t idle_decayed_(int64_t ewma_us, Clock::time_point now) const;
+
   // need to keep track of threads so we can join them
   std::vector<std::thread> workers;
   // the task queue
-  std::queue<std::function<void()>> tasks;
+  std::queue<Task> tasks;
 
   // synchronization
   std::mutex queue_mutex;
   std::condition_variable condition;
   bool stop;
+
+  // queue statistics, readable without taking queue_mutex
+  std::atomic<size_t> depth_{0};
+  std::atomic<int64_t> wait_ewma_us_{0};
+  std::atomic<int64_t> oldest_enqueued_ns_{0}; // 0 when the queue is empty
+  std::atomic<int64_t> idle_since_ns_{0};      // when the queue last emptied
+  std::atomic<uint64_t> dequeued_{0};
+  std::atomic<int64_t> total_wait_us_{0};
+
+  // adaptive sizing; workers and retired_ are guarded by queue_mutex
+  std::optional<Adaptive> adaptive_;
+  ResizeCallback on_resize_;
+  std::thread controller_;
+  std::condition_variable controller_cv_;
+  std::atomic<size_t> live_{0};
+  size_t idle_ = 0;
+  size_t retire_ = 0; // workers asked to exit
+  std::vector<std::thread::id> retired_;
+  std::atomic<uint64_t> resizes_{0};
 };
 
 // the constructor just launches some amount of workers
 inline ThreadPool::ThreadPool(size_t threads) : stop(false) {
+  std::unique_lock<std::mutex> lock(queue_mutex);
   for (size_t i = 0; i < threads; ++i)
-    workers.emplace_back([this] {
-      for (;;) {
-        std::function<void()> task;
-
-        {
-          std::unique_lock<std::mutex> lock(this->queue_mutex);
-          this->condition.wait(
-              lock, [this] { return this->stop || !this->tasks.empty(); });
-          if (this->stop && this->tasks.empty())
-            return;
-          task = std::move(this->tasks.front());
-          this->tasks.pop();
-        }
-
-        task();
+    spawn_worker_();
+}
+
+inline ThreadPool::ThreadPool(size_t threads, const Adaptive &adaptive,
+                              ResizeCallback on_resize)
+    : stop(false), adaptive_(adaptive), on_resize_(std::move(on_resize)) {
+  adaptive_->min_threads = std::max<size_t>(1, adaptive_->min_threads);
+  adaptive_->max_threads =
+      std::max(adaptive_->min_threads, adaptive_->max_threads);
+  threads =
+      std::clamp(threads, adaptive_->min_threads, adaptive_->max_threads);
+  {
+    std::unique_lock<std::mutex> lock(queue_mutex);
+    for (size_t i = 0; i < threads; ++i)
+      spawn_worker_();
+  }
+  controller_ = std::thread([this] { control_loop_(); });
+}
+
+// caller holds queue_mutex
+inline void ThreadPool::spawn_worker_() {
+  live_.fetch_add(1, std::memory_order_relaxed);
+  workers.emplace_back([this] { worker_loop_(); });
+}
+
+inline void ThreadPool::worker_loop_() {
+  for (;;) {
+    Task task;
+    Clock::time_point now;
+
+    {
+      std::unique_lock<std::mutex> lock(this->queue_mutex);
+      ++idle_;
+      this->condition.wait(lock, [this] {
+        return this->stop || !this->tasks.empty() || retire_ > 0;
+      });
+      --idle_;
+      if (this->stop && this->tasks.empty())
+        return;
+      if (retire_ > 0 && this->tasks.empty()) {
+        --retire_;
+        live_.fetch_sub(1, std::memory_order_relaxed);
+        retired_.push_back(std::this_thread::get_id());
+        return;
+      }
+      task = std::move(this->tasks.front());
+      this->tasks.pop();
+      now = Clock::now();
+      this->depth_.store(this->tasks.size(), std::memory_order_relaxed);
+      if (this->tasks.empty()) {
+        this->oldest_enqueued_ns_.store(0, std::memory_order_relaxed);
+        this->idle_since_ns_.store(now.time_since_epoch().count(),
+                                   std::memory_order_relaxed);
+      } else {
+        this->oldest_enqueued_ns_.store(
+            this->tasks.front().enqueued.time_since_epoch().count(),
+            std::memory_order_relaxed);
+      }
+    }
+
+    record_wait_(task.enqueued, now);
+    task.fn();
+  }
+}
+
+inline void ThreadPool::control_loop_() {
+  const Adaptive &opt = *adaptive_;
+  const auto target = std::chrono::duration_cast<std::chrono::microseconds>(
+      opt.target_wait);
+  int hot = 0, cold = 0;
+  std::unique_lock<std::mutex> lock(queue_mutex);
+  while (!stop) {
+    controller_cv_.wait_for(lock, opt.interval, [this] { return stop; });
+    if (stop)
+      break;
+    lock.unlock();
+    reap_workers_();
+    lock.lock();
+
+    const size_t live = live_.load(std::memory_order_relaxed) - retire_;
+    const auto latency = queue_latency();
+
+    if (!tasks.empty() && latency > target && live < opt.max_threads) {
+      cold = 0;
+      if (++hot < opt.grow_after)
+        continue;
+      hot = 0;
+      // grow by a quarter so a 10x swing is absorbed in a few steps
+      size_t to =
+          std::min(opt.max_threads, live + std::max<size_t>(1, live / 4));
+      for (size_t i = live; i < to; ++i)
+        spawn_worker_();
+      resizes_.fetch_add(1, std::memory_order_relaxed);
+      if (on_resize_) {
+        lock.unlock();
+        on_resize_(live, to, "queue wait above target");
+        lock.lock();
+      }
+    } else if (tasks.empty() && idle_ > retire_ && latency < target / 2 &&
+               live > opt.min_threads) {
+      hot = 0;
+      if (++cold < opt.shrink_after)
+        continue;
+      cold = 0;
+      ++retire_;
+      condition.notify_one();
+      resizes_.fetch_add(1, std::memory_order_relaxed);
+      if (on_resize_) {
+        lock.unlock();
+        on_resize_(live, live - 1, "workers idle");
+        lock.lock();
+      }
+    } else {
+      hot = cold = 0;
+    }
+  }
+}
+
+// join workers that retired themselves
+inline void ThreadPool::reap_workers_() {
+  std::vector<std::thread> done;
+  {
+    std::unique_lock<std::mutex> lock(queue_mutex);
+    for (auto id : retired_) {
+      auto it = std::find_if(workers.begin(), workers.end(),
+                             [id](const std::thread &t) {
+                               return t.get_id() == id;
+                             });
+      if (it != workers.end()) {
+        done.push_back(std::move(*it));
+        workers.erase(it);
       }
-    });
+    }
+    retired_.clear();
+  }
+  for (std::thread &t : done)
+    t.join();
 }
 
 // add new work item to the pool
@@ -60,12 +255,58 @@ auto ThreadPool::enqueue(F &&f, Args &&...args)
     if (stop)
       throw std::runtime_error("enqueue on stopped ThreadPool");
 
-    tasks.emplace([task]() { (*task)(); });
+    auto now = Clock::now();
+    if (tasks.empty()) {
+      // start the next busy period from the decayed average, not from the
+      // value the last one ended with
+      wait_ewma_us_.store(
+          idle_decayed_(wait_ewma_us_.load(std::memory_order_relaxed), now),
+          std::memory_order_relaxed);
+      oldest_enqueued_ns_.store(now.time_since_epoch().count(),
+                                std::memory_order_relaxed);
+    }
+    tasks.push({[task]() { (*task)(); }, now});
+    depth_.store(tasks.size(), std::memory_order_relaxed);
   }
   condition.notify_one();
   return res;
 }
 
+// exponentially weighted moving average, alpha = 1/8
+inline void ThreadPool::record_wait_(Clock::time_point enqueued,
+                                     Clock::time_point now) {
+  int64_t sample =
+      std::chrono::duration_cast<std::chrono::microseconds>(now - enqueued)
+          .count();
+  dequeued_.fetch_add(1, std::memory_order_relaxed);
+  total_wait_us_.fetch_add(sample, std::memory_order_relaxed);
+  int64_t prev = wait_ewma_us_.load(std::memory_order_relaxed);
+  wait_ewma_us_.store(prev + (sample - prev) / 8, std::memory_order_relaxed);
+}
+
+inline int64_t ThreadPool::idle_decayed_(int64_t ewma_us,
+                                         Clock::time_point now) const {
+  auto idle = now - Clock::time_point(Clock::duration(
+                        idle_since_ns_.load(std::memory_order_relaxed)));
+  auto halvings = idle / IDLE_HALF_LIFE;
+  return halvings >= 63 ? 0 : ewma_us >> std::max<int64_t>(halvings, 0);
+}
+
+inline std::chrono::microseconds ThreadPool::queue_latency() const {
+  int64_t ewma = wait_ewma_us_.load(std::memory_order_relaxed);
+  int64_t oldest = oldest_enqueued_ns_.load(std::memory_order_relaxed);
+  auto now = Clock::now();
+  if (oldest != 0) {
+    auto age = now - Clock::time_point(Clock::duration(oldest));
+    ewma = std::max<int64_t>(
+        ewma,
+        std::chrono::duration_cast<std::chrono::microseconds>(age).count());
+  } else {
+    ewma = idle_decayed_(ewma, now);
+  }
+  return std::chrono::microseconds(ewma);
+}
+
 // the destructor joins all threads
 inline ThreadPool::~ThreadPool() {
   {
@@ -73,8 +314,11 @@ inline ThreadPool::~ThreadPool() {
     stop = true;
   }
   condition.notify_all();
+  controller_cv_.notify_all();
+  if (controller_.joinable())
+    controller_.join();
   for (std::thread &worker : workers)
     worker.join();
 }
 
-#endif
\ No newline at end of file
+#endif
@@ -7,12 +7,12 @@
 
 void HeapTimer::siftup_(size_t i) {
     assert(i >= 0 && i < heap_.size());
-    size_t j = (i - 1) / 2;
-    while(j >= 0) {
+    /* size_t 下 (0 - 1) / 2 会回绕，到堆顶即停 */
+    while(i > 0) {
+        size_t j = (i - 1) / 2;
         if(heap_[j] < heap_[i]) { break; }
         SwapNode_(i, j);
         i = j;
-        j = (i - 1) / 2;
     }
 }
 
@@ -0,0 +1,234 @@
+#include "trace.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <format>
+#include <iterator>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+std::array<std::atomic<Trace::Ring *>, Trace::MAX_RINGS> Trace::rings_{};
+std::atomic<size_t> Trace::ringCount_{0};
+std::mutex Trace::ringMutex_;
+Trace::Ring Trace::overflow_;
+
+namespace {
+// 以该时间点结束的一段
+const char *SpanNames[] = {
+    "accept",        // Accept：请求的第一个点，没有之前的段
+    "wait_data",     // 连接建立（或上次读到半个请求）到数据可读
+    "pool_queue",    // 在静态资源线程池中排队
+    "read",          // 读 socket
+    "parse",         // 解析
+    "db_queue",      // 在数据库通道排队
+    "db",            // 用户缓存、取只读连接与查询
+    "db_return",     // eventfd 回到主循环，再排队进线程池
+    "build",         // 打开文件、生成响应头
+    "wait_writable", // 等待 socket 可写
+    "write_queue",   // 写任务在线程池排队与第一次 writev
+    "write",         // 剩余数据发完
+};
+static_assert(std::size(SpanNames) == static_cast<size_t>(TracePoint::COUNT));
+
+const char *ValueNames[] = {
+    "fd",           nullptr,  nullptr, nullptr, nullptr, nullptr,
+    "pool_wait_us", nullptr,  nullptr, nullptr, nullptr, "status",
+};
+static_assert(std::size(ValueNames) == static_cast<size_t>(TracePoint::COUNT));
+
+// s[i] 起一个完整合法的 UTF-8 多字节序列的长度，不合法返回 0
+// （拒绝过长编码、代理区与超出 U+10FFFF 的码点）
+size_t utf8_sequence(std::string_view s, size_t i) {
+  const auto b = [&](size_t k) { return static_cast<unsigned char>(s[k]); };
+  const unsigned char c = b(i);
+  size_t len;
+  unsigned char lo = 0x80, hi = 0xbf; // 第二个字节的范围
+  if (c >= 0xc2 && c <= 0xdf) {
+    len = 2;
+  } else if (c >= 0xe0 && c <= 0xef) {
+    len = 3;
+    lo = c == 0xe0 ? 0xa0 : 0x80;
+    hi = c == 0xed ? 0x9f : 0xbf;
+  } else if (c >= 0xf0 && c <= 0xf4) {
+    len = 4;
+    lo = c == 0xf0 ? 0x90 : 0x80;
+    hi = c == 0xf4 ? 0x8f : 0xbf;
+  } else {
+    return 0;
+  }
+  if (i + len > s.size() || b(i + 1) < lo || b(i + 1) > hi) {
+    return 0;
+  }
+  for (size_t k = i + 2; k < i + len; ++k) {
+    if ((b(k) & 0xc0) != 0x80) {
+      return 0;
+    }
+  }
+  return len;
+}
+
+// JSON 字符串转义，请求行来自客户端：不是合法 UTF-8 的字节换成 U+FFFD，
+// 否则整个 trace 文件都无法解析
+void append_escaped(std::string &out, std::string_view s) {
+  for (size_t i = 0; i < s.size(); ++i) {
+    const char c = s[i];
+    if (c == '"' || c == '\\') {
+      out += '\\';
+      out += c;
+    } else if (static_cast<unsigned char>(c) < 0x20) {
+      std::format_to(std::back_inserter(out), "\\u{:04x}", c);
+    } else if (static_cast<unsigned char>(c) < 0x80) {
+      out += c;
+    } else if (size_t len = utf8_sequence(s, i)) {
+      out.append(s.substr(i, len));
+      i += len - 1;
+    } else {
+      out += "\\ufffd";
+    }
+  }
+}
+} // namespace
+
+int64_t Trace::now_ns() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+const char *Trace::span_name(TracePoint p) {
+  return SpanNames[static_cast<size_t>(p)];
+}
+
+const char *Trace::value_name(TracePoint p) {
+  return ValueNames[static_cast<size_t>(p)];
+}
+
+void Trace::record_(uint64_t id, TracePoint point, int64_t ts_ns,
+                    int32_t value, std::string_view text) {
+  thread_local const int32_t tid = static_cast<int32_t>(syscall(SYS_gettid));
+  Ring &ring = local_ring_();
+  std::lock_guard<std::mutex> lk(ring.mutex);
+  TraceEvent &ev = ring.events[ring.head++ % RING_EVENTS];
+  ev.id = id;
+  ev.ts_ns = ts_ns;
+  ev.thread = threadName_;
+  ev.tid = tid;
+  ev.value = value;
+  ev.point = point;
+  const size_t len = std::min(text.size(), sizeof(ev.text) - 1);
+  std::memcpy(ev.text, text.data(), len);
+  ev.text[len] = '\0';
+}
+
+Trace::Ring &Trace::local_ring_() {
+  // 线程退出时交还环，已记录的事件保留到被新线程覆盖
+  struct Lease {
+    Ring *ring = nullptr;
+    ~Lease() {
+      if (ring && ring != &overflow_) {
+        ring->in_use.store(false, std::memory_order_release);
+      }
+    }
+  };
+  thread_local Lease lease;
+  if (!lease.ring) [[unlikely]] {
+    lease.ring = acquire_ring_();
+  }
+  return *lease.ring;
+}
+
+Trace::Ring *Trace::acquire_ring_() {
+  std::lock_guard<std::mutex> lk(ringMutex_);
+  const size_t n = ringCount_.load(std::memory_order_relaxed);
+  for (size_t i = 0; i < n; ++i) {
+    Ring *r = rings_[i].load(std::memory_order_relaxed);
+    if (!r->in_use.load(std::memory_order_acquire)) {
+      r->in_use.store(true, std::memory_order_relaxed);
+      return r;
+    }
+  }
+  if (n == MAX_RINGS) {
+    return &overflow_;
+  }
+  // 环从不释放：只有打过点的线程才会申请（约 300KB）
+  Ring *r = new Ring;
+  r->in_use.store(true, std::memory_order_relaxed);
+  rings_[n].store(r, std::memory_order_release);
+  ringCount_.store(n + 1, std::memory_order_release);
+  return r;
+}
+
+std::vector<TraceEvent> Trace::collect() {
+  std::vector<TraceEvent> events;
+  auto copy = [&](Ring &ring) {
+    std::lock_guard<std::mutex> lk(ring.mutex);
+    const uint64_t n = std::min<uint64_t>(ring.head, RING_EVENTS);
+    for (uint64_t i = ring.head - n; i < ring.head; ++i) {
+      events.push_back(ring.events[i % RING_EVENTS]);
+    }
+  };
+  copy(overflow_);
+  const size_t n = ringCount_.load(std::memory_order_acquire);
+  for (size_t i = 0; i < n; ++i) {
+    copy(*rings_[i].load(std::memory_order_acquire));
+  }
+  std::stable_sort(events.begin(), events.end(),
+                   [](const TraceEvent &a, const TraceEvent &b) {
+                     return a.id != b.id ? a.id < b.id : a.ts_ns < b.ts_ns;
+                   });
+  return events;
+}
+
+void Trace::write_chrome_json(std::string &out) {
+  const std::vector<TraceEvent> events = collect();
+  int64_t origin = INT64_MAX;
+  for (const TraceEvent &ev : events) {
+    origin = std::min(origin, ev.ts_ns);
+  }
+  auto us = [origin](int64_t ns) {
+    return static_cast<double>(ns - origin) / 1000;
+  };
+  auto it = std::back_inserter(out);
+  out += "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+  out += "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,"
+         "\"args\":{\"name\":\"requests\"}}";
+  for (size_t i = 0; i < events.size(); ++i) {
+    const TraceEvent &ev = events[i];
+    const bool first = i == 0 || events[i - 1].id != ev.id;
+    if (first) {
+      /* 每个请求一行，以请求行命名（环被覆盖后可能缺失） */
+      std::string_view line;
+      for (size_t j = i; j < events.size() && events[j].id == ev.id; ++j) {
+        if (events[j].point == TracePoint::Parsed) {
+          line = events[j].text;
+          break;
+        }
+      }
+      std::format_to(it,
+                     ",\n{{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,"
+                     "\"tid\":{},\"args\":{{\"name\":\"#{} ",
+                     ev.id, ev.id);
+      append_escaped(out, line.empty() ? "?" : line);
+      out += "\"}}";
+      continue;
+    }
+    const TraceEvent &prev = events[i - 1];
+    std::format_to(it,
+                   ",\n{{\"name\":\"{}\",\"cat\":\"request\",\"ph\":\"X\","
+                   "\"pid\":1,\"tid\":{},\"ts\":{:.3f},\"dur\":{:.3f},"
+                   "\"args\":{{\"thread\":\"{}/{}\"",
+                   span_name(ev.point), ev.id, us(prev.ts_ns),
+                   us(ev.ts_ns) - us(prev.ts_ns),
+                   ev.thread ? ev.thread : "thread", ev.tid);
+    if (const char *name = value_name(ev.point)) {
+      std::format_to(it, ",\"{}\":{}", name, ev.value);
+    }
+    if (ev.text[0] != '\0' && ev.point != TracePoint::Parsed) {
+      out += ",\"note\":\"";
+      append_escaped(out, ev.text);
+      out += '"';
+    }
+    out += "}}";
+  }
+  out += "\n]}\n";
+}
@@ -0,0 +1,126 @@
+#ifndef TRACE_HPP_
+#define TRACE_HPP_
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// 单个请求的追踪：按 1/N 采样的请求在各处打点，事件写入打点线程自己的
+// 环形缓冲区（写满后覆盖最旧的事件）。请求 /trace 时把各线程的事件按请求
+// 汇总成 Chrome trace-event JSON，可用 chrome://tracing 或 Perfetto 打开。
+// 未被采样的请求追踪 id 为 0，每个打点处只多一次判断。
+
+// 请求经过的时间点，相邻两点之间的间隔即为一段 span
+enum class TracePoint : uint8_t {
+  Accept,    // 连接被 accept（只出现在连接的第一个请求上）
+  Readable,  // 主线程分发可读事件
+  Dequeued,  // 线程池取到读任务，开始读 socket
+  Read,      // 读完 socket
+  Parsed,    // 请求解析完毕
+  DbStart,   // 数据库线程开始执行查询
+  DbEnd,     // 查询结束
+  Resumed,   // 查询结果回到线程池
+  Built,     // 响应已生成
+  Writable,  // 主线程分发可写事件
+  FirstByte, // 第一次 writev 成功
+  LastByte,  // 发送完毕，或响应发完前连接已关闭
+  COUNT
+};
+
+struct TraceEvent {
+  uint64_t id = 0;
+  int64_t ts_ns = 0; // steady_clock
+  const char *thread = nullptr;
+  int32_t tid = 0;
+  int32_t value = 0; // 含义随时间点而定，见 Trace::value_name
+  TracePoint point = TracePoint::COUNT;
+  char text[39] = {}; // 附加说明，如请求行；超长截断
+};
+
+class Trace {
+public:
+  // 每 n 个请求追踪一个，0 为关闭
+  static void set_sample(uint32_t n) {
+    sample_.store(n, std::memory_order_relaxed);
+  }
+  static uint32_t sample() { return sample_.load(std::memory_order_relaxed); }
+
+  // 请求开始时调用：被采样时返回新的追踪 id，否则返回 0。
+  // 各线程分别计数，整体比例约为 1/n
+  static uint64_t begin() {
+    const uint32_t n = sample_.load(std::memory_order_relaxed);
+    if (n == 0) {
+      return 0;
+    }
+    thread_local uint32_t seen = 0;
+    if (++seen < n) {
+      return 0;
+    }
+    seen = 0;
+    return nextId_.fetch_add(1, std::memory_order_relaxed);
+  }
+
+  // id 为 0 时什么也不做。mark_at 用调用方已经取到的时间（steady_clock
+  // 纳秒，与各阶段耗时统计共用一次取时），mark 取当前时间
+  static void mark_at(uint64_t id, TracePoint point, int64_t ts_ns,
+                      int32_t value = 0, std::string_view text = {}) {
+    if (id != 0) {
+      record_(id, point, ts_ns, value, text);
+    }
+  }
+  static void mark(uint64_t id, TracePoint point, int32_t value = 0) {
+    if (id != 0) {
+      record_(id, point, now_ns(), value, {});
+    }
+  }
+
+  // 给当前线程命名（如 "static"、"db"），之后的事件带上该名字
+  static void name_thread(const char *name) { threadName_ = name; }
+
+  static int64_t now_ns();
+
+  // 追加 {"traceEvents": [...]}：每个请求一行（tid 为追踪 id），
+  // 相邻时间点之间为一段 complete 事件，参数中注明执行该段的线程
+  static void write_chrome_json(std::string &out);
+
+  // 以某时间点结束的 span 名
+  static const char *span_name(TracePoint p);
+  // value 在该时间点的含义，nullptr 表示不输出
+  static const char *value_name(TracePoint p);
+
+  // 所有线程的事件，按追踪 id、时间排序；测试与导出共用
+  static std::vector<TraceEvent> collect();
+
+  static constexpr size_t RING_EVENTS = 4096;
+  // 同时存在的线程超过此数时，多出的线程共用一个环（加锁，仍然正确）
+  static constexpr size_t MAX_RINGS = 256;
+
+private:
+  struct Ring {
+    std::atomic<bool> in_use{false};
+    std::mutex mutex; // 只有导出时才会与写入方竞争
+    uint64_t head = 0;
+    std::array<TraceEvent, RING_EVENTS> events;
+  };
+
+  static void record_(uint64_t id, TracePoint point, int64_t ts_ns,
+                      int32_t value, std::string_view text);
+  static Ring &local_ring_();
+  static Ring *acquire_ring_();
+
+  static inline std::atomic<uint32_t> sample_{0};
+  static inline std::atomic<uint64_t> nextId_{1};
+  static inline thread_local const char *threadName_ = nullptr;
+
+  static std::array<std::atomic<Ring *>, MAX_RINGS> rings_;
+  static std::atomic<size_t> ringCount_;
+  static std::mutex ringMutex_;
+  static Ring overflow_;
+};
+
+#endif
@@ -0,0 +1,134 @@
+// Access log record formatting, sampling and the binary file layout
+#include "access_log.hpp"
+
+#include <arpa/inet.h>
+#include <cstring>
+#include <filesystem>
+#include <format>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <unistd.h>
+
+namespace {
+
+AccessRecord MakeRecord(const char *method, const std::string &path,
+                        uint16_t status) {
+  AccessRecord rec{};
+  rec.ts_ns = 971185536LL * 1000000000 + 123; // 2000-10-10 13:45:36 UTC
+  inet_pton(AF_INET, "127.0.0.1", &rec.addr);
+  rec.status = status;
+  rec.bytes = 2326;
+  rec.queue_us = 1;
+  rec.read_us = 2;
+  rec.wait_us = 3;
+  rec.process_us = 4;
+  rec.write_us = 5;
+  rec.total_us = 15;
+  rec.requests = 2;
+  std::memcpy(rec.method, method,
+              std::min(std::strlen(method), sizeof(rec.method)));
+  std::memcpy(rec.version, "1.1", 3);
+  rec.path_len = static_cast<uint8_t>(
+      std::min(path.size(), AccessRecord::PATH_MAX_LEN));
+  std::memcpy(rec.path, path.data(), rec.path_len);
+  return rec;
+}
+
+std::string Clf(const AccessRecord &rec) {
+  std::string out;
+  AccessLog::FormatClf(rec, out);
+  return out;
+}
+
+std::string ReadFile(const std::string &path) {
+  std::ifstream in(path, std::ios_base::binary);
+  std::stringstream ss;
+  ss << in.rdbuf();
+  return ss.str();
+}
+
+} // namespace
+
+int main() {
+  // 文本格式：CLF 加各阶段耗时
+  std::string line = Clf(MakeRecord("GET", "/index.html", 200));
+  const std::string expected =
+      "127.0.0.1 - - [10/Oct/2000:13:45:36 +0000] \"GET /index.html "
+      "HTTP/1.1\" 200 2326 rt=15 q=1 r=2 w=3 p=4 s=5 ka=2\n";
+  if (line != expected) {
+    std::cerr << "clf mismatch: " << line;
+    return 1;
+  }
+
+  // 请求行来自客户端：引号、控制字符被转义，方法名占满 8 字节不越界
+  AccessRecord evil = MakeRecord("PROPFIND", "/a\"b\nc", 404);
+  evil.aborted = 1;
+  line = Clf(evil);
+  if (line.find("\"PROPFIND /a\\x22b\\x0ac HTTP/1.1\" 404") ==
+          std::string::npos ||
+      line.find(" aborted\n") == std::string::npos ||
+      line.find('\n') != line.size() - 1) {
+    std::cerr << "escaping failed: " << line;
+    return 1;
+  }
+
+  namespace fs = std::filesystem;
+  const fs::path cwd = fs::current_path();
+  const fs::path dir = std::format("access_log_test_{}", getpid());
+  fs::create_directories(dir / "log");
+  fs::current_path(dir);
+
+  if (AccessLog::init(AccessLogFormat::Off) || AccessLog::get_instance()) {
+    std::cerr << "access log should stay off" << std::endl;
+    return 1;
+  }
+  if (!AccessLog::init(AccessLogFormat::Binary, 10, 64)) {
+    std::cerr << "init failed" << std::endl;
+    return 1;
+  }
+  AccessLog *log = AccessLog::get_instance();
+
+  // 采样：1/10 的成功请求，错误响应全部保留
+  int kept = 0;
+  for (int i = 0; i < 100; ++i) {
+    kept += log->sample(200);
+  }
+  if (kept != 10 || !log->sample(500) || !log->sample(404)) {
+    std::cerr << "sampled " << kept << " of 100" << std::endl;
+    return 1;
+  }
+
+  // 二进制格式：magic 之后是原样的定长记录
+  const int N = 50;
+  for (int i = 0; i < N; ++i) {
+    log->submit(MakeRecord("GET", std::format("/p/{}", i), 200));
+  }
+  log->flush();
+  if (log->written() + log->dropped() != N) {
+    std::cerr << "written=" << log->written()
+              << " dropped=" << log->dropped() << std::endl;
+    return 1;
+  }
+  std::string file;
+  for (const auto &entry : fs::directory_iterator("log")) {
+    file = ReadFile(entry.path().string());
+  }
+  const auto magic = AccessLog::BINARY_MAGIC;
+  if (file.compare(0, magic.size(), magic) != 0 ||
+      file.size() != magic.size() + log->written() * sizeof(AccessRecord)) {
+    std::cerr << "binary file size " << file.size() << std::endl;
+    return 1;
+  }
+  AccessRecord first;
+  std::memcpy(&first, file.data() + magic.size(), sizeof(first));
+  if (Clf(first) != Clf(MakeRecord("GET", "/p/0", 200))) {
+    std::cerr << "binary round trip: " << Clf(first);
+    return 1;
+  }
+
+  fs::current_path(cwd);
+  fs::remove_all(dir);
+  return 0;
+}
@@ -0,0 +1,78 @@
+// AsyncExecutor: work runs on database threads, completions come back on the
+// thread that drains the eventfd; a failed eventfd is reported, not ignored
+#include "async_executor.hpp"
+
+#include <chrono>
+#include <iostream>
+#include <poll.h>
+#include <sys/resource.h>
+#include <system_error>
+#include <thread>
+
+int main() {
+  using namespace std::chrono;
+  Database::AsyncExecutor executor(2);
+  const auto loop = std::this_thread::get_id();
+  const int N = 20;
+
+  // 提交不等待：每个任务 20ms，提交本身应远快于执行
+  auto start = steady_clock::now();
+  int sum = 0;
+  int onLoop = 0;
+  for (int i = 0; i < N; ++i) {
+    executor.submit(
+        [i, loop] {
+          std::this_thread::sleep_for(milliseconds(20));
+          return std::this_thread::get_id() != loop ? i : -1000;
+        },
+        [&sum, &onLoop, loop](int v) {
+          sum += v;
+          onLoop += std::this_thread::get_id() == loop;
+        });
+  }
+  if (steady_clock::now() - start > milliseconds(50) ||
+      executor.pending() != N) {
+    std::cerr << "submit blocked" << std::endl;
+    return 1;
+  }
+
+  // 事件循环：eventfd 可读时执行回调
+  int done = 0;
+  pollfd pfd{executor.event_fd(), POLLIN, 0};
+  while (done < N) {
+    if (poll(&pfd, 1, 2000) <= 0) {
+      std::cerr << "eventfd never became readable" << std::endl;
+      return 1;
+    }
+    done += executor.drain();
+  }
+  if (sum != N * (N - 1) / 2 || onLoop != N || executor.pending() != 0) {
+    std::cerr << "sum=" << sum << " onLoop=" << onLoop << std::endl;
+    return 1;
+  }
+  // 排空后再 drain 没有回调可执行（eventfd 允许偶尔多唤醒一次）
+  if (executor.drain() != 0 || poll(&pfd, 1, 0) != 0) {
+    std::cerr << "completions left behind" << std::endl;
+    return 1;
+  }
+
+  // 文件描述符用尽时 eventfd 失败：构造抛出异常，而不是带着 -1 继续运行
+  rlimit old{};
+  getrlimit(RLIMIT_NOFILE, &old);
+  rlimit none = old;
+  none.rlim_cur = 0;
+  if (setrlimit(RLIMIT_NOFILE, &none) == 0) {
+    bool thrown = false;
+    try {
+      Database::AsyncExecutor broken(1);
+    } catch (const std::system_error &) {
+      thrown = true;
+    }
+    setrlimit(RLIMIT_NOFILE, &old);
+    if (!thrown) {
+      std::cerr << "eventfd failure not reported" << std::endl;
+      return 1;
+    }
+  }
+  return 0;
+}
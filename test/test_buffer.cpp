@@ -0,0 +1,46 @@
+// Buffer: appending a chained buffer copies every segment, not just the
+// first few
+#include "buffer.hpp"
+
+#include <iostream>
+#include <string>
+#include <vector>
+
+int main() {
+  // 每次追加 1000 字节，源缓冲区有数百段，远多于 ReadableIov 常用的 16 个
+  const size_t total = 40 * BufferPool::MAX_CLASS_SIZE + 123;
+  std::string want(total, '\0');
+  for (size_t i = 0; i < total; i++) {
+    want[i] = static_cast<char>('a' + i % 23);
+  }
+  Buffer src(1024, true);
+  for (size_t off = 0; off < total; off += 1000) {
+    src.Append(want.data() + off, std::min<size_t>(1000, total - off));
+  }
+  src.Retrieve(7);
+  want.erase(0, 7);
+
+  for (bool chained : {false, true}) {
+    Buffer dst(1024, chained);
+    dst.Append("head", 4);
+    dst.Append(src);
+    std::vector<struct iovec> iov(total / 1000 + 16);
+    const int cnt = dst.ReadableIov(iov.data(), static_cast<int>(iov.size()));
+    std::string got;
+    for (int i = 0; i < cnt; i++) {
+      got.append(static_cast<const char *>(iov[i].iov_base), iov[i].iov_len);
+    }
+    if (dst.ReadableBytes() != want.size() + 4 || got != "head" + want) {
+      std::cerr << (chained ? "chained" : "flat") << " copy has "
+                << dst.ReadableBytes() << " bytes, expected "
+                << want.size() + 4 << std::endl;
+      return 1;
+    }
+  }
+  // 源不变
+  if (src.ReadableBytes() != want.size()) {
+    std::cerr << "source modified" << std::endl;
+    return 1;
+  }
+  return 0;
+}
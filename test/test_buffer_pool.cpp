@@ -0,0 +1,142 @@
+// BufferPool test: blocks released on another thread are reused, and the
+// depot gives memory back once it holds more than DEPOT_MAX blocks
+#include "buffer_pool.hpp"
+
+#include <atomic>
+#include <cstring>
+#include <deque>
+#include <iostream>
+#include <mutex>
+#include <random>
+#include <thread>
+#include <vector>
+
+namespace {
+
+constexpr int kThreads = 4;
+constexpr int kIterations = 20000;
+
+void Stamp(BufferPool::Block &block, uint32_t v) {
+  std::memcpy(block.data, &v, sizeof(v));
+  std::memcpy(block.data + block.size - sizeof(v), &v, sizeof(v));
+}
+
+bool Check(const BufferPool::Block &block, uint32_t v) {
+  uint32_t head, tail;
+  std::memcpy(&head, block.data, sizeof(head));
+  std::memcpy(&tail, block.data + block.size - sizeof(tail), sizeof(tail));
+  return head == v && tail == v;
+}
+
+// 每个线程申请随机规格的块放入共享队列，再取出别的线程申请的块归还：
+// 块在线程间流转，本地链表反复溢出到仓库、又从仓库补充
+bool RunCrossThread() {
+  auto &pool = BufferPool::Instance();
+  std::mutex mtx;
+  std::deque<std::pair<BufferPool::Block, uint32_t>> shared;
+  std::atomic<int> corrupt{0};
+  std::vector<std::thread> threads;
+  for (int t = 0; t < kThreads; ++t) {
+    threads.emplace_back([&, t] {
+      std::mt19937 rng(t);
+      for (int i = 0; i < kIterations; ++i) {
+        const size_t len = 1 + rng() % BufferPool::MAX_CLASS_SIZE;
+        BufferPool::Block block = pool.Acquire(len);
+        const uint32_t stamp = t * kIterations + i;
+        Stamp(block, stamp);
+        std::pair<BufferPool::Block, uint32_t> other;
+        {
+          std::lock_guard<std::mutex> lk(mtx);
+          shared.emplace_back(block, stamp);
+          if (shared.size() < 64) {
+            continue;
+          }
+          other = shared.front();
+          shared.pop_front();
+        }
+        if (!Check(other.first, other.second)) {
+          ++corrupt;
+        }
+        pool.Release(other.first);
+      }
+    });
+  }
+  for (auto &t : threads) {
+    t.join();
+  }
+  for (auto &[block, stamp] : shared) {
+    if (!Check(block, stamp)) {
+      ++corrupt;
+    }
+    pool.Release(block);
+  }
+
+  // 主线程只归还了最后几十块；各线程退出时本地链表已交还仓库
+  auto stats = pool.GetStats();
+  bool ok = corrupt == 0 && stats.oversize_in_use == 0;
+  for (int c = 0; c < BufferPool::CLASS_NUM; ++c) {
+    if (stats.in_use[c] != 0 ||
+        stats.allocated[c] > BufferPool::DEPOT_MAX[c] + 64) {
+      ok = false;
+    }
+  }
+  if (!ok) {
+    std::cerr << "cross-thread: corrupt " << corrupt << ", 4K in use "
+              << stats.in_use[0] << ", allocated " << stats.allocated[0]
+              << std::endl;
+  }
+  return ok;
+}
+
+// 一次高峰：主线程申请大量块，另一个线程全部归还后退出
+bool RunSpike() {
+  auto &pool = BufferPool::Instance();
+  const int N = 4 * BufferPool::DEPOT_MAX[0];
+  std::vector<BufferPool::Block> blocks;
+  for (int i = 0; i < N; ++i) {
+    blocks.push_back(pool.Acquire(BufferPool::CLASS_SIZE[0]));
+  }
+  if (pool.GetStats().in_use[0] != static_cast<size_t>(N)) {
+    std::cerr << "spike: blocks not counted in use" << std::endl;
+    return false;
+  }
+  std::thread([&] {
+    for (auto &block : blocks) {
+      pool.Release(block);
+    }
+  }).join();
+
+  // 超出仓库上限的块已经还给系统
+  auto stats = pool.GetStats();
+  const size_t kept = stats.allocated[0];
+  if (stats.in_use[0] != 0 || kept > BufferPool::DEPOT_MAX[0] + 64) {
+    std::cerr << "spike: " << kept << " 4K blocks still allocated"
+              << std::endl;
+    return false;
+  }
+
+  // 仓库中留下的块被重新使用，不向系统申请新块
+  blocks.clear();
+  for (size_t i = 0; i < BufferPool::DEPOT_MAX[0] / 2; ++i) {
+    blocks.push_back(pool.Acquire(100));
+  }
+  stats = pool.GetStats();
+  for (auto &block : blocks) {
+    pool.Release(block);
+  }
+  if (stats.allocated[0] != kept) {
+    std::cerr << "spike: depot not reused, allocated " << stats.allocated[0]
+              << " after " << kept << std::endl;
+    return false;
+  }
+  return true;
+}
+
+} // namespace
+
+int main() {
+  if (!RunCrossThread() || !RunSpike()) {
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,51 @@
+// HeapTimer: nodes that sift all the way up to the root, removal by id and
+// pop order
+#include "heaptimer.hpp"
+
+#include <iostream>
+#include <vector>
+
+int main() {
+  const int N = 1000;
+  HeapTimer timer;
+  std::vector<int> fired;
+  // 超时逐个变短：每个新结点都要一路上浮到堆顶
+  for (int id = 0; id < N; id++) {
+    timer.add(id, 100000 - id * 10, [&fired, id] { fired.push_back(id); });
+  }
+  // 已有结点改为最短超时，同样上浮到堆顶
+  timer.add(0, 1000, [&fired] { fired.push_back(0); });
+  if (timer.size() != N) {
+    std::cerr << "heap size " << timer.size() << std::endl;
+    return 1;
+  }
+  int next = timer.GetNextTick();
+  if (next < 0 || next > 1000) {
+    std::cerr << "root expires in " << next << "ms" << std::endl;
+    return 1;
+  }
+
+  // 按 id 删除时触发的是该 id 自己的回调
+  for (int id : {0, N / 2, N - 1}) {
+    timer.doWork(id);
+    if (fired.empty() || fired.back() != id) {
+      std::cerr << "doWork(" << id << ") fired the wrong callback"
+                << std::endl;
+      return 1;
+    }
+  }
+
+  // 其余结点按到期时间从早到晚弹出
+  int last = 0;
+  while (timer.size() > 0) {
+    next = timer.GetNextTick();
+    if (next < last) {
+      std::cerr << "pop order broken: " << next << "ms after " << last
+                << "ms" << std::endl;
+      return 1;
+    }
+    last = next;
+    timer.pop();
+  }
+  return 0;
+}
@@ -0,0 +1,58 @@
+// HTTPRequest parsing on a keep-alive connection: each request must leave
+// the read buffer clean for the next one
+#include "HTTPRequest.hpp"
+#include "logger.hpp"
+
+#include <iostream>
+#include <string>
+
+using Web::HTTPRequest;
+
+// 表单请求体末尾没有 CRLF（浏览器和大多数客户端都是如此）
+static const std::string LOGIN_REQUEST =
+    "POST /login HTTP/1.1\r\n"
+    "Content-Type: application/x-www-form-urlencoded\r\n"
+    "Content-Length: 25\r\n"
+    "Connection: keep-alive\r\n"
+    "\r\n"
+    "username=alice&password=x";
+
+static const std::string GET_REQUEST =
+    "GET /index.html HTTP/1.1\r\nConnection: keep-alive\r\n\r\n";
+
+template <class Buf> static bool RunKeepAlive(const char *name) {
+  HTTPRequest request;
+  Buf buff;
+  buff.Append(LOGIN_REQUEST);
+  if (!request.parse(buff) || request.GetPost("username") != "alice" ||
+      request.GetPost("password") != "x" || !request.VerifyPending()) {
+    std::cerr << name << ": login form not parsed" << std::endl;
+    return false;
+  }
+  if (buff.ReadableBytes() != 0) {
+    std::cerr << name << ": " << buff.ReadableBytes()
+              << " bytes of the body left in the buffer" << std::endl;
+    return false;
+  }
+
+  // 同一连接上的下一个请求
+  request.init();
+  buff.Append(GET_REQUEST);
+  if (!request.parse(buff) || request.method() != "GET" ||
+      request.path() != "/index.html" || !request.IsKeepAlive() ||
+      buff.ReadableBytes() != 0) {
+    std::cerr << name << ": next request parsed as [" << request.method()
+              << " " << request.path() << "]" << std::endl;
+    return false;
+  }
+  return true;
+}
+
+int main() {
+  Logger::init("http_request_test", /*close_log=*/true, 5000000, 1024);
+  if (!RunKeepAlive<Buffer>("Buffer") ||
+      !RunKeepAlive<RingBuffer>("RingBuffer")) {
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,152 @@
+// Idle keep-alive connection memory test using CTest
+#include "HTTPConn.hpp"
+#include "buffer_pool.hpp"
+#include "logger.hpp"
+
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <optional>
+#include <string>
+#include <sys/socket.h>
+#include <unistd.h>
+
+using Web::HTTPConn;
+
+// 进程映射中包含 needle 的行数：镜像环形缓冲区每个占两行，
+// 响应文件每次 mmap 占一行
+static int CountMappings(const std::string &needle) {
+  std::ifstream maps("/proc/self/maps");
+  int n = 0;
+  for (std::string line; std::getline(maps, line);) {
+    n += line.find(needle) != std::string::npos;
+  }
+  return n;
+}
+
+// 空闲连接持有的资源：块池中被占用的块与字节数、环形缓冲区与文件映射。
+// 块池按块计数，不受线程本地缓存和仓库里留存的空闲块影响
+struct IdleUsage {
+  long blocks = 0;
+  long bytes = 0;
+  int ringMappings = 0;
+  int fileMappings = 0;
+};
+
+static IdleUsage Snapshot() {
+  auto stats = BufferPool::Instance().GetStats();
+  IdleUsage u;
+  for (int c = 0; c < BufferPool::CLASS_NUM; c++) {
+    u.blocks += stats.in_use[c];
+  }
+  u.blocks += stats.oversize_in_use;
+  u.bytes = stats.bytes_in_use();
+  u.ringMappings = CountMappings("memfd:ring_buffer");
+  u.fileMappings = CountMappings(std::string(RESOURCE_DIR) + "index.html");
+  return u;
+}
+
+// Serve one keep-alive request on each connection and leave it idle, the
+// way WebServer::OnProcess does. Returns what the idle connections hold.
+static std::optional<IdleUsage> MeasureIdle(int n, bool reclaim) {
+  HTTPConn::reclaimIdle = reclaim;
+  const std::string request =
+      "GET /index.html HTTP/1.1\r\nConnection: keep-alive\r\n\r\n";
+  std::vector<int> peers;
+  std::unique_ptr<HTTPConn[]> conns;
+
+  const IdleUsage before = Snapshot();
+  conns = std::make_unique<HTTPConn[]>(n);
+  char sink[1 << 16];
+  for (int i = 0; i < n; i++) {
+    int sv[2];
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, sv) < 0) {
+      std::cerr << "socketpair failed" << std::endl;
+      return std::nullopt;
+    }
+    peers.push_back(sv[1]);
+    HTTPConn &conn = conns[i];
+    conn.init(sv[0], {});
+    if (write(sv[1], request.data(), request.size()) < 0) {
+      return std::nullopt;
+    }
+    int err = 0;
+    conn.read(&err);
+    if (!conn.process()) {
+      std::cerr << "request not parsed" << std::endl;
+      return std::nullopt;
+    }
+    while (conn.to_write_bytes() > 0) {
+      conn.write(&err);
+      while (recv(sv[1], sink, sizeof(sink), MSG_DONTWAIT) > 0) {
+      }
+    }
+    /* 发送完毕，没有新请求 */
+    if (conn.process()) {
+      return std::nullopt;
+    }
+    if (HTTPConn::reclaimIdle) {
+      conn.reclaim();
+    }
+  }
+  const IdleUsage after = Snapshot();
+
+  for (int i = 0; i < n; i++) {
+    conns[i].close();
+    ::close(peers[i]);
+  }
+  return IdleUsage{after.blocks - before.blocks, after.bytes - before.bytes,
+                   after.ringMappings - before.ringMappings,
+                   after.fileMappings - before.fileMappings};
+}
+
+int main() {
+  namespace fs = std::filesystem;
+  std::error_code ec;
+  fs::create_directories("log", ec);
+  Logger::init("idle_conn_test", /*close_log=*/false, 5000000, 1024);
+  HTTPConn::srcDir = RESOURCE_DIR;
+
+  // 两端各占一个 fd，控制在默认 1024 的 fd 上限以内。判断只依据块池
+  // 计数与映射，与两轮的先后无关
+  const int n = 400;
+  const auto reclaimedUsage = MeasureIdle(n, true);
+  const auto keptUsage = MeasureIdle(n, false);
+  Logger::get_instance()->flush();
+  if (!keptUsage || !reclaimedUsage) {
+    return 1;
+  }
+  const IdleUsage &kept = *keptUsage, &reclaimed = *reclaimedUsage;
+  std::cout << "sizeof(HTTPConn): " << sizeof(HTTPConn) << "B" << std::endl;
+  std::cout << "Pool memory per idle connection, buffers kept: "
+            << kept.bytes / n << "B, ring mappings: " << kept.ringMappings
+            << ", file mappings: " << kept.fileMappings << std::endl;
+  std::cout << "Pool memory per idle connection, reclaimed:    "
+            << reclaimed.bytes / n << "B, ring mappings: "
+            << reclaimed.ringMappings
+            << ", file mappings: " << reclaimed.fileMappings << std::endl;
+
+  // 不回收时每个空闲连接至少留着写缓冲区的块
+  if (kept.blocks < n) {
+    std::cerr << "Idle connections hold " << kept.blocks
+              << " blocks without reclaim" << std::endl;
+    return 1;
+  }
+  if (reclaimed.blocks != 0 || reclaimed.bytes != 0 ||
+      reclaimed.ringMappings != 0 || reclaimed.fileMappings != 0) {
+    std::cerr << "Reclaimed connections still hold " << reclaimed.blocks
+              << " blocks, " << reclaimed.ringMappings
+              << " ring mappings and " << reclaimed.fileMappings
+              << " file mappings" << std::endl;
+    return 1;
+  }
+#ifdef WEBSERVER_RING_BUFFER
+  if (kept.ringMappings != 2 * n) {
+    std::cerr << "Expected a mirrored mapping per connection, found "
+              << kept.ringMappings << " mappings" << std::endl;
+    return 1;
+  }
+#endif
+  return 0;
+}
@@ -0,0 +1,78 @@
+// Per-call-site rate limiting and sampling of log macros
+#include "logger.hpp"
+
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <unistd.h>
+
+int main() {
+  std::filesystem::create_directories("log");
+  std::string name = std::format("limit_test_{}", getpid());
+  Logger::init(name.c_str(), /*close_log=*/false, 5000000, 0);
+
+  int rated = 0, sampled = 0;
+  for (int i = 0; i < 200; ++i) {
+    LOG_RATE_LIMITED(LOG_LEVEL_INFO, 1, 5, "rated {}", ++rated);
+  }
+  for (int i = 0; i < 100; ++i) {
+    LOG_SAMPLED(LOG_LEVEL_INFO, 10, "sampled {}", ++sampled);
+  }
+  // 限流在格式化之前生效，被抑制的调用不求值参数
+  if (rated < 5 || rated > 6 || sampled != 10) {
+    std::cerr << "rated=" << rated << " sampled=" << sampled << std::endl;
+    return 1;
+  }
+  int due = Logger::suppressed_report_due_ms();
+  if (due < 0 || due > Logger::SUPPRESS_REPORT_SEC * 1000) {
+    std::cerr << "report due in " << due << "ms" << std::endl;
+    return 1;
+  }
+  Logger::report_suppressed(); // 未到周期
+  if (Logger::suppressed_report_due_ms() < 0) {
+    std::cerr << "early report cleared pending state" << std::endl;
+    return 1;
+  }
+  Logger::report_suppressed(true);
+  if (Logger::suppressed_report_due_ms() != -1) {
+    std::cerr << "pending state not cleared" << std::endl;
+    return 1;
+  }
+  Logger::get_instance()->flush();
+
+  auto now = std::chrono::system_clock::now();
+  const std::chrono::year_month_day ymd{
+      std::chrono::floor<std::chrono::days>(now)};
+  std::string path =
+      std::format("log/{}_{:02d}_{:02d}_{}.log", static_cast<int>(ymd.year()),
+                  static_cast<unsigned>(ymd.month()),
+                  static_cast<unsigned>(ymd.day()), name);
+  std::ifstream in(path);
+  std::string line;
+  int rated_lines = 0, sampled_lines = 0, summaries = 0;
+  uint64_t suppressed = 0;
+  while (std::getline(in, line)) {
+    if (line.find("rated ") != line.npos) {
+      ++rated_lines;
+    } else if (line.find("sampled ") != line.npos) {
+      ++sampled_lines;
+    } else if (auto p = line.find("Suppressed "); p != line.npos) {
+      ++summaries;
+      suppressed += std::stoull(line.substr(p + 11));
+      if (line.find("test_log_limit.cpp:") == line.npos) {
+        std::cerr << "summary without call site: " << line << std::endl;
+        return 1;
+      }
+    }
+  }
+  std::filesystem::remove(path);
+  if (rated_lines != rated || sampled_lines != 10 || summaries != 2 ||
+      suppressed != uint64_t(200 - rated + 90)) {
+    std::cerr << "lines: rated=" << rated_lines << " sampled=" << sampled_lines
+              << " summaries=" << summaries << " suppressed=" << suppressed
+              << std::endl;
+    return 1;
+  }
+  return 0;
+}
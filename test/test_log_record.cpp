@@ -0,0 +1,158 @@
+// Deferred log records: rendering on the logger thread and offline decoding
+// must produce exactly what std::format would have produced.
+#include "log_record.hpp"
+
+#include <format>
+#include <iostream>
+#include <string>
+
+namespace {
+
+LogFormatTable table;
+
+template <class... Args>
+LogRecord Encode(int level, int64_t ts, std::string_view fmt,
+                 const Args &...args) {
+  static constexpr std::array<LogArgType, sizeof...(Args)> types{
+      log_arg_type<std::decay_t<Args>>()...};
+  LogRecord rec;
+  rec.Reset(table.Intern(fmt, types), level, ts);
+  (log_encode_arg(rec, args), ...);
+  return rec;
+}
+
+bool Expect(const std::string &got, const std::string &want) {
+  if (got != want) {
+    std::cerr << "got:  " << got << "\nwant: " << want << std::endl;
+    return false;
+  }
+  return true;
+}
+
+} // namespace
+
+int main() {
+  // 2024-01-01 12:34:56.000000042 UTC
+  const int64_t ts = 1704112496LL * 1000000000 + 42;
+  const std::string prefix = "[12:34:56.000000042] ";
+
+  std::string name = "alice";
+  const char *path = "/index.html";
+  LogRecord recs[] = {
+      Encode(1, ts, "Client[{}]({}:{}) in, userCount:{}", 7, "127.0.0.1",
+             uint16_t(8080), size_t(3)),
+      Encode(3, ts, "{:>8}|{:<4}|{:x}|{:.2f}|{}|{}", name, 'c', 255u, 3.14159,
+             true, -5LL),
+      Encode(2, ts + 1, "{{literal}} {1} before {0}", path, std::string(300, 'x')),
+      // float 不能按 double 保存，否则 0.1f 会输出成 0.10000000149011612
+      Encode(0, ts, "ratio {} {:.3} {}", 0.1f, 2.5f, 0.1),
+  };
+  const std::string want[] = {
+      prefix + "[INFO] Client[7](127.0.0.1:8080) in, userCount:3",
+      prefix + "[ERROR]" +
+          std::format("{:>8}|{:<4}|{:x}|{:.2f}|{}|{}", name, 'c', 255u,
+                      3.14159, true, -5LL),
+      "[12:34:56.000000043] [WARN] " +
+          std::format("{{literal}} {1} before {0}", path,
+                      std::string(300, 'x')),
+      prefix + "[DEBUG]" + std::format("ratio {} {:.3} {}", 0.1f, 2.5f, 0.1),
+  };
+
+  // 日志线程上的渲染
+  LogTimestampCache timestamp;
+  for (size_t i = 0; i < std::size(recs); ++i) {
+    const LogFormat *format = table.Find(recs[i].fmt_id);
+    if (!format) {
+      std::cerr << "format " << i << " not deferrable" << std::endl;
+      return 1;
+    }
+    std::string line;
+    timestamp.Append(line, recs[i].ts_ns);
+    line += log_level_prefix(recs[i].level);
+    if (!log_render(*format, recs[i].Data(), recs[i].Size(), line) ||
+        !Expect(line, want[i])) {
+      return 1;
+    }
+  }
+
+  // 动态宽度无法延迟，同一格式串与参数类型复用 id
+  std::array<LogArgType, 2> two{LogArgType::I64, LogArgType::I64};
+  if (table.Intern("{:{}}", two) != 0 ||
+      Encode(1, ts, "Client[{}]({}:{}) in, userCount:{}", 1, "x",
+             uint16_t(1), size_t(1))
+              .fmt_id != recs[0].fmt_id) {
+    std::cerr << "unexpected format id" << std::endl;
+    return 1;
+  }
+
+  // 二进制文件：文件头 + 定义 + 记录，外加一条预先格式化的正文，逐字节喂给解码器
+  std::string file(LOG_BINARY_MAGIC);
+  for (const auto &rec : recs) {
+    log_append_definition(*table.Find(rec.fmt_id), file);
+    log_append_record(rec, file);
+  }
+  LogRecord text;
+  text.Reset(0, 4, ts);
+  text.SetText("preformatted");
+  log_append_record(text, file);
+
+  LogBinaryDecoder decoder;
+  std::string decoded;
+  for (char c : file) {
+    if (!decoder.Feed(std::string_view(&c, 1), decoded)) {
+      std::cerr << "decoder rejected valid input" << std::endl;
+      return 1;
+    }
+  }
+  std::string expected;
+  for (const auto &w : want) {
+    expected += w + "\n";
+  }
+  expected += prefix + "[FATAL]preformatted\n";
+  if (!decoder.Complete() || !Expect(decoded, expected)) {
+    return 1;
+  }
+
+  // 未定义的 id 视为损坏
+  LogBinaryDecoder fresh;
+  std::string bad(LOG_BINARY_MAGIC), ignored;
+  log_append_record(recs[0], bad);
+  if (fresh.Feed(bad, ignored)) {
+    std::cerr << "undefined format id accepted" << std::endl;
+    return 1;
+  }
+
+  // 格式说明与参数类型不符（字符串配 {:d}）：报告损坏而不是抛出异常，
+  // 也不留下半行
+  LogFormat mismatched;
+  mismatched.id = 99;
+  mismatched.fmt = "n={:d}";
+  mismatched.types = {LogArgType::Str};
+  std::string wrong(LOG_BINARY_MAGIC);
+  log_append_definition(mismatched, wrong);
+  LogRecord wrongRec;
+  wrongRec.Reset(99, 1, ts);
+  log_encode_arg(wrongRec, "text");
+  log_append_record(wrongRec, wrong);
+  LogBinaryDecoder mismatch;
+  std::string partial;
+  if (mismatch.Feed(wrong, partial) || !partial.empty()) {
+    std::cerr << "mismatched spec accepted: " << partial << std::endl;
+    return 1;
+  }
+
+  // 定义帧的格式串长度为 0xFFFFFFFF：不能因 len + 1 回绕而越界读取，
+  // 只能等待后续数据
+  std::string huge(LOG_BINARY_MAGIC);
+  huge += 'D';
+  const uint32_t hugeId = 1, hugeLen = 0xFFFFFFFF;
+  huge.append(reinterpret_cast<const char *>(&hugeId), sizeof(hugeId));
+  huge.append(reinterpret_cast<const char *>(&hugeLen), sizeof(hugeLen));
+  huge += "{}";
+  LogBinaryDecoder truncated;
+  if (!truncated.Feed(huge, ignored) || truncated.Complete()) {
+    std::cerr << "oversized definition mishandled" << std::endl;
+    return 1;
+  }
+  return 0;
+}
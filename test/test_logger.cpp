@@ -6,6 +6,7 @@
 #include <filesystem>
 #include <fstream>
 #include <iostream>
+#include <signal.h>
 #include <string>
 #include <vector>
 
@@ -65,10 +66,44 @@ int main() {
       has_error = true;
   }
 
-  if (!has_info || !has_error) {
+  if ((!has_info && LOG_MIN_LEVEL <= LOG_LEVEL_INFO) || !has_error) {
     std::cerr << "Expected both INFO and ERROR entries" << std::endl;
     return 1;
   }
 
+  // Level thresholds: disabled calls must not evaluate their arguments
+  int evaluated = 0;
+  auto touch = [&evaluated] { return ++evaluated; };
+  LOG_DEBUG("default threshold is info {}", touch());
+  if (evaluated != 0) {
+    std::cerr << "DEBUG evaluated at default level" << std::endl;
+    return 1;
+  }
+  if (!Logger::set_levels("warn,http=debug") ||
+      Logger::levels() != "warn,http=debug" ||
+      Logger::enabled(LOG_LEVEL_INFO, LogModule::Server) ||
+      !Logger::enabled(LOG_LEVEL_DEBUG, LogModule::Http)) {
+    std::cerr << "per-module levels not applied: " << Logger::levels()
+              << std::endl;
+    return 1;
+  }
+  if (Logger::set_levels("debug,nosuch=info") ||
+      Logger::set_levels("loud") || Logger::levels() != "warn,http=debug") {
+    std::cerr << "invalid spec must not change levels" << std::endl;
+    return 1;
+  }
+  Logger::set_levels("http=default");
+  Logger::install_signal_handlers();
+  raise(SIGUSR1);
+  LOG_INFO("after SIGUSR1 {}", touch());
+  raise(SIGUSR2);
+  raise(SIGUSR2);
+  LOG_WARN("after SIGUSR2 {}", touch());
+  if (evaluated != (LOG_MIN_LEVEL <= LOG_LEVEL_INFO) ||
+      Logger::levels() != "error") {
+    std::cerr << "signal level changes: " << Logger::levels() << std::endl;
+    return 1;
+  }
+
   return 0;
 }
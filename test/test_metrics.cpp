@@ -0,0 +1,132 @@
+// Metrics histogram buckets, per-thread aggregation and Prometheus output
+#include "metrics.hpp"
+
+#include <cstdint>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+int main() {
+  // 桶边界：小于 16 精确，其余相对误差不超过 1/16，且覆盖连续
+  for (uint64_t v = 0; v < 16; ++v) {
+    if (Histogram::bucket_of(v) != v) {
+      std::cerr << "small value " << v << " not exact" << std::endl;
+      return 1;
+    }
+  }
+  for (uint64_t v : {16ULL, 17ULL, 31ULL, 32ULL, 1000ULL, 123456789ULL,
+                     (1ULL << 40) - 1}) {
+    const size_t b = Histogram::bucket_of(v);
+    const uint64_t lo = Histogram::bucket_lower(b);
+    const uint64_t hi = Histogram::bucket_upper(b);
+    if (v < lo || v >= hi || (hi - lo) * 16 > lo) {
+      std::cerr << "value " << v << " in bucket [" << lo << ", " << hi << ")"
+                << std::endl;
+      return 1;
+    }
+  }
+  for (size_t b = 1; b < Histogram::BUCKETS; ++b) {
+    if (Histogram::bucket_lower(b) != Histogram::bucket_upper(b - 1)) {
+      std::cerr << "gap before bucket " << b << std::endl;
+      return 1;
+    }
+  }
+  if (Histogram::bucket_of(UINT64_MAX) != Histogram::BUCKETS - 1) {
+    std::cerr << "huge value not clamped" << std::endl;
+    return 1;
+  }
+
+  // 分位值：1..1000 均匀分布，误差在桶宽以内
+  Histogram h;
+  for (uint64_t v = 1; v <= 1000; ++v) {
+    h.record(v);
+  }
+  Histogram::Snapshot snap;
+  h.add_to(snap);
+  const uint64_t p50 = snap.quantile(0.5);
+  const uint64_t p99 = snap.quantile(0.99);
+  if (snap.count != 1000 || snap.sum != 500500 || p50 < 500 || p50 > 532 ||
+      p99 < 990 || p99 > 1023 || snap.count_at_most(15) != 15) {
+    std::cerr << "quantiles p50=" << p50 << " p99=" << p99 << std::endl;
+    return 1;
+  }
+
+  // 多线程各写各的槽位，线程退出后数值仍在；槽位被复用而不是不断新增
+  const int THREADS = 8;
+  const int PER_THREAD = 10000;
+  for (int round = 0; round < 3; ++round) {
+    std::vector<std::thread> threads;
+    for (int i = 0; i < THREADS; ++i) {
+      threads.emplace_back([] {
+        for (int j = 0; j < PER_THREAD; ++j) {
+          Metrics::add(MetricCounter::Requests);
+          Metrics::observe(MetricStage::Parse, 2000);
+        }
+        // 在一个线程加、另一个线程减，汇总后归零
+        Metrics::gauge_add(MetricGauge::Connections, 1);
+      });
+    }
+    for (auto &t : threads) {
+      t.join();
+    }
+  }
+  std::thread([] {
+    Metrics::gauge_add(MetricGauge::Connections, -3 * THREADS);
+  }).join();
+  const uint64_t total = 3ULL * THREADS * PER_THREAD;
+  if (Metrics::counter(MetricCounter::Requests) != total ||
+      Metrics::stage(MetricStage::Parse).count != total ||
+      Metrics::gauge(MetricGauge::Connections) != 0) {
+    std::cerr << "aggregated requests: "
+              << Metrics::counter(MetricCounter::Requests)
+              << " connections: " << Metrics::gauge(MetricGauge::Connections)
+              << std::endl;
+    return 1;
+  }
+
+  // Prometheus 文本：le 累计递增，+Inf 等于 _count
+  Metrics::observe(MetricStage::Total, 3000000); // 3ms
+  std::string out;
+  Metrics::write_prometheus(out);
+  Metrics::write_gauge(out, "webserver_timers", "Pending timers", 7);
+  for (const char *want :
+       {"# TYPE webserver_requests_total counter\n",
+        "webserver_requests_total 240000\n",
+        "webserver_responses_total{code=\"4xx\"} 0\n",
+        "webserver_connections 0\n",
+        "webserver_stage_duration_seconds_bucket{stage=\"parse\",le=\"1e-05\"} "
+        "240000\n",
+        "webserver_stage_duration_seconds_bucket{stage=\"total\","
+        "le=\"0.0025\"} 0\n",
+        "webserver_stage_duration_seconds_bucket{stage=\"total\",le=\"0.005\"} "
+        "1\n",
+        "webserver_stage_duration_seconds_count{stage=\"total\"} 1\n",
+        "webserver_stage_duration_seconds_sum{stage=\"total\"} 0.003\n",
+        "# TYPE webserver_timers gauge\nwebserver_timers 7\n"}) {
+    if (out.find(want) == std::string::npos) {
+      std::cerr << "missing: " << want << out;
+      return 1;
+    }
+  }
+  std::istringstream lines(out);
+  std::string line;
+  uint64_t last = 0;
+  std::string stage;
+  while (std::getline(lines, line)) {
+    const size_t at = line.find("_bucket{stage=\"");
+    if (at == std::string::npos) {
+      continue;
+    }
+    const std::string name = line.substr(at, line.find('"', at + 15) - at);
+    const uint64_t n = std::stoull(line.substr(line.rfind(' ') + 1));
+    if (name == stage && n < last) {
+      std::cerr << "non-cumulative bucket: " << line << std::endl;
+      return 1;
+    }
+    stage = name;
+    last = n;
+  }
+  return 0;
+}
@@ -0,0 +1,93 @@
+// MpscRing test: every policy must account for each pushed message exactly once
+#include "mpsc_ring.hpp"
+
+#include <atomic>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+constexpr int kProducers = 4;
+constexpr int kPerProducer = 50000;
+
+bool RunPolicy(FullPolicy policy) {
+  MpscRing<std::string> ring(64, policy);
+  std::atomic<uint64_t> consumed{0};
+  std::thread consumer([&] {
+    std::vector<std::string> batch;
+    for (;;) {
+      batch.clear();
+      size_t n = ring.pop_batch(batch, 32);
+      if (n == 0) {
+        return;
+      }
+      consumed += n;
+    }
+  });
+
+  std::atomic<uint64_t> accepted{0};
+  std::vector<std::thread> producers;
+  for (int t = 0; t < kProducers; ++t) {
+    producers.emplace_back([&] {
+      for (int i = 0; i < kPerProducer; ++i) {
+        if (ring.push(std::to_string(i))) {
+          ++accepted;
+        }
+      }
+    });
+  }
+  for (auto &p : producers) {
+    p.join();
+  }
+  while (!ring.empty()) {
+    std::this_thread::yield();
+  }
+  ring.stop();
+  consumer.join();
+
+  const uint64_t total = uint64_t(kProducers) * kPerProducer;
+  bool ok = true;
+  switch (policy) {
+  case FullPolicy::Block:
+    ok = accepted == total && consumed == total && ring.dropped() == 0 &&
+         ring.overwritten() == 0;
+    break;
+  case FullPolicy::Drop:
+    ok = accepted + ring.dropped() == total && consumed == accepted;
+    break;
+  case FullPolicy::Overwrite:
+    ok = accepted == total && consumed + ring.overwritten() == total;
+    break;
+  }
+  if (!ok) {
+    std::cerr << "policy " << static_cast<int>(policy)
+              << " accepted=" << accepted << " consumed=" << consumed
+              << " dropped=" << ring.dropped()
+              << " overwritten=" << ring.overwritten() << std::endl;
+  }
+  return ok;
+}
+
+} // namespace
+
+int main() {
+  for (auto policy :
+       {FullPolicy::Block, FullPolicy::Drop, FullPolicy::Overwrite}) {
+    if (!RunPolicy(policy)) {
+      return 1;
+    }
+  }
+
+  // stop() 之后 pop_batch 先取完剩余数据，再返回 0
+  MpscRing<std::string> ring(4, FullPolicy::Block);
+  ring.push("a");
+  ring.stop();
+  std::vector<std::string> batch;
+  if (ring.pop_batch(batch, 8) != 1 || ring.pop_batch(batch, 8) != 0) {
+    std::cerr << "pop_batch after stop" << std::endl;
+    return 1;
+  }
+  return 0;
+}
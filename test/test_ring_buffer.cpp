@@ -0,0 +1,152 @@
+// RingBuffer: data that wraps past the end of the mapping, growth,
+// RetrieveAll/Release, and a mapping that fails
+#include "ring_buffer.hpp"
+
+#include <cerrno>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+static std::string Pattern(size_t len, size_t seed) {
+  std::string s(len, '\0');
+  for (size_t i = 0; i < len; i++) {
+    s[i] = static_cast<char>('a' + (seed + i) % 26);
+  }
+  return s;
+}
+
+static bool Expect(const RingBuffer &buff, const std::string &want,
+                   const char *what) {
+  if (std::string_view(buff.Peek(), buff.ReadableBytes()) != want) {
+    std::cerr << what << ": readable " << buff.ReadableBytes()
+              << " bytes, expected " << want.size() << std::endl;
+    return false;
+  }
+  return true;
+}
+
+static bool TestWrapAndGrow() {
+  RingBuffer buff(4096);
+  const size_t cap = buff.Capacity();
+  if (!buff.Mapped() || cap < 4096) {
+    std::cerr << "initial mapping failed" << std::endl;
+    return false;
+  }
+
+  // 读位置移到末尾附近，再写入的数据越过映射末尾，仍可连续读出
+  std::string a = Pattern(cap - 500, 0);
+  buff.Append(a);
+  buff.Retrieve(cap - 1000);
+  std::string want = a.substr(cap - 1000);
+  std::string b = Pattern(2000, 7);
+  buff.Append(b);
+  want += b;
+  if (buff.Capacity() != cap || !Expect(buff, want, "wraparound")) {
+    return false;
+  }
+
+  // 可写空间不足时扩容，环上的数据按顺序搬到新映射开头
+  std::string c = Pattern(cap, 13);
+  if (!buff.Append(c)) {
+    std::cerr << "grow failed" << std::endl;
+    return false;
+  }
+  want += c;
+  if (buff.Capacity() < want.size() || !Expect(buff, want, "grow")) {
+    return false;
+  }
+
+  // 经 socket 读入同样会越过末尾
+  int sv[2];
+  if (socketpair(AF_UNIX, SOCK_STREAM, 0, sv) < 0) {
+    return false;
+  }
+  buff.Retrieve(want.size() - 10);
+  want = want.substr(want.size() - 10);
+  std::string d = Pattern(buff.Capacity() - 20, 3);
+  int err = 0;
+  bool ok = write(sv[1], d.data(), d.size()) ==
+                static_cast<ssize_t>(d.size()) &&
+            buff.ReadFd(sv[0], &err) == static_cast<ssize_t>(d.size());
+  close(sv[0]);
+  close(sv[1]);
+  want += d;
+  if (!ok || !Expect(buff, want, "ReadFd")) {
+    return false;
+  }
+
+  // RetrieveAll 只重置下标，容量不变
+  const size_t grown = buff.Capacity();
+  buff.RetrieveAll();
+  if (buff.ReadableBytes() != 0 || buff.Capacity() != grown ||
+      buff.WritableBytes() != grown || buff.BeginWriteConst() != buff.Peek()) {
+    std::cerr << "RetrieveAll did not reset" << std::endl;
+    return false;
+  }
+
+  // Release 解除映射，下次写入时重新映射
+  buff.Release();
+  if (buff.Mapped() || buff.Capacity() != 0 || !buff.Append(b) ||
+      !Expect(buff, b, "append after release")) {
+    std::cerr << "remap after release failed" << std::endl;
+    return false;
+  }
+  return true;
+}
+
+// 用 RLIMIT_AS 让映射失败：构造、扩容与 ReadFd 都要返回错误而不是崩溃
+static bool TestMapFailure() {
+  std::ifstream statm("/proc/self/statm");
+  long pages = 0;
+  statm >> pages;
+  const rlim_t headroom = 64 << 20;
+  rlimit old{};
+  getrlimit(RLIMIT_AS, &old);
+  rlimit lim = old;
+  lim.rlim_cur = pages * sysconf(_SC_PAGESIZE) + headroom;
+  if (setrlimit(RLIMIT_AS, &lim) < 0) {
+    std::cerr << "setrlimit failed, skipping" << std::endl;
+    return true;
+  }
+
+  bool ok = true;
+  {
+    RingBuffer big(256 << 20);
+    if (big.Mapped() || big.Capacity() != 0 || big.Append("x", 1)) {
+      std::cerr << "oversized mapping did not fail" << std::endl;
+      ok = false;
+    }
+    int sv[2];
+    int err = 0;
+    if (ok && socketpair(AF_UNIX, SOCK_STREAM, 0, sv) == 0) {
+      ok = write(sv[1], "GET", 3) == 3 && big.ReadFd(sv[0], &err) == -1 &&
+           err == ENOMEM;
+      close(sv[0]);
+      close(sv[1]);
+      if (!ok) {
+        std::cerr << "ReadFd did not report ENOMEM" << std::endl;
+      }
+    }
+
+    RingBuffer small(4096);
+    small.Append("abc", 3);
+    if (small.EnsureWriteable(512 << 20) ||
+        !Expect(small, "abc", "failed grow")) {
+      std::cerr << "failed grow changed the buffer" << std::endl;
+      ok = false;
+    }
+  }
+  setrlimit(RLIMIT_AS, &old);
+  return ok;
+}
+
+int main() {
+  if (!TestWrapAndGrow() || !TestMapFailure()) {
+    return 1;
+  }
+  return 0;
+}
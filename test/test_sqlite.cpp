@@ -0,0 +1,176 @@
+// Database::SQLite bound parameters, the per-connection statement cache,
+// typed/streamed results and the group-commit write queue
+#include "sqlite.hpp"
+
+#include <filesystem>
+#include <format>
+#include <future>
+#include <iostream>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+int main() {
+  namespace fs = std::filesystem;
+  const std::string path = std::format("sqlite_test_{}.db", getpid());
+  // 只读连接要求文件已存在
+  {
+    sqlite3 *db = nullptr;
+    sqlite3_open(path.c_str(), &db);
+    sqlite3_close(db);
+  }
+  Database::SQLite::Options options;
+  options.read_pool_size = 2;
+  options.max_batch = 32;
+  options.max_batch_delay = std::chrono::milliseconds(20);
+  Database::SQLite::init(path, options);
+  auto *sql = Database::SQLite::get_instance();
+  std::string err;
+  if (!sql->execute("CREATE TABLE user(id INTEGER PRIMARY KEY, "
+                    "username TEXT UNIQUE, password TEXT)",
+                    &err)) {
+    std::cerr << "create: " << err << std::endl;
+    return 1;
+  }
+
+  // 引号、注入片段与内嵌 NUL 都原样作为数据存取
+  const std::string tricky = "o'brien\"; DROP TABLE user; --";
+  const std::string nul("a\0b", 3);
+  for (std::string_view name : {std::string_view(tricky),
+                                std::string_view(nul),
+                                std::string_view("plain")}) {
+    if (!sql->execute("INSERT INTO user(username, password) VALUES(?, ?)",
+                      {name, "pw"}, &err)) {
+      std::cerr << "insert: " << err << std::endl;
+      return 1;
+    }
+  }
+  auto res = sql->query("SELECT username FROM user WHERE username=?",
+                        {tricky}, &err);
+  if (!res || res->rows.size() != 1 || res->rows[0][0] != tricky) {
+    std::cerr << "bound text round trip failed: " << err << std::endl;
+    return 1;
+  }
+  res = sql->query("SELECT username FROM user WHERE username=?", {nul});
+  if (!res || res->rows.size() != 1 || res->rows[0][0] != nul) {
+    std::cerr << "embedded NUL lost" << std::endl;
+    return 1;
+  }
+  res = sql->query("SELECT username FROM user WHERE username=?",
+                   {"' OR '1'='1"});
+  if (!res || !res->rows.empty()) {
+    std::cerr << "injection string matched rows" << std::endl;
+    return 1;
+  }
+
+  // 整数、浮点、NULL 参数
+  res = sql->query("SELECT ? + 1, ? * 2, ? IS NULL",
+                   {int64_t{41}, 1.5, nullptr});
+  if (!res || res->rows.size() != 1 || res->rows[0][0] != "42" ||
+      res->rows[0][1] != "3.000000" || res->rows[0][2] != "1") {
+    std::cerr << "numeric params failed" << std::endl;
+    return 1;
+  }
+
+  // ResultSet：数值保持原类型，文本与 blob 原样存进 arena
+  Database::ResultSet rs;
+  if (!sql->query("SELECT 7, 2.5, NULL, 'txt', x'00ff', ?", {nul}, rs) ||
+      rs.rows() != 1 || rs.cols() != 6 ||
+      rs.type(0, 0) != Database::ValueType::Integer || rs.get_int(0, 0) != 7 ||
+      rs.get_double(0, 1) != 2.5 || !rs.is_null(0, 2) ||
+      rs.get_text(0, 3) != "txt" ||
+      rs.type(0, 4) != Database::ValueType::Blob ||
+      rs.get_text(0, 4) != std::string_view("\0\xff", 2) ||
+      rs.get_text(0, 5) != nul || rs.get_int(0, 3) != 0) {
+    std::cerr << "typed result mismatch" << std::endl;
+    return 1;
+  }
+  // 复用同一个 ResultSet，旧结果被清掉
+  if (!sql->query("SELECT username FROM user ORDER BY id", rs) ||
+      rs.rows() != 3 || rs.cols() != 1 || rs.column_name(0) != "username" ||
+      rs.get_text(0, 0) != tricky || rs.get_text(2, 0) != "plain") {
+    std::cerr << "reused result set mismatch" << std::endl;
+    return 1;
+  }
+
+  // 逐行回调，返回 false 提前结束且不算错误
+  int visited = 0;
+  if (!sql->for_each_row("SELECT id FROM user ORDER BY id", {},
+                         [&](const Database::Row &row) {
+                           return row.get_int(0) == ++visited && visited < 2;
+                         }) ||
+      visited != 2) {
+    std::cerr << "for_each_row visited " << visited << std::endl;
+    return 1;
+  }
+  if (sql->for_each_row("SELECT nope FROM user", {},
+                        [](const Database::Row &) { return true; }, &err) ||
+      err.empty()) {
+    std::cerr << "for_each_row accepted bad SQL" << std::endl;
+    return 1;
+  }
+
+  // 参数个数不符直接报错，不执行
+  if (sql->query("SELECT ?", {}, &err) || err.empty()) {
+    std::cerr << "missing parameter was accepted" << std::endl;
+    return 1;
+  }
+  if (sql->execute("INSERT INTO user(username) VALUES(?)", {"a", "b"})) {
+    std::cerr << "extra parameter was accepted" << std::endl;
+    return 1;
+  }
+
+  // 同一条 SQL 在每个连接上只准备一次
+  const uint64_t misses = sql->statement_cache_misses();
+  const uint64_t hits = sql->statement_cache_hits();
+  for (int i = 0; i < 100; ++i) {
+    res = sql->query("SELECT password FROM user WHERE username=?", {"plain"});
+    if (!res || res->rows.size() != 1 || res->rows[0][0] != "pw") {
+      std::cerr << "cached query returned wrong rows" << std::endl;
+      return 1;
+    }
+  }
+  const uint64_t newMisses = sql->statement_cache_misses() - misses;
+  if (newMisses > 2 || sql->statement_cache_hits() - hits < 98) {
+    std::cerr << "statement cache misses: " << newMisses << std::endl;
+    return 1;
+  }
+
+  // 语法错误不进入缓存，连接仍可用
+  if (sql->query("SELEC 1", &err) || err.empty() || !sql->query("SELECT 1")) {
+    std::cerr << "bad SQL handling failed" << std::endl;
+    return 1;
+  }
+
+  // 组提交：一批写入合并为少数几个事务，失败的语句只回滚自己
+  const uint64_t batches = sql->write_batches();
+  const uint64_t writes = sql->writes();
+  std::vector<std::future<Database::SQLite::WriteResult>> pending;
+  for (int i = 0; i < 64; ++i) {
+    const std::string name = i == 10 ? "plain" : std::format("batch{}", i);
+    pending.push_back(sql->submit(
+        "INSERT INTO user(username, password) VALUES(?, ?)", {name, "pw"}));
+  }
+  int failed = 0;
+  for (auto &f : pending) {
+    auto r = f.get();
+    failed += !r.ok;
+    if (r.ok && (r.changes != 1 || r.last_insert_rowid <= 0)) {
+      std::cerr << "missing write result" << std::endl;
+      return 1;
+    }
+  }
+  const uint64_t newBatches = sql->write_batches() - batches;
+  res = sql->query("SELECT COUNT(*) FROM user WHERE username LIKE 'batch%'");
+  if (failed != 1 || sql->writes() - writes != 64 || newBatches > 4 ||
+      !res || res->rows[0][0] != "63") {
+    std::cerr << "group commit: failed=" << failed
+              << " batches=" << newBatches << std::endl;
+    return 1;
+  }
+
+  fs::remove(path);
+  fs::remove(path + "-wal");
+  fs::remove(path + "-shm");
+  return 0;
+}
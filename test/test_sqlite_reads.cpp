@@ -0,0 +1,146 @@
+// Database::SQLite thread-local read connections, the pool fallback, read
+// connection tuning and background WAL checkpoints
+#include "sqlite.hpp"
+
+#include <chrono>
+#include <filesystem>
+#include <format>
+#include <iostream>
+#include <latch>
+#include <string>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+int main() {
+  namespace fs = std::filesystem;
+  const std::string path = std::format("sqlite_reads_test_{}.db", getpid());
+  // 只读连接要求文件已存在
+  {
+    sqlite3 *db = nullptr;
+    sqlite3_open(path.c_str(), &db);
+    sqlite3_close(db);
+  }
+  Database::SQLite::Options options;
+  options.read_pool_size = 1;
+  options.thread_local_reads = true;
+  options.max_thread_connections = 2;
+  options.checkpoint_interval = std::chrono::milliseconds(20);
+  options.checkpoint_wal_pages = 8;
+  options.cache_size = -1234;
+  options.temp_store = 2;
+  Database::SQLite::init(path, options);
+  auto *sql = Database::SQLite::get_instance();
+  if (!sql->execute("CREATE TABLE t(id INTEGER PRIMARY KEY, v TEXT)") ||
+      !sql->execute("INSERT INTO t(v) VALUES('a'), ('b'), ('c')")) {
+    std::cerr << "setup failed" << std::endl;
+    return 1;
+  }
+
+  // 4 个线程抢 2 个线程连接：两个各自持有，另两个走只有 1 个连接的池。
+  // 都查过一次后才继续，否则先结束的线程交还的连接会被后来者复用
+  const int THREADS = 4;
+  const int QUERIES = 200;
+  std::vector<std::thread> threads;
+  std::vector<int> wrong(THREADS, 0);
+  std::latch started(THREADS);
+  for (int t = 0; t < THREADS; ++t) {
+    threads.emplace_back([&, t] {
+      Database::ResultSet rs;
+      for (int i = 0; i < QUERIES; ++i) {
+        if (!sql->query("SELECT COUNT(*) FROM t", rs) || rs.get_int(0, 0) != 3)
+          ++wrong[t];
+        if (i == 0)
+          started.arrive_and_wait();
+      }
+    });
+  }
+  for (auto &th : threads) {
+    th.join();
+  }
+  for (int t = 0; t < THREADS; ++t) {
+    if (wrong[t]) {
+      std::cerr << "thread " << t << " got wrong results" << std::endl;
+      return 1;
+    }
+  }
+  auto stats = sql->read_stats();
+  if (stats.thread_connections != 2 ||
+      stats.thread_reads + stats.pool_reads !=
+          static_cast<uint64_t>(THREADS * QUERIES) ||
+      stats.thread_reads < 2 * QUERIES) {
+    std::cerr << "thread reads: " << stats.thread_reads
+              << " pool reads: " << stats.pool_reads
+              << " connections: " << stats.thread_connections << std::endl;
+    return 1;
+  }
+
+  // 退出的线程交还连接，新线程直接复用，不再新开
+  const uint64_t poolReads = stats.pool_reads;
+  std::thread([&] {
+    for (int i = 0; i < 10; ++i) {
+      sql->query("SELECT 1");
+    }
+  }).join();
+  stats = sql->read_stats();
+  if (stats.thread_connections != 2 || stats.pool_reads != poolReads) {
+    std::cerr << "connection not recycled" << std::endl;
+    return 1;
+  }
+
+  // 回调里再查询：线程连接正被占用，内层查询走连接池
+  int inner = 0;
+  const bool ok =
+      sql->for_each_row("SELECT v FROM t", {}, [&](const Database::Row &row) {
+        auto res = sql->query("SELECT v FROM t WHERE v=?", {row.get_text(0)});
+        inner += res && res->rows.size() == 1;
+        return true;
+      });
+  stats = sql->read_stats();
+  if (!ok || inner != 3 || stats.pool_reads != poolReads + 3) {
+    std::cerr << "nested queries: " << inner << std::endl;
+    return 1;
+  }
+
+  // 读连接（线程连接与连接池）都带上了调优参数
+  auto res = sql->query("PRAGMA cache_size");
+  const bool pooled = sql->for_each_row(
+      "SELECT 1", {}, [&](const Database::Row &) {
+        auto inner = sql->query("PRAGMA temp_store");
+        return inner && inner->rows[0][0] == "2";
+      });
+  if (!res || res->rows[0][0] != "-1234" || !pooled) {
+    std::cerr << "read pragmas not applied" << std::endl;
+    return 1;
+  }
+
+  // 后台 checkpoint：写满若干页后由 checkpoint 线程处理，写入方不等待
+  const std::string filler(2000, 'x');
+  for (int i = 0; i < 50; ++i) {
+    sql->execute("INSERT INTO t(v) VALUES(?)", {filler});
+  }
+  auto ckpt = sql->checkpoint_stats();
+  for (int i = 0; i < 100 && ckpt.checkpoints == 0; ++i) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    ckpt = sql->checkpoint_stats();
+  }
+  if (ckpt.checkpoints == 0 || ckpt.max_wal_pages < 8 || ckpt.page_size <= 0 ||
+      ckpt.max_ns == 0) {
+    std::cerr << "checkpoints: " << ckpt.checkpoints
+              << " max WAL pages: " << ckpt.max_wal_pages << std::endl;
+    return 1;
+  }
+  // 没有新的提交就不再 checkpoint
+  std::this_thread::sleep_for(std::chrono::milliseconds(100));
+  const uint64_t settled = sql->checkpoint_stats().checkpoints;
+  std::this_thread::sleep_for(std::chrono::milliseconds(100));
+  if (sql->checkpoint_stats().checkpoints != settled) {
+    std::cerr << "idle checkpoints kept running" << std::endl;
+    return 1;
+  }
+
+  fs::remove(path);
+  fs::remove(path + "-wal");
+  fs::remove(path + "-shm");
+  return 0;
+}
@@ -0,0 +1,131 @@
+// Database::SQLite sharded mode: shard paths, routing by username and the
+// UserCache across shards
+#include "user_cache.hpp"
+
+#include <filesystem>
+#include <format>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+int main() {
+  using Database::SQLite;
+  if (SQLite::shard_path("db.sqlite3", 2, 4) != "db.shard2.sqlite3" ||
+      SQLite::shard_path("a.b/db", 0, 2) != "a.b/db.shard0" ||
+      SQLite::shard_path("db.sqlite3", 0, 1) != "db.sqlite3") {
+    std::cerr << "shard path wrong" << std::endl;
+    return 1;
+  }
+  // 哈希固定不变，已有的分片文件才能一直读对
+  if (SQLite::shard_of("alice", 8) != SQLite::shard_of("alice", 8) ||
+      SQLite::shard_of("anything", 1) != 0 ||
+      SQLite::shard_of("", 4) != 0xcbf29ce484222325ULL % 4) {
+    std::cerr << "shard hash changed" << std::endl;
+    return 1;
+  }
+
+  namespace fs = std::filesystem;
+  const size_t SHARDS = 4;
+  const std::string base = std::format("shards_test_{}.db", getpid());
+  // 只读连接要求文件已存在
+  for (size_t i = 0; i < SHARDS; ++i) {
+    sqlite3 *db = nullptr;
+    sqlite3_open(SQLite::shard_path(base, i, SHARDS).c_str(), &db);
+    sqlite3_close(db);
+  }
+  SQLite::Options options;
+  options.read_pool_size = 1;
+  // 超出范围的分片数直接拒绝，不会悄悄改成别的分片数打开
+  for (size_t bad : {size_t(0), SQLite::MAX_SHARDS + 1}) {
+    options.shards = bad;
+    bool rejected = false;
+    try {
+      SQLite::init(base, options);
+    } catch (const std::invalid_argument &) {
+      rejected = true;
+    }
+    if (!rejected || SQLite::shard_count() != 0) {
+      std::cerr << "shard count " << bad << " accepted" << std::endl;
+      return 1;
+    }
+  }
+  options.shards = SHARDS;
+  SQLite::init(base, options);
+  if (SQLite::shard_count() != SHARDS ||
+      SQLite::get_instance() != SQLite::shard(0)) {
+    std::cerr << "shards not opened" << std::endl;
+    return 1;
+  }
+  for (size_t i = 0; i < SHARDS; ++i) {
+    if (!SQLite::shard(i)->execute(
+            "CREATE TABLE user(id INTEGER PRIMARY KEY, "
+            "username TEXT UNIQUE, password TEXT)")) {
+      std::cerr << "create failed" << std::endl;
+      return 1;
+    }
+  }
+  Database::UserCache::init(1000);
+  auto *users = Database::UserCache::get_instance();
+
+  // 各分片并行提交，每条写入只落在用户名对应的分片
+  const int USERS = 200;
+  std::vector<std::future<SQLite::WriteResult>> pending;
+  for (int i = 0; i < USERS; ++i) {
+    const std::string name = std::format("user{}", i);
+    pending.push_back(SQLite::for_key(name)->submit(
+        "INSERT INTO user(username, password) VALUES(?, ?)", {name, "pw"}));
+  }
+  for (auto &f : pending) {
+    if (!f.get().ok) {
+      std::cerr << "insert failed" << std::endl;
+      return 1;
+    }
+  }
+  int total = 0;
+  for (size_t i = 0; i < SHARDS; ++i) {
+    int rows = 0;
+    bool misplaced = false;
+    SQLite::shard(i)->for_each_row(
+        "SELECT username FROM user", {}, [&](const Database::Row &row) {
+          ++rows;
+          misplaced |= SQLite::shard_of(row.get_text(0), SHARDS) != i;
+          return true;
+        });
+    if (rows == 0 || misplaced) {
+      std::cerr << "shard " << i << " rows: " << rows << std::endl;
+      return 1;
+    }
+    total += rows;
+  }
+  if (total != USERS) {
+    std::cerr << "rows across shards: " << total << std::endl;
+    return 1;
+  }
+
+  // 缓存与过滤器覆盖所有分片
+  if (!users->rebuild_filter() || users->stats().filter_items != USERS) {
+    std::cerr << "filter items: " << users->stats().filter_items << std::endl;
+    return 1;
+  }
+  for (int i = 0; i < USERS; ++i) {
+    auto user = users->find(std::format("user{}", i));
+    if (!user || user->password != "pw") {
+      std::cerr << "user" << i << " not found" << std::endl;
+      return 1;
+    }
+  }
+  if (users->find("nobody")) {
+    std::cerr << "unknown user found" << std::endl;
+    return 1;
+  }
+
+  for (size_t i = 0; i < SHARDS; ++i) {
+    const std::string path = SQLite::shard_path(base, i, SHARDS);
+    fs::remove(path);
+    fs::remove(path + "-wal");
+    fs::remove(path + "-shm");
+  }
+  return 0;
+}
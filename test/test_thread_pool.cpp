@@ -0,0 +1,220 @@
+// ThreadPool queue latency: overload is visible before anything is
+// dequeued, and admission recovers once the pool has drained. Adaptive
+// sizing: bounds, grow/shrink hysteresis and retired workers exiting
+#include "thread_pool.hpp"
+
+#include <chrono>
+#include <filesystem>
+#include <functional>
+#include <future>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace std::chrono;
+
+// 与 WebServer::IsOverloaded_ / ResumeAccept_ 的判断相同
+static const milliseconds LATENCY_LIMIT(20);
+
+static bool TestStalled() {
+  // 唯一的工作线程被占住：还没有任务出队，队首任务的等待时间也要算进去
+  ThreadPool pool(1);
+  std::promise<void> release;
+  auto blocker = pool.enqueue([f = release.get_future().share()] { f.wait(); });
+  auto queued = pool.enqueue([] {});
+  std::this_thread::sleep_for(LATENCY_LIMIT + milliseconds(10));
+  const bool seen = pool.queue_latency() >= LATENCY_LIMIT;
+  release.set_value();
+  blocker.get();
+  queued.get();
+  if (!seen) {
+    std::cerr << "stalled pool not noticed" << std::endl;
+  }
+  return seen;
+}
+
+static bool TestRecovery() {
+  // 过载：一个线程上排 30 个 5ms 的任务，后面的任务要等 100ms 以上
+  ThreadPool pool(1);
+  std::vector<std::future<void>> pending;
+  for (int i = 0; i < 30; i++) {
+    pending.push_back(
+        pool.enqueue([] { std::this_thread::sleep_for(milliseconds(5)); }));
+  }
+  for (auto &f : pending) {
+    f.get();
+  }
+  if (pool.queue_depth() != 0 || pool.queue_latency() < LATENCY_LIMIT) {
+    std::cerr << "overload not visible: " << pool.queue_latency().count()
+              << "us" << std::endl;
+    return false;
+  }
+
+  // 过载时服务器不再入队（拒绝请求或暂停 accept），没有任务出队，
+  // 排队时延也必须自行回落到恢复阈值以下
+  const auto start = steady_clock::now();
+  while (pool.queue_latency() >= LATENCY_LIMIT / 2) {
+    if (steady_clock::now() - start > seconds(2)) {
+      std::cerr << "queue latency stuck at " << pool.queue_latency().count()
+                << "us after draining" << std::endl;
+      return false;
+    }
+    std::this_thread::sleep_for(milliseconds(5));
+  }
+
+  // 恢复后第一个任务不应把旧的平均值带回来
+  pool.enqueue([] {}).get();
+  if (pool.queue_latency() >= LATENCY_LIMIT / 2) {
+    std::cerr << "old latency came back: " << pool.queue_latency().count()
+              << "us" << std::endl;
+    return false;
+  }
+  return true;
+}
+
+// 轮询直到条件成立，最多等 5 秒
+static bool WaitFor(const std::function<bool()> &cond) {
+  const auto deadline = steady_clock::now() + seconds(5);
+  while (!cond()) {
+    if (steady_clock::now() > deadline) {
+      return false;
+    }
+    std::this_thread::sleep_for(milliseconds(2));
+  }
+  return true;
+}
+
+// 进程内现存的线程数；退休的工作线程必须真正退出
+static size_t LiveThreads() {
+  size_t n = 0;
+  for ([[maybe_unused]] auto &entry :
+       std::filesystem::directory_iterator("/proc/self/task")) {
+    n++;
+  }
+  return n;
+}
+
+struct Resize {
+  size_t from, to;
+  std::string reason;
+};
+
+static bool TestAdaptiveBounds() {
+  ThreadPool::Adaptive opt;
+  opt.min_threads = 2;
+  opt.max_threads = 4;
+  ThreadPool big(10, opt);
+  opt.min_threads = 0;
+  opt.max_threads = 0;
+  ThreadPool tiny(0, opt);
+  if (big.thread_count() != 4 || tiny.thread_count() != 1) {
+    std::cerr << "initial size not clamped: " << big.thread_count() << ", "
+              << tiny.thread_count() << std::endl;
+    return false;
+  }
+  return true;
+}
+
+static bool TestAdaptiveResize() {
+  ThreadPool::Adaptive opt;
+  opt.min_threads = 1;
+  opt.max_threads = 3;
+  opt.target_wait = milliseconds(10);
+  opt.interval = milliseconds(20);
+  opt.grow_after = 3;
+  opt.shrink_after = 5;
+  std::mutex mutex;
+  std::vector<Resize> resizes;
+  const size_t baseline = LiveThreads();
+  ThreadPool pool(1, opt, [&](size_t from, size_t to, std::string_view why) {
+    std::lock_guard<std::mutex> lk(mutex);
+    resizes.push_back({from, to, std::string(why)});
+  });
+  auto resized = [&] {
+    std::lock_guard<std::mutex> lk(mutex);
+    return resizes.size();
+  };
+
+  // 滞回：排队时延超过目标的时间不足一个采样周期，最多采到一次，不扩容
+  std::promise<void> shortGate;
+  auto blocker =
+      pool.enqueue([f = shortGate.get_future().share()] { f.wait(); });
+  auto queued = pool.enqueue([] {});
+  std::this_thread::sleep_for(opt.target_wait + milliseconds(5));
+  shortGate.set_value();
+  blocker.get();
+  queued.get();
+  std::this_thread::sleep_for(opt.interval * opt.grow_after * 2);
+  if (resized() != 0 || pool.thread_count() != 1) {
+    std::cerr << "grew on a single slow sample" << std::endl;
+    return false;
+  }
+
+  // 持续过载：所有任务都卡住，每 grow_after 个采样扩容一次，到上限为止
+  std::promise<void> gate;
+  std::shared_future<void> opened = gate.get_future().share();
+  std::vector<std::future<void>> pending;
+  for (int i = 0; i < 16; i++) {
+    pending.push_back(pool.enqueue([opened] { opened.wait(); }));
+  }
+  if (!WaitFor([&] { return pool.thread_count() == opt.max_threads; })) {
+    std::cerr << "never grew to max: " << pool.thread_count() << std::endl;
+    return false;
+  }
+  std::this_thread::sleep_for(opt.interval * opt.grow_after * 3);
+  if (pool.thread_count() != opt.max_threads ||
+      LiveThreads() != baseline + 1 + opt.max_threads) {
+    std::cerr << "grew past max: " << pool.thread_count() << std::endl;
+    return false;
+  }
+  {
+    std::lock_guard<std::mutex> lk(mutex);
+    if (resizes.size() != 2 || resizes[0].from != 1 || resizes[0].to != 2 ||
+        resizes[1].from != 2 || resizes[1].to != 3 ||
+        resizes[1].reason != "queue wait above target") {
+      std::cerr << "unexpected grow steps" << std::endl;
+      return false;
+    }
+  }
+
+  // 排空后持续空闲：每 shrink_after 个采样退休一个线程，到下限为止
+  gate.set_value();
+  for (auto &f : pending) {
+    f.get();
+  }
+  if (!WaitFor([&] { return pool.thread_count() == opt.min_threads; })) {
+    std::cerr << "never shrank to min: " << pool.thread_count() << std::endl;
+    return false;
+  }
+  std::this_thread::sleep_for(opt.interval * opt.shrink_after * 2);
+  // 退休的线程已经退出，由控制线程回收
+  if (!WaitFor([&] {
+        return LiveThreads() == baseline + 1 + opt.min_threads;
+      }) ||
+      pool.thread_count() != opt.min_threads) {
+    std::cerr << "retired workers still running: " << LiveThreads()
+              << " threads" << std::endl;
+    return false;
+  }
+  {
+    std::lock_guard<std::mutex> lk(mutex);
+    if (resizes.size() != 4 || resizes[2].from != 3 || resizes[2].to != 2 ||
+        resizes[3].to != 1 || resizes[3].reason != "workers idle") {
+      std::cerr << "unexpected shrink steps" << std::endl;
+      return false;
+    }
+  }
+  // 缩容后照常工作
+  return pool.enqueue([] { return 7; }).get() == 7 &&
+         pool.resize_count() == 4;
+}
+
+int main() {
+  if (!TestStalled() || !TestRecovery() || !TestAdaptiveBounds() ||
+      !TestAdaptiveResize()) {
+    return 1;
+  }
+  return 0;
+}
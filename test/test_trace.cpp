@@ -0,0 +1,135 @@
+// Request tracing: sampling, per-thread rings and Chrome trace export
+#include "trace.hpp"
+
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+int main() {
+  // 关闭时不分配追踪 id
+  if (Trace::begin() != 0) {
+    std::cerr << "tracing should be off by default" << std::endl;
+    return 1;
+  }
+
+  // 1/4 采样：每个线程每 4 个请求取到一个 id，且 id 互不相同
+  Trace::set_sample(4);
+  std::vector<uint64_t> ids;
+  for (int i = 0; i < 40; ++i) {
+    if (uint64_t id = Trace::begin()) {
+      ids.push_back(id);
+    }
+  }
+  if (ids.size() != 10 || ids.front() == ids.back()) {
+    std::cerr << "sampled " << ids.size() << " of 40" << std::endl;
+    return 1;
+  }
+
+  // 一个请求跨三个线程：主循环、线程池、数据库线程，id 为 0 的打点忽略
+  const uint64_t id = ids[0];
+  const int64_t t0 = Trace::now_ns();
+  Trace::name_thread("event loop");
+  Trace::mark_at(id, TracePoint::Readable, t0, 7);
+  Trace::mark_at(0, TracePoint::Readable, t0);
+  std::thread([&] {
+    Trace::name_thread("static");
+    Trace::mark_at(id, TracePoint::Dequeued, t0 + 1000);
+    Trace::mark_at(id, TracePoint::Read, t0 + 2000);
+    Trace::mark_at(id, TracePoint::Parsed, t0 + 5000, 0,
+                   "POST /login.html \"x\"");
+  }).join();
+  std::thread([&] {
+    Trace::name_thread("db");
+    Trace::mark_at(id, TracePoint::DbStart, t0 + 6000);
+    Trace::mark_at(id, TracePoint::DbEnd, t0 + 9000, 42);
+  }).join();
+  Trace::mark_at(id, TracePoint::LastByte, t0 + 12000, 200, "aborted");
+
+  std::vector<TraceEvent> mine;
+  for (const TraceEvent &ev : Trace::collect()) {
+    if (ev.id == id) {
+      mine.push_back(ev);
+    }
+  }
+  if (mine.size() != 7 || mine.front().point != TracePoint::Readable ||
+      mine.back().point != TracePoint::LastByte ||
+      std::string(mine[5].thread) != "db" || mine[5].value != 42) {
+    std::cerr << "collected " << mine.size() << " events" << std::endl;
+    return 1;
+  }
+
+  std::string out;
+  Trace::write_chrome_json(out);
+  const std::string tid = std::to_string(id);
+  const std::vector<std::string> wants = {
+      "\"traceEvents\":[",
+      "\"tid\":" + tid + ",\"args\":{\"name\":\"#" + tid +
+          " POST /login.html \\\"x\\\"\"}",
+      "{\"name\":\"pool_queue\",\"cat\":\"request\",\"ph\":\"X\","
+      "\"pid\":1,\"tid\":" +
+          tid,
+      "\"dur\":3.000,\"args\":{\"thread\":\"static/",
+      "\"dur\":3.000,\"args\":{\"thread\":\"db/",
+      "\"pool_wait_us\":42",
+      "\"status\":200,\"note\":\"aborted\""};
+  for (const std::string &want : wants) {
+    if (out.find(want) == std::string::npos) {
+      std::cerr << "missing: " << want << "\n" << out;
+      return 1;
+    }
+  }
+
+  // 请求行不是合法 UTF-8：坏字节替换为 U+FFFD，合法的多字节字符原样保留，
+  // 截断在多字节字符中间也一样，输出仍是合法的 JSON
+  const uint64_t bad = ids[1];
+  Trace::mark_at(bad, TracePoint::Parsed, t0, 0,
+                 "GET /\xff\x80\xe4\xb8\xad\xe4\xb8 x");
+  const uint64_t cut = 2000000;
+  Trace::mark_at(cut, TracePoint::Parsed, t0, 0,
+                 "GET /aaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaa\xe4\xb8\xad");
+  out.clear();
+  Trace::write_chrome_json(out);
+  const std::string badWants[] = {
+      "#" + std::to_string(bad) +
+          " GET /\\ufffd\\ufffd\xe4\xb8\xad\\ufffd\\ufffd x\"}",
+      "#" + std::to_string(cut) +
+          " GET /aaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaa\\ufffd\"}"};
+  for (const std::string &want : badWants) {
+    if (out.find(want) == std::string::npos) {
+      std::cerr << "missing: " << want << "\n" << out;
+      return 1;
+    }
+  }
+  for (size_t i = 0; i < out.size(); ++i) {
+    const auto c = static_cast<unsigned char>(out[i]);
+    // 除两处 "中" 外不应再有非 ASCII 字节
+    if (c >= 0x80 && out.compare(i, 3, "\xe4\xb8\xad") != 0) {
+      std::cerr << "raw byte " << int(c) << " at " << i << std::endl;
+      return 1;
+    }
+    if (c >= 0x80) {
+      i += 2;
+    }
+  }
+
+  // 环写满后覆盖最旧的事件，只保留最近 RING_EVENTS 条
+  const uint64_t busy = 1000000;
+  std::thread([&] {
+    for (size_t i = 0; i < Trace::RING_EVENTS + 100; ++i) {
+      Trace::mark_at(busy, TracePoint::Read, static_cast<int64_t>(i));
+    }
+  }).join();
+  size_t kept = 0;
+  int64_t oldest = -1;
+  for (const TraceEvent &ev : Trace::collect()) {
+    if (ev.id == busy) {
+      oldest = kept++ == 0 ? ev.ts_ns : oldest;
+    }
+  }
+  if (kept > Trace::RING_EVENTS || oldest < 100) {
+    std::cerr << "ring kept " << kept << ", oldest " << oldest << std::endl;
+    return 1;
+  }
+  return 0;
+}
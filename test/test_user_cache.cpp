@@ -0,0 +1,181 @@
+// ShardedLruCache eviction/epochs, BloomFilter and the read-through
+// UserCache
+#include "bloom_filter.hpp"
+#include "lru_cache.hpp"
+#include "user_cache.hpp"
+
+#include <filesystem>
+#include <format>
+#include <iostream>
+#include <string>
+#include <unistd.h>
+
+int main() {
+  // 单分片便于检查 LRU 顺序
+  Database::ShardedLruCache<int, int> lru(3, 1);
+  for (int i = 0; i < 3; ++i) {
+    lru.put(i, i * 10);
+  }
+  lru.get(0); // 0 变为最近使用，下一次淘汰 1
+  lru.put(3, 30);
+  if (!lru.get(0) || lru.get(1) || !lru.get(2) || *lru.get(3) != 30 ||
+      lru.stats().evictions != 1 || lru.stats().size != 3) {
+    std::cerr << "lru order wrong" << std::endl;
+    return 1;
+  }
+  // 读库期间键被失效，过时的回填被丢弃
+  uint64_t epoch = lru.fill_epoch(5);
+  lru.erase(5);
+  if (lru.put(5, 50, epoch) || lru.get(5)) {
+    std::cerr << "stale fill accepted" << std::endl;
+    return 1;
+  }
+
+  // 布隆过滤器：没有假阴性，假阳性率接近设计值
+  Database::BloomFilter bloom(10000, 0.01);
+  for (int i = 0; i < 10000; ++i) {
+    bloom.add(std::format("user{}", i));
+  }
+  int fp = 0;
+  for (int i = 0; i < 10000; ++i) {
+    if (!bloom.may_contain(std::format("user{}", i))) {
+      std::cerr << "bloom false negative" << std::endl;
+      return 1;
+    }
+    fp += bloom.may_contain(std::format("other{}", i));
+  }
+  if (fp > 200 || bloom.estimated_fp_rate() > 0.02) {
+    std::cerr << "bloom false positives: " << fp << std::endl;
+    return 1;
+  }
+
+  namespace fs = std::filesystem;
+  const std::string path = std::format("user_cache_test_{}.db", getpid());
+  {
+    sqlite3 *db = nullptr;
+    sqlite3_open(path.c_str(), &db);
+    sqlite3_close(db);
+  }
+  Database::SQLite::init(path, 2);
+  auto *sql = Database::SQLite::get_instance();
+  sql->execute("CREATE TABLE user(id INTEGER PRIMARY KEY AUTOINCREMENT, "
+               "username TEXT NOT NULL UNIQUE, password TEXT NOT NULL)");
+  sql->execute("INSERT INTO user(username, password) VALUES('old', 'pw')");
+  Database::UserCache::init(1000, 4);
+  auto *users = Database::UserCache::get_instance();
+
+  // 已有用户：第一次读库，之后命中缓存
+  for (int i = 0; i < 10; ++i) {
+    auto u = users->find("old");
+    if (!u || u->password != "pw") {
+      std::cerr << "existing user not found" << std::endl;
+      return 1;
+    }
+  }
+  auto stats = users->stats();
+  if (stats.misses != 1 || stats.hits != 9) {
+    std::cerr << "hits=" << stats.hits << " misses=" << stats.misses
+              << std::endl;
+    return 1;
+  }
+  // 不存在的用户不缓存，查询出错与查无此人可区分
+  std::string err;
+  if (users->find("nobody", &err) || !err.empty() ||
+      users->stats().size != 1) {
+    std::cerr << "unknown user cached" << std::endl;
+    return 1;
+  }
+
+  // 过滤器在启动时由表构建：不存在的用户名不查询数据库
+  const auto before = users->stats();
+  for (int i = 0; i < 100; ++i) {
+    if (users->find(std::format("fresh{}", i))) {
+      std::cerr << "fresh name found" << std::endl;
+      return 1;
+    }
+  }
+  auto after = users->stats();
+  if (after.filter_negatives + after.filter_false_positives -
+              before.filter_negatives - before.filter_false_positives !=
+          100 ||
+      after.filter_false_positives - before.filter_false_positives > 5 ||
+      after.filter_rebuilds != 1 || after.filter_items != 1) {
+    std::cerr << "filter negatives="
+              << after.filter_negatives - before.filter_negatives
+              << std::endl;
+    return 1;
+  }
+
+  // 经 SQLite::execute 写入的新用户提交后直接进入缓存；
+  // 新行由写线程在提交前读出，不经过读连接
+  auto reads = [sql] {
+    auto r = sql->read_stats();
+    return r.thread_reads + r.pool_reads;
+  };
+  const uint64_t reads_before = reads();
+  sql->execute("INSERT INTO user(username, password) VALUES(?, ?)",
+               {"new", "secret"});
+  const uint64_t misses = users->stats().misses;
+  auto u = users->find("new");
+  if (!u || u->password != "secret" || users->stats().misses != misses ||
+      reads() != reads_before) {
+    std::cerr << "insert did not populate the cache" << std::endl;
+    return 1;
+  }
+  // 同一批提交：失败的语句不进入缓存，其余各行按自己的值缓存
+  auto b1 = sql->submit("INSERT INTO user(username, password) VALUES(?, ?)",
+                        {"batch1", "p1"});
+  auto dup = sql->submit("INSERT INTO user(username, password) VALUES(?, ?)",
+                         {"new", "dup"});
+  auto b2 = sql->submit("INSERT INTO user(username, password) VALUES(?, ?)",
+                        {"batch2", "p2"});
+  const bool batch_ok = b1.get().ok && !dup.get().ok && b2.get().ok;
+  u = users->find("new");
+  auto u1 = users->find("batch1");
+  auto u2 = users->find("batch2");
+  if (!batch_ok || !u || u->password != "secret" || !u1 ||
+      u1->password != "p1" || !u2 || u2->password != "p2" ||
+      users->stats().misses != misses || reads() != reads_before) {
+    std::cerr << "batched inserts not cached from the writer" << std::endl;
+    return 1;
+  }
+  // 替换与修改不会留下旧密码
+  sql->execute("INSERT OR REPLACE INTO user(username, password) VALUES(?, ?)",
+               {"new", "changed"});
+  if (users->find("new")->password != "changed") {
+    std::cerr << "replace left a stale entry" << std::endl;
+    return 1;
+  }
+  sql->execute("UPDATE user SET password='updated' WHERE username='old'");
+  if (users->find("old")->password != "updated") {
+    std::cerr << "update left a stale entry" << std::endl;
+    return 1;
+  }
+  // 改名：过滤器先停用再在后台重建，期间不会把新名字误判为不存在
+  sql->execute("UPDATE user SET username='renamed' WHERE username='old'");
+  if (!users->find("renamed")) {
+    std::cerr << "renamed user hidden by the filter" << std::endl;
+    return 1;
+  }
+  for (int i = 0; i < 200 && users->stats().filter_rebuilds < 2; ++i) {
+    usleep(10000);
+  }
+  if (!users->rebuild_filter() || !users->find("renamed") ||
+      users->stats().filter_items != 4) {
+    std::cerr << "filter rebuild failed" << std::endl;
+    return 1;
+  }
+
+  // 显式按顺序关闭：先撤下缓存的提交监听，再关闭各分片
+  Database::UserCache::shutdown();
+  Database::SQLite::shutdown();
+  if (Database::UserCache::get_instance() || Database::SQLite::shard_count()) {
+    std::cerr << "shutdown left instances behind" << std::endl;
+    return 1;
+  }
+
+  fs::remove(path);
+  fs::remove(path + "-wal");
+  fs::remove(path + "-shm");
+  return 0;
+}
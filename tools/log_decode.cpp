@@ -0,0 +1,81 @@
+// 把 -l 2 生成的二进制日志与 -A 2 生成的二进制访问日志（*.binlog）
+// 还原成文本，按文件头的 magic 区分
+// 用法：log_decode [file.binlog ...]，不给文件时读取标准输入
+#include "access_log.hpp"
+#include "log_record.hpp"
+
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+
+namespace {
+
+// 访问日志：magic 之后是连续的定长 AccessRecord
+bool DecodeAccess(std::istream &in, const char *name) {
+  std::string out;
+  AccessRecord rec;
+  while (in.read(reinterpret_cast<char *>(&rec), sizeof(rec))) {
+    out.clear();
+    AccessLog::FormatClf(rec, out);
+    std::fwrite(out.data(), 1, out.size(), stdout);
+  }
+  if (in.gcount() != 0) {
+    std::cerr << name << ": truncated record at end of file" << std::endl;
+    return false;
+  }
+  return true;
+}
+
+bool Decode(std::istream &in, const char *name) {
+  const std::string_view access = AccessLog::BINARY_MAGIC;
+  std::string chunk(1 << 16, '\0');
+  in.read(chunk.data(), access.size());
+  std::streamsize head = in.gcount();
+  if (std::string_view(chunk.data(), head) == access) {
+    return DecodeAccess(in, name);
+  }
+  LogBinaryDecoder decoder;
+  std::string out;
+  while (in || head > 0) {
+    std::streamsize n = head;
+    if (head == 0) {
+      in.read(chunk.data(), chunk.size());
+      n = in.gcount();
+    }
+    head = 0;
+    if (n <= 0) {
+      break;
+    }
+    out.clear();
+    bool ok = decoder.Feed(std::string_view(chunk.data(), n), out);
+    std::fwrite(out.data(), 1, out.size(), stdout);
+    if (!ok) {
+      std::cerr << name << ": corrupted record" << std::endl;
+      return false;
+    }
+  }
+  if (!decoder.Complete()) {
+    std::cerr << name << ": truncated record at end of file" << std::endl;
+    return false;
+  }
+  return true;
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+  if (argc < 2) {
+    return Decode(std::cin, "<stdin>") ? 0 : 1;
+  }
+  bool ok = true;
+  for (int i = 1; i < argc; ++i) {
+    std::ifstream in(argv[i], std::ios_base::binary);
+    if (!in.is_open()) {
+      std::cerr << argv[i] << ": cannot open" << std::endl;
+      ok = false;
+      continue;
+    }
+    ok = Decode(in, argv[i]) && ok;
+  }
+  return ok ? 0 : 1;
+}
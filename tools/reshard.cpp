@@ -0,0 +1,183 @@
+// 把 user 表按 SQLite::shard_of 重新分布到新的分片文件
+// 用法：reshard SRC SRC_SHARDS DST DST_SHARDS
+//   SRC/DST 为 -D 1 时的库路径（如 db.sqlite3），分片文件名由
+//   SQLite::shard_path 推出。目标文件必须不存在，避免与旧数据混在一起。
+//   用户 id 在各分片内重新分配。
+#include "sqlite.hpp"
+
+#include <cstdlib>
+#include <filesystem>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace {
+
+struct DbCloser {
+  void operator()(sqlite3 *db) const { sqlite3_close(db); }
+};
+using Db = std::unique_ptr<sqlite3, DbCloser>;
+
+struct StmtFinalizer {
+  void operator()(sqlite3_stmt *stmt) const { sqlite3_finalize(stmt); }
+};
+using Stmt = std::unique_ptr<sqlite3_stmt, StmtFinalizer>;
+
+Db Open(const std::string &path, int flags) {
+  sqlite3 *db = nullptr;
+  int rc = sqlite3_open_v2(path.c_str(), &db, flags, nullptr);
+  Db owned(db);
+  if (rc != SQLITE_OK) {
+    std::cerr << path << ": " << sqlite3_errmsg(db) << std::endl;
+    return nullptr;
+  }
+  return owned;
+}
+
+Stmt Prepare(sqlite3 *db, const char *sql) {
+  sqlite3_stmt *stmt = nullptr;
+  if (sqlite3_prepare_v2(db, sql, -1, &stmt, nullptr) != SQLITE_OK) {
+    std::cerr << sql << ": " << sqlite3_errmsg(db) << std::endl;
+  }
+  return Stmt(stmt);
+}
+
+bool Exec(sqlite3 *db, const std::string &sql) {
+  if (sqlite3_exec(db, sql.c_str(), nullptr, nullptr, nullptr) != SQLITE_OK) {
+    std::cerr << sql << ": " << sqlite3_errmsg(db) << std::endl;
+    return false;
+  }
+  return true;
+}
+
+size_t ParseShards(const char *arg) {
+  const long n = std::strtol(arg, nullptr, 10);
+  if (n < 1 || n > static_cast<long>(Database::SQLite::MAX_SHARDS)) {
+    return 0;
+  }
+  return static_cast<size_t>(n);
+}
+
+// 新建的目标文件记入 created，失败时由调用方删除
+bool Reshard(const std::string &src, size_t srcShards, const std::string &dst,
+             size_t dstShards, std::vector<std::string> &created) {
+  using Database::SQLite;
+  namespace fs = std::filesystem;
+  std::vector<Db> sources;
+  for (size_t i = 0; i < srcShards; ++i) {
+    sources.push_back(Open(SQLite::shard_path(src, i, srcShards),
+                           SQLITE_OPEN_READONLY));
+    if (!sources.back()) {
+      return false;
+    }
+  }
+  // 沿用源库的建表语句（含 UNIQUE 等约束）
+  std::string schema;
+  {
+    Stmt stmt = Prepare(sources[0].get(),
+                        "SELECT sql FROM sqlite_master "
+                        "WHERE type='table' AND name='user'");
+    if (!stmt || sqlite3_step(stmt.get()) != SQLITE_ROW) {
+      std::cerr << src << ": no user table" << std::endl;
+      return false;
+    }
+    schema = reinterpret_cast<const char *>(sqlite3_column_text(stmt.get(), 0));
+  }
+
+  std::vector<Db> targets;
+  std::vector<Stmt> inserts;
+  for (size_t i = 0; i < dstShards; ++i) {
+    const std::string path = SQLite::shard_path(dst, i, dstShards);
+    if (fs::exists(path)) {
+      std::cerr << path << ": already exists" << std::endl;
+      return false;
+    }
+    created.push_back(path);
+    targets.push_back(
+        Open(path, SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE));
+    sqlite3 *db = targets.back().get();
+    if (!db || !Exec(db, "PRAGMA journal_mode=WAL") || !Exec(db, schema) ||
+        !Exec(db, "BEGIN")) {
+      return false;
+    }
+    inserts.push_back(
+        Prepare(db, "INSERT INTO user(username, password) VALUES(?, ?)"));
+    if (!inserts.back()) {
+      return false;
+    }
+  }
+
+  std::vector<size_t> counts(dstShards, 0);
+  for (size_t i = 0; i < srcShards; ++i) {
+    Stmt select =
+        Prepare(sources[i].get(), "SELECT username, password FROM user");
+    if (!select) {
+      return false;
+    }
+    int rc;
+    while ((rc = sqlite3_step(select.get())) == SQLITE_ROW) {
+      const auto *name = static_cast<const char *>(
+          sqlite3_column_blob(select.get(), 0));
+      const int nameLen = sqlite3_column_bytes(select.get(), 0);
+      const auto *pwd = static_cast<const char *>(
+          sqlite3_column_blob(select.get(), 1));
+      const int pwdLen = sqlite3_column_bytes(select.get(), 1);
+      const size_t to = SQLite::shard_of(
+          std::string_view(name ? name : "", static_cast<size_t>(nameLen)),
+          dstShards);
+      sqlite3_stmt *insert = inserts[to].get();
+      sqlite3_bind_text(insert, 1, name ? name : "", nameLen, SQLITE_STATIC);
+      sqlite3_bind_text(insert, 2, pwd ? pwd : "", pwdLen, SQLITE_STATIC);
+      if (sqlite3_step(insert) != SQLITE_DONE) {
+        std::cerr << "insert into shard " << to << ": "
+                  << sqlite3_errmsg(targets[to].get()) << std::endl;
+        return false;
+      }
+      sqlite3_reset(insert);
+      ++counts[to];
+    }
+    if (rc != SQLITE_DONE) {
+      std::cerr << "read shard " << i << ": "
+                << sqlite3_errmsg(sources[i].get()) << std::endl;
+      return false;
+    }
+  }
+  // 全部读完才提交
+  inserts.clear();
+  for (size_t i = 0; i < dstShards; ++i) {
+    if (!Exec(targets[i].get(), "COMMIT")) {
+      return false;
+    }
+    std::cout << created[i] << ": " << counts[i] << " users" << std::endl;
+  }
+  return true;
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+  using Database::SQLite;
+  if (argc != 5) {
+    std::cerr << "usage: " << argv[0] << " SRC SRC_SHARDS DST DST_SHARDS"
+              << std::endl;
+    return 2;
+  }
+  const size_t srcShards = ParseShards(argv[2]);
+  const size_t dstShards = ParseShards(argv[4]);
+  if (!srcShards || !dstShards) {
+    std::cerr << "shard count must be 1.." << SQLite::MAX_SHARDS << std::endl;
+    return 2;
+  }
+  std::vector<std::string> created;
+  if (!Reshard(argv[1], srcShards, argv[3], dstShards, created)) {
+    // 不留下半份数据，修正后可直接重跑
+    for (const auto &path : created) {
+      std::filesystem::remove(path);
+      std::filesystem::remove(path + "-wal");
+      std::filesystem::remove(path + "-shm");
+    }
+    return 1;
+  }
+  return 0;
+}